@@ -0,0 +1,621 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * bench.cc
+ *
+ * Runs the game without a window, as fast as it will go, to measure the
+ * simulation: blocks are played the way a steady player would. Each one
+ * appears as near as it can to the column it fits best in, is turned to
+ * the pose it lies best in, is moved over the column and is dropped, so
+ * layers fill and are taken out, and anything left hanging falls under
+ * gravity. A new game starts when the arena fills up. The time spent
+ * choosing where blocks go is left out of the ticks per second. Only links
+ * the game core (libtetris3d.a).
+ *
+ * Blocks come at the fastest rate of the game (NEW_BLOCK_COUNT_MIN) in the
+ * classic arena, and proportionally faster in a bigger one, so layers fill
+ * at the same rate whatever the size.
+ *
+ * With -s, what's left after a layer is taken out is settled straight
+ * away (see Rules::settle) rather than falling a layer at a time.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "blockpool.h"
+#include "grid.h"
+#include "rules.h"
+#include "scheduler.h"
+
+using namespace std;
+
+// the fastest the game gets (GRAVITY_COUNT_MIN in cve.cc, and
+// NEW_BLOCK_COUNT_MIN), in ms
+#define BENCH_GRAVITY_MS 600
+#define BENCH_NEW_BLOCK_MS 5000
+// biggest arena (in columns) that every column is tried in for a new block
+#define BENCH_SMALL_ARENA 64
+// most holes in the layers tried in a bigger one (see findPlace)
+#define BENCH_HOLES 16
+// most poses a block can be turned to (every way up, every way round)
+#define BENCH_POSES 24
+// how many layers higher up a block would rather go than leave a gap, or
+// to complete a layer
+#define BENCH_GAP_COST 8
+#define BENCH_LAYER_VALUE 40
+
+// what findPlace found
+#define BENCH_PLACE 0
+#define BENCH_WAIT 1 // only where blocks are still falling
+#define BENCH_FULL 2 // the arena has filled up
+
+Scheduler scheduler;
+BlockPool blocks;
+CollisionGrid collisionGrid;
+float boundaries[4];
+float blockStartY;
+int newBlockMs;
+int blockId = 1;
+int score = 0, scoreCount = 0;
+int layers = 0, games = 0, blocksMade = 0, settled = 0;
+bool settle = false;
+clock_t choosing = 0; // spent finding places for new blocks, left out of the time
+
+// the different poses of each type of block: the turn (x, y and z angles)
+// to it, the orientation it ends in, the cells it takes up (from the cell
+// the block appears in), and the columns it can appear in to make the turn
+// (x and z from low to high)
+float poseAngles[BLOCK_TYPES][BENCH_POSES][3];
+int poseOrientation[BLOCK_TYPES][BENCH_POSES];
+Cell shapes[BLOCK_TYPES][BENCH_POSES][BLOCK_MAX_CUBES];
+Cell startLow[BLOCK_TYPES][BENCH_POSES], startHigh[BLOCK_TYPES][BENCH_POSES];
+int shapeSize[BLOCK_TYPES][BENCH_POSES];
+int poses[BLOCK_TYPES];
+
+// a new block on its way to where it's going, to drop once it's there
+struct Placing {
+  BlockHandle handle;
+  int type, pose;
+  int x, z; // the column it's going to
+  int start; // the orientation it appeared in
+  float turnedAt; // the height it was last sent to its pose from
+  float movedAt; // and over its column
+};
+vector <Placing> placing;
+vector <int> reserved; // how many of them each column has cubes going to
+
+// the top of each column, as far as findPlace has needed it (-1 where not)
+vector <int> tops;
+
+// Set the size of the game area, centred on the origin (as cve.cc)
+//   width,height,depth - the size in cells
+void setArena(int width, int height, int depth)
+{
+  boundaries[0] = -5.0 * (width / 2), boundaries[1] = boundaries[0] + 5.0 * (width - 1);
+  boundaries[2] = -5.0 * (depth / 2), boundaries[3] = boundaries[2] + 5.0 * (depth - 1);
+  blockStartY = 5.0 * (height - 2);
+  collisionGrid.resize(width, height, depth);
+  reserved.assign(width * depth, 0);
+  tops.assign(width * depth, -1);
+
+  newBlockMs = BENCH_NEW_BLOCK_MS * GAMEAREA_WIDTH * GAMEAREA_DEPTH / (width * depth);
+  if (newBlockMs < SIM_TICK_MS) newBlockMs = SIM_TICK_MS;
+}
+
+// Get the lowest corner of the cells a pose takes up
+//   type - the type of block
+//   pose - the pose
+Cell lowCorner(int type, int pose)
+{
+  Cell low = shapes[type][pose][0];
+  for (int i = 1; i < shapeSize[type][pose]; i++) {
+    const Cell &c = shapes[type][pose][i];
+    if (c.x < low.x) low.x = c.x;
+    if (c.y < low.y) low.y = c.y;
+    if (c.z < low.z) low.z = c.z;
+  }
+  return low;
+}
+
+// Is one pose of a block the same shape as another, wherever it is?
+//   type - the type of block
+//   a,b - the poses
+bool sameShape(int type, int a, int b)
+{
+  if (shapeSize[type][a] != shapeSize[type][b]) return false;
+
+  Cell lowA = lowCorner(type, a), lowB = lowCorner(type, b);
+  for (int i = 0; i < shapeSize[type][a]; i++) {
+    const Cell &c = shapes[type][a][i];
+    bool found = false;
+    for (int j = 0; j < shapeSize[type][b] && !found; j++) {
+      const Cell &d = shapes[type][b][j];
+      found = c.x - lowA.x == d.x - lowB.x && c.y - lowA.y == d.y - lowB.y && c.z - lowA.z == d.z - lowB.z;
+    }
+    if (!found) return false;
+  }
+  return true;
+}
+
+// Make a block in an empty grid and turn it as far as it will go
+//   grid,pool - the grid and pool to do it in, emptied first
+//   type - the type of block
+//   a - the x, y and z angles to turn it by
+//   x,z - the column it appears in
+//   clock - the block clock, run on until the turn is over
+//
+// Returns:
+//   the block, for the caller to destroy
+BlockHandle turnAlone(CollisionGrid &grid, BlockPool &pool, int type, const float a[], int x, int z, int &clock)
+{
+  grid.clear();
+  BlockHandle h = pool.create(1, type, boundaries[0] + 5 * x, blockStartY, boundaries[2] + 5 * z, true, grid, boundaries);
+  Block *block = pool.get(h);
+  block->setTargetAngleX(a[0]);
+  block->setTargetAngleY(a[1]);
+  block->setTargetAngleZ(a[2]);
+  while (block->getTurning()) {
+    Block::setClock(++clock);
+    block->move(boundaries, grid);
+  }
+  return h;
+}
+
+// Can a block appear in a column of an empty grid and be turned to a pose
+// there?
+//   grid,pool,clock - as turnAlone
+//   type - the type of block
+//   pose - the pose
+//   x,z - the column it appears in
+bool turnsAt(CollisionGrid &grid, BlockPool &pool, int type, int pose, int x, int z, int &clock)
+{
+  for (int i = 0; i < shapeSize[type][0]; i++) {
+    const Cell &c = shapes[type][0][i];
+    if (!grid.inside(x + c.x, (int) (blockStartY / 5) + c.y, z + c.z)) return false;
+  }
+
+  BlockHandle h = turnAlone(grid, pool, type, poseAngles[type][pose], x, z, clock);
+  bool turned = pool.get(h)->getOrientation() == poseOrientation[type][pose];
+  pool.destroy(h);
+  return turned;
+}
+
+// Find the poses of each type of block, by making one in the middle of an
+// empty grid the size of the arena and turning it each way there is, up to
+// half a turn about each axis, then the columns nearest the walls it can
+// make each turn in. Done before the game, as it runs the block clock.
+void findShapes()
+{
+  static const float angles[4] = { 0, 90, -90, 180 };
+  CollisionGrid grid;
+  grid.resize(collisionGrid.getWidth(), collisionGrid.getHeight(), collisionGrid.getDepth());
+  BlockPool pool;
+  Cell centre = { (int) (-boundaries[0] / 5), (int) (blockStartY / 5), (int) (-boundaries[2] / 5) };
+  int clock = 0;
+
+  for (int type = 0; type < BLOCK_TYPES; type++) {
+    poses[type] = 0;
+    for (int turn = 0; turn < 4 * 4 * 3 && poses[type] < BENCH_POSES; turn++) {
+      int pose = poses[type];
+      float *a = poseAngles[type][pose];
+      a[0] = angles[turn % 4], a[1] = angles[turn / 4 % 4], a[2] = angles[turn / 16];
+
+      BlockHandle h = turnAlone(grid, pool, type, a, centre.x, centre.z, clock);
+      Block *block = pool.get(h);
+      poseOrientation[type][pose] = block->getOrientation();
+      int n = block->getCells(shapes[type][pose], grid, boundaries);
+      for (int i = 0; i < n; i++) {
+        Cell &c = shapes[type][pose][i];
+        c.x -= centre.x, c.y -= centre.y, c.z -= centre.z;
+      }
+      shapeSize[type][pose] = n;
+      bool seen = n != block->getNumberOfCubes(); // it didn't fit
+      pool.destroy(h);
+
+      // keep it if it's a new shape
+      for (int other = 0; other < pose && !seen; other++) seen = sameShape(type, pose, other);
+      if (seen) continue;
+      poses[type]++;
+
+      Cell &low = startLow[type][pose], &high = startHigh[type][pose];
+      low = high = centre;
+      while (low.x > 0 && turnsAt(grid, pool, type, pose, low.x - 1, centre.z, clock)) low.x--;
+      while (high.x < grid.getWidth() - 1 && turnsAt(grid, pool, type, pose, high.x + 1, centre.z, clock)) high.x++;
+      while (low.z > 0 && turnsAt(grid, pool, type, pose, centre.x, low.z - 1, clock)) low.z--;
+      while (high.z < grid.getDepth() - 1 && turnsAt(grid, pool, type, pose, centre.x, high.z + 1, clock)) high.z++;
+    }
+  }
+  Block::setClock(0);
+}
+
+// Start turning a block to a pose. As when a player turns one, it's
+// ungrounded (a turn that is stopped counts as a hit).
+//   h - the block, as it appeared
+//   type - the type of block
+//   pose - the pose
+void turnTo(BlockHandle h, int type, int pose)
+{
+  Block *block = blocks.get(h);
+  block->setTargetAngleX(poseAngles[type][pose][0]);
+  block->setTargetAngleY(poseAngles[type][pose][1]);
+  block->setTargetAngleZ(poseAngles[type][pose][2]);
+  blocks.unGround(h);
+}
+
+// Get the layer over the top of what is in a column (counting blocks that
+// are on their way)
+//   x,z - the column
+int topOf(int x, int z)
+{
+  int &top = tops[z * collisionGrid.getWidth() + x];
+  if (top < 0) top = collisionGrid.getFloor(x, collisionGrid.getHeight(), z, false);
+  return top;
+}
+
+// Find the layer a cube dropped from a cell would land in, as
+// CollisionGrid::getFloor (counting blocks that are on their way), going
+// by the top of the column when the cell is over it
+//   x,y,z - the cell
+int floorUnder(int x, int y, int z)
+{
+  return topOf(x, z) <= y ? topOf(x, z) : collisionGrid.getFloor(x, y, z, false);
+}
+
+// Is there room for a block in a pose at the top of a column?
+//   type - the type of block
+//   pose - the pose
+//   x,z - the column
+//   landed - set if it's a block that has landed in the way
+//
+// Returns:
+//   how far it could fall from there (as Block::dropDistance), or -1
+int roomAt(int type, int pose, int x, int z, bool &landed)
+{
+  int startY = (int) (blockStartY / 5);
+  int distance = collisionGrid.getHeight();
+
+  for (int i = 0; i < shapeSize[type][pose]; i++) {
+    const Cell &c = shapes[type][pose][i];
+    int cx = x + c.x, cy = startY + c.y, cz = z + c.z;
+    if (!collisionGrid.inside(cx, cy, cz)) return -1;
+    int id = topOf(cx, cz) > cy ? collisionGrid.getId(cx, cy, cz) : 0;
+    if (id > 0) {
+      Block *in = blocks.get(blocks.find(id));
+      if (in == NULL || in->getGrounded()) landed = true;
+      return -1;
+    }
+    int d = cy - floorUnder(cx, cy, cz);
+    if (d < distance) distance = d;
+  }
+  return distance;
+}
+
+// Is a block in a pose over a column in the way of another still on its
+// way, or of one still falling? It would land on the other wherever it is
+// by then, not where it was planned to.
+//   type - the type of block
+//   pose - the pose
+//   x,z - the column
+bool busy(int type, int pose, int x, int z)
+{
+  for (int i = 0; i < shapeSize[type][pose]; i++) {
+    int cx = x + shapes[type][pose][i].x, cz = z + shapes[type][pose][i].z;
+    int top = topOf(cx, cz);
+    if (top > 0) {
+      Block *in = blocks.get(blocks.find(collisionGrid.getId(cx, top - 1, cz)));
+      if (in != NULL && !in->getGrounded()) return true;
+    }
+    if (reserved[cz * collisionGrid.getWidth() + cx] > 0) return true;
+  }
+  return false;
+}
+
+// Count a new block in or out of the columns it's going to
+//   p - the block
+//   n - 1 for in, -1 for out
+void reserve(const Placing &p, int n)
+{
+  for (int i = 0; i < shapeSize[p.type][p.pose]; i++)
+    reserved[(p.z + shapes[p.type][p.pose][i].z) * collisionGrid.getWidth() + p.x + shapes[p.type][p.pose][i].x] += n;
+}
+
+// Find the column nearest another that a block can turn to a pose in
+// without hitting the walls, for it to appear in
+//   type - the type of block
+//   pose - the pose
+//   x,z - the column it's going to, set to the one it appears in
+void startColumn(int type, int pose, int &x, int &z)
+{
+  const Cell &low = startLow[type][pose], &high = startHigh[type][pose];
+  x = min(max(x, low.x), high.x);
+  z = min(max(z, low.z), high.z);
+}
+
+// Find where to put a new block, as a steady player would: the column and
+// pose, of those tried, that leaves fewest gaps under it, then lands
+// lowest, so layers get filled. In the classic arena every column is tried;
+// in a bigger one, up to BENCH_HOLES of the lowest columns, as those are
+// the holes in the layers. Places it can't get to (from where it would
+// appear, without going through another block still on its way or
+// falling) are passed over.
+//   type - the type of block
+//   cellX,cellZ - set to the column
+//   pose - set to the pose
+//
+// Returns:
+//   BENCH_PLACE if there is somewhere, otherwise BENCH_WAIT if it's only
+//   blocks still falling in the way, or BENCH_FULL if it's landed ones
+int findPlace(int type, int &cellX, int &cellZ, int &pose)
+{
+  int width = collisionGrid.getWidth(), depth = collisionGrid.getDepth();
+  int startY = (int) (blockStartY / 5);
+  int area = width * depth, first = rand() % area;
+  int bestCost = 0;
+  bool found = false, landed = false;
+  tops.assign(tops.size(), -1); // the grid has moved on since last time
+
+  // the places to try: in the classic arena every column in every pose;
+  // in a bigger one, each pose with each of its cubes over one of up to
+  // BENCH_HOLES holes, open from the top down to the lowest layer that
+  // isn't full (or the next one up that has any), from a random column on
+  struct Try {
+    int x, z, pose;
+  };
+  vector <Try> tries;
+  if (area <= BENCH_SMALL_ARENA) {
+    for (int i = 0; i < area; i++)
+      for (int p = 0; p < poses[type]; p++) {
+        Try t = { (first + i) % area % width, (first + i) % area / width, p };
+        tries.push_back(t);
+      }
+  }
+  else {
+    int height = collisionGrid.getHeight(), lowest = 0;
+    while (lowest < height && collisionGrid.getLayerCount(lowest) == area) lowest++;
+
+    int holes[BENCH_HOLES], seen = 0;
+    for (int y = lowest; y < height && seen == 0; y++)
+      for (int i = 0; i < area && seen < BENCH_HOLES; i++) {
+        int column = (first + i) % area, cx = column % width, cz = column / width;
+        // empty down to y, and nothing over it (the second is slower to find)
+        if (collisionGrid.getFloor(cx, y + 1, cz, true) == y && collisionGrid.getFloor(cx, height, cz, true) == y)
+          holes[seen++] = column;
+      }
+    for (int i = 0; i < seen; i++)
+      for (int p = 0; p < poses[type]; p++)
+        for (int j = 0; j < shapeSize[type][p]; j++) {
+          Try t = { holes[i] % width - shapes[type][p][j].x, holes[i] / width - shapes[type][p][j].z, p };
+          tries.push_back(t);
+        }
+  }
+
+  for (int i = 0; i < (int) tries.size(); i++) {
+    int x = tries[i].x, z = tries[i].z, p = tries[i].pose;
+    int distance = roomAt(type, p, x, z, landed);
+    if (distance < 0) continue;
+
+    // the empty cells it would leave under its lowest cube in each column,
+    // and how high its cubes would be
+    const Cell *cells = shapes[type][p];
+    int gaps = 0, height = 0, completes = 0;
+    for (int j = 0; j < shapeSize[type][p]; j++) {
+      int cy = startY + cells[j].y;
+      height += cy - distance;
+      bool lowest = true, firstInLayer = true;
+      int inLayer = 0;
+      for (int k = 0; k < shapeSize[type][p]; k++) {
+        if (cells[k].x == cells[j].x && cells[k].z == cells[j].z && cells[k].y < cells[j].y) lowest = false;
+        if (cells[k].y == cells[j].y) {
+          if (k < j) firstInLayer = false;
+          inLayer++;
+        }
+      }
+      if (lowest) gaps += cy - distance - floorUnder(x + cells[j].x, cy, z + cells[j].z);
+      if (firstInLayer && collisionGrid.getLayerCount(cy - distance) + inLayer == width * depth) completes++;
+    }
+
+    int cost = BENCH_GAP_COST * gaps + height - BENCH_LAYER_VALUE * completes;
+    if (found && cost >= bestCost) continue;
+
+    // and whether it can get there: appear, turn, and go over the column
+    int startX = x, startZ = z;
+    startColumn(type, p, startX, startZ);
+    if (roomAt(type, 0, startX, startZ, landed) < 0 || roomAt(type, p, startX, startZ, landed) < 0) continue;
+    if (busy(type, 0, startX, startZ) || busy(type, p, startX, startZ) || busy(type, p, x, z)) continue;
+
+    found = true;
+    bestCost = cost;
+    cellX = x, cellZ = z, pose = p;
+  }
+
+  if (found) return BENCH_PLACE;
+  return landed ? BENCH_FULL : BENCH_WAIT;
+}
+
+// Start a new game
+void gameOver()
+{
+  games++;
+  blocks.clear();
+  collisionGrid.clear();
+  placing.clear();
+  reserved.assign(reserved.size(), 0);
+}
+
+// Move blocks down a layer, and again after a while
+//   value - not used
+void gravity(int value)
+{
+  Rules::gravity(blocks, false);
+  scheduler.after(BENCH_GRAVITY_MS, gravity, 0);
+}
+
+// Make a new block near where it fits best, start it turning, and make
+// another after a while
+//   value - not used
+void newBlock(int value)
+{
+  int type = rand() % BLOCK_TYPES, cellX = 0, cellZ = 0, pose = 0;
+
+  clock_t start = clock();
+  int found = findPlace(type, cellX, cellZ, pose);
+  choosing += clock() - start;
+
+  switch (found) {
+    case BENCH_PLACE: {
+      int startX = cellX, startZ = cellZ;
+      startColumn(type, pose, startX, startZ);
+      BlockHandle h = blocks.create(blockId++, type, boundaries[0] + 5 * startX, blockStartY, boundaries[2] + 5 * startZ,
+                                    true, collisionGrid, boundaries);
+      Block *block = blocks.get(h);
+      if (block != NULL) {
+        blocksMade++;
+        turnTo(h, type, pose);
+        Placing p = { h, type, pose, cellX, cellZ, block->getOrientation(), blockStartY, blockStartY + 5 };
+        placing.push_back(p);
+        reserve(p, 1);
+      }
+      break;
+    }
+    case BENCH_WAIT:
+      // try again once gravity has moved things on
+      scheduler.after(BENCH_GRAVITY_MS, newBlock, 0);
+      return;
+    case BENCH_FULL:
+      gameOver();
+      break;
+  }
+  scheduler.after(newBlockMs, newBlock, 0);
+}
+
+// One simulation tick
+//   value - the tick number
+void tick(int value)
+{
+  Block::setClock(value);
+
+  if (Rules::moveBlocks(blocks, collisionGrid, boundaries)) {
+    gameOver();
+    return;
+  }
+
+  // move the new blocks that have turned over their columns, and drop the
+  // ones that are there (or can't get there)
+  for (int i = 0; i < (int) placing.size(); ) {
+    Placing &p = placing[i];
+    Block *block = blocks.get(p.handle);
+    if (block != NULL && (block->getTurning() || block->getMoving())) {
+      i++;
+      continue;
+    }
+    // a turn or move that was stopped (by a block beside it) goes back, so
+    // it's tried again once gravity has taken the block down past what was
+    // in the way, until the block lands
+    float x = boundaries[0] + 5 * p.x, z = boundaries[2] + 5 * p.z;
+    bool turned = block != NULL && (block->getOrientation() != p.start || p.start == poseOrientation[p.type][p.pose]);
+    if (block != NULL && !block->getGrounded() && !turned) {
+      if (block->getY() < p.turnedAt) {
+        p.turnedAt = block->getY();
+        turnTo(p.handle, p.type, p.pose);
+      }
+      i++;
+      continue;
+    }
+    if (block != NULL && !block->getGrounded() && (block->getX() != x || block->getZ() != z)) {
+      if (block->getY() < p.movedAt) {
+        p.movedAt = block->getY();
+        block->setTargetPosition(x, block->getY(), z);
+        blocks.unGround(p.handle);
+      }
+      i++;
+      continue;
+    }
+    if (block != NULL) block->drop(collisionGrid, boundaries);
+    reserve(p, -1);
+    placing[i] = placing.back();
+    placing.pop_back();
+  }
+
+  LayerSet complete = collisionGrid.takeNewlyComplete();
+  if (complete.any()) {
+    complete = collisionGrid.getCompleteLayers();
+    Rules::removeLayers(blocks, complete, collisionGrid, boundaries, blockId);
+    for (int y = complete._Find_first(); y < (int) complete.size(); y = complete._Find_next(y)) {
+      layers++;
+      score += Rules::scoreLayer(scoreCount);
+    }
+    if (settle) settled += Rules::settle(blocks, collisionGrid, boundaries);
+  }
+
+  // the bonus for another layer runs down every six ticks (as cve.cc)
+  if (value % 6 == 0 && scoreCount > 0) scoreCount--;
+}
+
+int main(int argc, char **argv)
+{
+  int ticks = 100000;
+  int arenaWidth = GAMEAREA_WIDTH, arenaHeight = GAMEAREA_HEIGHT, arenaDepth = GAMEAREA_DEPTH;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%dx%d", &arenaWidth, &arenaHeight, &arenaDepth) != 3
+          || arenaWidth < GAMEAREA_WIDTH || arenaDepth < GAMEAREA_DEPTH || arenaHeight < 4) {
+        cerr << "Bad arena size: " << argv[i] << ", using the classic size" << endl;
+        arenaWidth = GAMEAREA_WIDTH, arenaHeight = GAMEAREA_HEIGHT, arenaDepth = GAMEAREA_DEPTH;
+      }
+    }else if (!strcmp(argv[i], "-s")) {
+      settle = true;
+    }else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+      cout << "Usage:" << endl;
+      cout << "  ./bench [-a WIDTHxHEIGHTxDEPTH] [-s] [ticks]" << endl;
+      return 0;
+    }else ticks = atoi(argv[i]);
+  }
+
+  srand(1); // the same game every run
+  setArena(arenaWidth, arenaHeight, arenaDepth);
+  findShapes();
+  scheduler.after(newBlockMs, newBlock, 0);
+  scheduler.after(BENCH_GRAVITY_MS, gravity, 0);
+
+  // feed the scheduler exactly the time for the ticks wanted, a few ticks at
+  // a time so its catch up limit doesn't drop any
+  clock_t start = clock();
+  for (int now = 0; scheduler.getTick() < ticks; ) {
+    now += SIM_TICK_MS * (ticks - scheduler.getTick() < SIM_MAX_TICKS ? ticks - scheduler.getTick() : SIM_MAX_TICKS);
+    scheduler.advance(now, tick);
+  }
+  double seconds = (double) (clock() - start - choosing) / CLOCKS_PER_SEC;
+
+  cout << "Game area: " << collisionGrid.getWidth() << "x" << collisionGrid.getHeight() << "x" << collisionGrid.getDepth() << endl;
+  cout << ticks << " ticks (" << ticks * SIM_TICK_MS / 1000 << " s of game) in " << seconds << " s";
+  if (seconds > 0) cout << ", " << (int) (ticks / seconds) << " ticks per second";
+  cout << " (and " << (double) choosing / CLOCKS_PER_SEC << " s choosing where blocks go)" << endl;
+  cout << blocksMade << " blocks, " << layers << " layers, score " << score << ", " << games << " games over, "
+       << blocks.size() << " blocks left" << endl;
+  if (settle) cout << settled << " blocks settled after layers were taken out" << endl;
+  return 0;
+}
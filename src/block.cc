@@ -18,26 +18,57 @@
  */
 
 #include <math.h>
+#include <stdlib.h>
 #include "block.h"
+#include "sweep.h"
+#include "transform.h"
+#include "scheduler.h"
+
+// the orientation tables are built at compile time, in orientation.h
+constexpr OrientationTables Orientation::tables;
+
+int Block::clock = 0;
+
+// how far a turn goes in a tick, in degrees: one degree per SECS_PER_FRAME
+static const Scalar turnPerTick = Scalar::fromFloat(SIM_TICK_MS * 0.001 / SECS_PER_FRAME);
+
+// moves and turns are over long before this many ticks, and counting no
+// further keeps the distance from overflowing
+#define BLOCK_MAX_ELAPSED_TICKS 16384
+
+// Get the ticks from the start of a move or turn to a time
+//   start - the clock tick it started at
+//   t - the clock tick
+static Scalar elapsedTicks(int start, int t)
+{
+  int ticks = t - start;
+  if (ticks < 0) ticks = 0;
+  if (ticks > BLOCK_MAX_ELAPSED_TICKS) ticks = BLOCK_MAX_ELAPSED_TICKS;
+  return Scalar(ticks);
+}
 
 // Block constructor
 //   initId - the identification number to assign to the block
 //   t - the type of the block
 //   initX,Y,Z - the initial coordinates for the block
 //   initInteractive - boolean value representing whether the block is interactive or not
-//   collisionArray - the collision array
+//   grid - the collision grid
 //   boundaries - the game area boundaries
-Block::Block(int initId, int t, float initX, float initY, float initZ, bool initInteractive, int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], float boundaries[])
+Block::Block(int initId, int t, float initX, float initY, float initZ, bool initInteractive, CollisionGrid &grid, float boundaries[])
 {
   id = initId; // unique identifier, used in collision detection
+  orientation = 0;
   setType(t); // clears and sets data, color and pivotX,Y,Z
-  // data is a 5x5x5 3D vector
+  // data is a 5x5x5 bit mask
   x = initX, y = initY, z = initZ;
   oldX = x, oldY = y, oldZ = z;
   confirmedX = x, confirmedY = y, confirmedZ = z;
   oldConfirmedX = confirmedX, oldConfirmedY = confirmedY, oldConfirmedZ = confirmedZ;
   turning = false, moving = false;
-  targetAngleX = 0.0, targetAngleY = 0.0, targetAngleZ = 0.0;
+  targetAngleX = 0, targetAngleY = 0, targetAngleZ = 0;
+  moveFromX = Scalar::fromFloat(x), moveFromY = Scalar::fromFloat(y), moveFromZ = Scalar::fromFloat(z);
+  moveStart = clock, turnStart = clock;
+  turnFresh = false, turnSwept = false;
   //mode = m;
   arrows = false;
   setMode(MODE_GLOBAL_REFERENCE); // ensures m is valid and sets arrows accordingly
@@ -52,153 +83,151 @@ Block::Block(int initId, int t, float initX, float initY, float initZ, bool init
   gameOver = false;
   speed = 0.15;
 
-  // set up identity matrix
-  for (int i = 0, j = 0; i < 16; i++) {
-    matrix[i] = 0.0;
-    if (i == j) {
-      matrix[i] = 1.0;
-      j += 5;
-    }
-  }
+  // start unrotated
+  setOrientation(0);
 
   matrixCopy(matrix, oldMatrix);
   matrixCopy(matrix, confirmedMatrix);
 
   turnedX = 0.0, turnedY = 0.0, turnedZ = 0.0;
 
-  lastStored.clear();
+  fragment = false;
+
+  placeInGrid(grid, boundaries);
+  poseKey = 0;
+  hashPose(grid, true);
+  storeLast(); // nothing to draw it moving from
+}
+
+// Fragment constructor, for the piece of a block left over from a removed
+// layer. The fragment keeps the parent's type, colour, position and
+// orientation, but only a connected group of its cubes.
+//   initId - the identification number to assign to the fragment
+//   parent - the block that has been broken up
+//   group - which of the parent's cubes to keep, bit i for cube i
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+Block::Block(int initId, const Block &parent, unsigned int group, CollisionGrid &grid, float boundaries[]) : Block(parent)
+{
+  id = initId;
+  fragment = true;
+
+  // drop the cubes that belong to other fragments
+  Cell drop[BLOCK_MAX_CUBES];
+  int numDrop = 0;
+  for (int i = 0; i < numCubes; i++)
+    if (!(group & (1u << i))) drop[numDrop++] = cubes[i];
+  for (int i = 0; i < numDrop; i++) setCube(drop[i].x, drop[i].y, drop[i].z, false);
+
+  // settle into the nearest resting orientation, in case the parent was
+  // part way through a turn
+  setOrientation(Orientation::fromMatrix(matrix));
+  x = roundf(x), y = roundf(y), z = roundf(z);
+  oldX = x, oldY = y, oldZ = z;
+  confirmedX = x, confirmedY = y, confirmedZ = z;
+  oldConfirmedX = confirmedX, oldConfirmedY = confirmedY, oldConfirmedZ = confirmedZ;
+  matrixCopy(matrix, oldMatrix);
+  matrixCopy(matrix, confirmedMatrix);
+  turnedX = 0.0, turnedY = 0.0, turnedZ = 0.0;
+
+  turning = false, moving = false;
+  targetX = 0, targetY = 0, targetZ = 0;
+  targetAngleX = 0, targetAngleY = 0, targetAngleZ = 0;
+  Transform::toFixed(matrix, turnFrom);
+  moveFromX = Scalar::fromFloat(x), moveFromY = Scalar::fromFloat(y), moveFromZ = Scalar::fromFloat(z);
+  turnFresh = false, turnSwept = false;
+  interactive = false;
+  grounded = false;
+  hitCount = 0;
+  lockedBy = -1;
+  remoteMovement = false;
+  wallMarkAlpha = 0.0;
+  gotConfirmed = false;
+  gameOver = false;
+
+  placeInGrid(grid, boundaries);
+  poseKey = 0; // the parent's key is still in, until it goes
+  hashPose(grid, true);
+  storeLast(); // nothing to draw it moving from
+}
+
+// Put the block's cubes in the collision grid where they are now, as its
+// collision trail (for a new block, its first)
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+void Block::placeInGrid(CollisionGrid &grid, float boundaries[])
+{
+  newPositionSize = 0;
+  lastStoredSize = 0;
   float wx = 0, wy = 0, wz = 0;
   int worldX = 0, worldY = 0, worldZ = 0;
-  vector <int> pos;
-
-  // go through block array
-  for (int z = 0; z < 5; z++) {
-    for (int y = 0; y < 5; y++) {
-      for (int x = 0; x < 5; x++) {
-        if (data[x][y][z] == 1) { // if there's a block here
-          // get world coords of current block
-          wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-          worldCoords(wx, wy, wz);
-          worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
-
-          // check we're in range (to stop any annoying segfaults)
-          if (worldX < 0 || worldY < 0 || worldZ < 0 ||
-              //worldX >= (int) collisionArray.size() || worldY >= (int) collisionArray[0].size() ||
-              //worldZ >= (int) collisionArray[0][0].size()) {
-              worldX >= GAMEAREA_WIDTH || worldY >= GAMEAREA_HEIGHT ||
-              worldZ >= GAMEAREA_DEPTH) {
-            cerr << "Block::Block - attempt to check a world coordinate outside of collision array bounds" << endl;
-            cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
-          }else{
-            if (collisionArray[worldX][worldY][worldZ] > 0) {
-              //cout << "Block constructor detected GAME OVER" << endl;
-              gameOver = true;
-            }
-            collisionArray[worldX][worldY][worldZ] = id;
-            pos.clear();
-            pos.push_back(worldX);
-            pos.push_back(worldY);
-            pos.push_back(worldZ);
-            lastStored.push_back(pos);
-          }
-        }
+
+  // go through block cubes
+  for (int i = 0; i < numCubes; i++) {
+    // get world coords of current block
+    cubeCoords(i, wx, wy, wz);
+    worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
+
+    // check we're in range (to stop any annoying segfaults)
+    if (!grid.inside(worldX, worldY, worldZ)) {
+      cerr << "Block::placeInGrid - attempt to check a world coordinate outside of collision array bounds" << endl;
+      cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
+    }else{
+      if (grid.getId(worldX, worldY, worldZ) > 0) {
+        //cout << "Block::placeInGrid detected GAME OVER" << endl;
+        gameOver = true;
       }
+      grid.setResting(worldX, worldY, worldZ, id);
+      Cell pos = { worldX, worldY, worldZ };
+      lastStored[lastStoredSize++] = pos;
     }
   }
 
   // we've put the block in the collision array, so store the size of
   // lastStored
-  safelyStoredSize = lastStored.size();
+  safelyStoredSize = lastStoredSize;
+  heldSize = lastStoredSize;
 }
 
 // Sets the type of the block and creates its shape and colour based on this
 //   t - the type of the block
 void Block::setType(int t)
 {
+  if (t < 0 || t >= BLOCK_TYPES) t = 0; // just one block
   type = t;
 
-  vector <int> temp; // temporary store to initialise 2D vector
-  vector <vector <int> > temp2; // temporary store to initialise 3D vector
-
-  data.clear();
-
-  // make 5x5x5 3D vector
-  temp.push_back(0);
-  temp.push_back(0);
-  temp.push_back(0);
-  temp.push_back(0);
-  temp.push_back(0);
-  temp2.push_back(temp);
-  temp2.push_back(temp);
-  temp2.push_back(temp);
-  temp2.push_back(temp);
-  temp2.push_back(temp);
-  data.push_back(temp2);
-  data.push_back(temp2);
-  data.push_back(temp2);
-  data.push_back(temp2);
-  data.push_back(temp2);
+  shape[0] = 0, shape[1] = 0;
+  numCubes = 0;
+
+  // cubes and pivot come from the shape table in orientation.h
+  const BlockShape &s = BLOCK_SHAPES[t];
+  for (int i = 0; i < s.numCubes; i++) setCube(s.cubes[i].x, s.cubes[i].y, s.cubes[i].z, true);
+  pivotX = s.pivot.x * 5, pivotY = s.pivot.y * 5, pivotZ = s.pivot.z * 5;
 
   switch (t) {
     case 1: // corner block
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[0][1][0] = 1;
-      data[0][0][1] = 1;
       color[0] = 0.8, color[1] = 0.5, color[2] = 0.5, color[3] = 1.0;
-      pivotX = 0, pivotY = 0, pivotZ = 0;
       break;
     case 2: // L shape
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[2][0][0] = 1;
-      data[0][0][1] = 1;
       color[0] = 0.5, color[1] = 0.8, color[2] = 0.5, color[3] = 1.0;
-      pivotX = 5, pivotY = 0, pivotZ = 0;
       break;
     case 3: // kind of S shape
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[0][1][0] = 1;
-      data[0][1][1] = 1;
       color[0] = 0.2, color[1] = 0.7, color[2] = 1.0, color[3] = 1.0;
-      pivotX = 0, pivotY = 0, pivotZ = 0;
       break;
     case 4: // other kind of S shape
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[0][1][0] = 1;
-      data[1][0][1] = 1;
       color[0] = 1.0, color[1] = 1.0, color[2] = 0.4, color[3] = 1.0;
-      pivotX = 0, pivotY = 0, pivotZ = 0;
       break;
     case 5: // Z shape
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[1][1][0] = 1;
-      data[2][1][0] = 1;
       color[0] = 0.8, color[1] = 0.5, color[2] = 0.8, color[3] = 1.0;
-      pivotX = 5, pivotY = 0, pivotZ = 0;
       break;
     case 6: // T shape
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[2][0][0] = 1;
-      data[1][1][0] = 1;
       color[0] = 0.5, color[1] = 0.8, color[2] = 0.8, color[3] = 1.0;
-      pivotX = 5, pivotY = 0, pivotZ = 0;
       break;
     case 7: // Small L shape
-      data[0][0][0] = 1;
-      data[1][0][0] = 1;
-      data[0][1][0] = 1;
       color[0] = 0.7, color[1] = 0.7, color[2] = 1.0, color[3] = 1.0;
-      pivotX = 0, pivotY = 0, pivotZ = 0;
       break;
     default: // type 0, just one block
-      data[0][0][0] = 1; // set to pivot point
       color[0] = 0.8, color[1] = 0.8, color[2] = 0.8, color[3] = 1.0;
-      pivotX = 0, pivotY = 0, pivotZ = 0;
       break;
   }
 
@@ -209,12 +238,45 @@ int Block::getType()
   return type;
 }
 
+// Set or clear a cube in the block data, keeping the cube list in step
+//   x,y,z - the units of data to change
+//   on - true to add a cube here, false to remove it
+void Block::setCube(int x, int y, int z, bool on)
+{
+  int bit = x + y * BLOCK_DATA_SIZE + z * BLOCK_DATA_SIZE * BLOCK_DATA_SIZE;
+
+  if (on) shape[bit / 64] |= 1ULL << (bit % 64);
+  else shape[bit / 64] &= ~(1ULL << (bit % 64));
+
+  // rebuild the cube list from the mask, so it stays in x, y, z order
+  numCubes = 0;
+  for (int word = 0; word < 2; word++) {
+    unsigned long long bits = shape[word];
+    while (bits) {
+      int b = word * 64 + __builtin_ctzll(bits);
+      bits &= bits - 1;
+      if (numCubes == BLOCK_MAX_CUBES) {
+        cerr << "Block::setCube - too many cubes in block " << id << endl;
+        break;
+      }
+      cubes[numCubes].x = b % BLOCK_DATA_SIZE;
+      cubes[numCubes].y = b / BLOCK_DATA_SIZE % BLOCK_DATA_SIZE;
+      cubes[numCubes].z = b / (BLOCK_DATA_SIZE * BLOCK_DATA_SIZE);
+      cubeSlot[numCubes] = Orientation::slot(type, cubes[numCubes].x, cubes[numCubes].y, cubes[numCubes].z);
+      numCubes++;
+    }
+  }
+
+  updateFootprint();
+}
+
 // Gets the block data at a specified array location
 //   x,y,z - the units of data to access
 int Block::getData(int x, int y, int z) const
 {
-  if (x > -1 && x < 5 && y > -1 && y < 5 && z > -1 && 5) {
-    return data[x][y][z];
+  if (x > -1 && x < BLOCK_DATA_SIZE && y > -1 && y < BLOCK_DATA_SIZE && z > -1 && z < BLOCK_DATA_SIZE) {
+    int bit = x + y * BLOCK_DATA_SIZE + z * BLOCK_DATA_SIZE * BLOCK_DATA_SIZE;
+    return (shape[bit / 64] >> (bit % 64)) & 1;
   }else{
     return -1; // out of range
   }
@@ -224,12 +286,7 @@ int Block::getData(int x, int y, int z) const
 //   angle - the angle to rotate in degrees
 void Block::rotateX(float angle)
 {
-  glPushMatrix();
-  glLoadIdentity();
-  glRotatef(angle, 1.0, 0.0, 0.0);
-  glMultMatrixf(matrix);
-  glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
-  glPopMatrix();
+  Transform::rotate(matrix, angle, 1.0, 0.0, 0.0);
 
   turnedX += angle;
 }
@@ -238,12 +295,7 @@ void Block::rotateX(float angle)
 //   angle - the angle to rotate in degrees
 void Block::rotateY(float angle)
 {
-  glPushMatrix();
-  glLoadIdentity();
-  glRotatef(angle, 0.0, 1.0, 0.0);
-  glMultMatrixf(matrix);
-  glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
-  glPopMatrix();
+  Transform::rotate(matrix, angle, 0.0, 1.0, 0.0);
 
   turnedY += angle;
 }
@@ -252,12 +304,7 @@ void Block::rotateY(float angle)
 //   angle - the angle to rotate in degrees
 void Block::rotateZ(float angle)
 {
-  glPushMatrix();
-  glLoadIdentity();
-  glRotatef(angle, 0.0, 0.0, 1.0);
-  glMultMatrixf(matrix);
-  glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
-  glPopMatrix();
+  Transform::rotate(matrix, angle, 0.0, 0.0, 1.0);
 
   turnedZ += angle;
 }
@@ -266,12 +313,7 @@ void Block::rotateZ(float angle)
 //   x,y,z - the direction in which to move the block
 void Block::translate(float x, float y, float z)
 {
-  glPushMatrix();
-  glLoadIdentity();
-  glTranslatef(x, y, z);
-  glMultMatrixf(matrix);
-  glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
-  glPopMatrix();
+  Transform::translate(matrix, x, y, z);
 }
 
 // Snap the block to position
@@ -346,139 +388,194 @@ bool Block::toTarget(float &var, float amount, float target)
   else return false;
 }
 
-// Turn the block in a global frame of reference
-void Block::turnGlobalReference( const float timeSecs )
+// Work out the block's rotation part way through its turn. A turn goes
+// through targetAngleX, then Y, then Z, at one degree per SECS_PER_FRAME,
+// starting from turnFrom at turnStart. It's worked out in fixed point, so
+// it's the same on every machine.
+//   t - the game clock tick (see setClock)
+//   m - the matrix to fill
 //
-// timeSecs   IN    Time (s) to be used to calculate movement
+// Returns:
+//   true if the turn is over by time t
+bool Block::getTurnAt(int t, float m[16]) const
+{
+  if (!turning) {
+    Transform::toFloat(turnFrom, m);
+    return true;
+  }
+
+  Scalar r[16];
+  for (int i = 0; i < 16; i++) r[i] = turnFrom[i];
+
+  Scalar elapsed = elapsedTicks(turnStart, t) * turnPerTick;
+  Scalar degrees = elapsed;
+
+  const Scalar target[3] = { targetAngleX, targetAngleY, targetAngleZ };
+  for (int axis = 0; axis < 3; axis++) {
+    if (target[axis] == 0) continue;
+    Scalar angle = target[axis].abs();
+    if (degrees < angle) angle = degrees;
+    degrees -= angle;
+    Transform::rotate(r, target[axis] > 0 ? angle : -angle, axis);
+  }
+  Transform::toFloat(r, m);
+
+  return elapsed >= targetAngleX.abs() + targetAngleY.abs() + targetAngleZ.abs();
+}
+
+// Turn the block in a global frame of reference, to its rotation at the
+// current clock time
 //
+// Returns:
+//   true if the turn is over
+bool Block::turnGlobalReference()
 {
-  //
-  // Old version hard coded an angle increment of 1.0
-  //
-  //float angle = (float) ((int) (1.0 * timeSecs / SECS_PER_FRAME));
-  float angle = 1.0 * timeSecs / SECS_PER_FRAME;
-
-  if (targetAngleX > 0) {
-    toTarget(targetAngleX, angle, 0.0);
-    rotateX(angle);
-    //cout << " " << targetAngleX;
-  }else if (targetAngleX < 0) {
-    toTarget(targetAngleX, angle, 0.0);
-    rotateX(-angle);
-    //cout << " " << targetAngleX;
-  }else if (targetAngleY > 0) {
-    toTarget(targetAngleY, angle, 0.0);
-    rotateY(angle);
-  }else if (targetAngleY < 0) {
-    toTarget(targetAngleY, angle, 0.0);
-    rotateY(-angle);
-  }else if (targetAngleZ > 0) {
-    toTarget(targetAngleZ, angle, 0.0);
-    rotateZ(angle);
-  }else if (targetAngleZ < 0) {
-    toTarget(targetAngleZ, angle, 0.0);
-    rotateZ(-angle);
-  }else{
-    turning = false;
-    matrixCorrectRoundingError( matrix ); // Hack (RAR)
-    matrixCopy(matrix, oldMatrix);
-    //matrixPrint( matrix );
+  float m[16];
+  bool done = getTurnAt(clock, m);
+  matrixCopy(m, matrix);
+  return done;
+}
+
+// Finish a turn: snap to the nearest of the 24 orientations, which also
+// gets rid of any rounding error in the rotation
+void Block::endTurn()
+{
+  turning = false;
+  turnFresh = false, turnSwept = false;
+  turnedX += targetAngleX.toFloat(), turnedY += targetAngleY.toFloat(), turnedZ += targetAngleZ.toFloat();
+  targetAngleX = 0, targetAngleY = 0, targetAngleZ = 0;
+  setOrientation(Orientation::fromMatrix(matrix));
+  matrixCopy(matrix, oldMatrix);
+  Transform::toFixed(matrix, turnFrom);
+}
+
+// Start a turn from where the block is now. If it's already part way
+// through a turn, that carries on from here, less the angle already turned,
+// and is checked a tick at a time from now on.
+void Block::restartTurn()
+{
+  turnFresh = !turning; // a turn from rest can be checked in one go
+  turnSwept = false;
+
+  if (turning) {
+    turnGlobalReference();
+    Scalar degrees = elapsedTicks(turnStart, clock) * turnPerTick;
+    Scalar *target[3] = { &targetAngleX, &targetAngleY, &targetAngleZ };
+    for (int axis = 0; axis < 3 && degrees > 0; axis++) {
+      Scalar angle = target[axis]->abs();
+      if (degrees < angle) angle = degrees;
+      degrees -= angle;
+      *target[axis] += (*target[axis] > 0) ? -angle : angle;
+    }
   }
+  Transform::toFixed(matrix, turnFrom);
+  turnStart = clock;
 }
 
 // Turn the block to its target angle
 void Block::turnToTarget()
 {
   cout << "ho!" << endl;
-  bool target1 = toTarget(angleX, 0.2, targetAngleX);
-  bool target2 = toTarget(angleY, 0.2, targetAngleY);
-  bool target3 = toTarget(angleZ, 0.2, targetAngleZ);
+  bool target1 = toTarget(angleX, 0.2, targetAngleX.toFloat());
+  bool target2 = toTarget(angleY, 0.2, targetAngleY.toFloat());
+  bool target3 = toTarget(angleZ, 0.2, targetAngleZ.toFloat());
   if (target1 && target2 && target3) {
     turning = false;
     matrixCopy(matrix, oldMatrix);
     cout << "before loop: x,y,z: " << angleX << ", " << angleY << ", " << angleZ << endl;
     loopAngles();
-    targetAngleX = angleX, targetAngleY = angleY, targetAngleZ = angleZ;
+    targetAngleX = Scalar::fromFloat(angleX), targetAngleY = Scalar::fromFloat(angleY), targetAngleZ = Scalar::fromFloat(angleZ);
     cout << "after loop: x,y,z: " << angleX << ", " << angleY << ", " << angleZ << endl;
   }
 }
 
-// Move the block
-//   blocks - the vector storing all the game blocks
-//   boundaries - the game boundaries
-//   collisionArray - the array used for collision detection purposes
-void Block::move(vector <Block> &blocks, float boundaries[],
-  int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH],
-  const float timeSecs )
-//
-// timeSecs   IN    Time (s) to be used to calculate movement
+// Work out where the block is part way through its move. A move goes along
+// x, then y, then z, at speed per SECS_PER_FRAME, starting from moveFromX,Y,Z
+// at moveStart. It's worked out in fixed point, as getTurnAt.
+//   t - the game clock tick (see setClock)
+//   px,py,pz - the position is assigned to these variables
 //
+// Returns:
+//   true if the move is over by time t
+bool Block::getPositionAt(int t, float &px, float &py, float &pz) const
+{
+  if (!moving) {
+    px = x, py = y, pz = z;
+    return true;
+  }
+
+  Scalar elapsed = elapsedTicks(moveStart, t) * Scalar::fromFloat(speed) * turnPerTick;
+  Scalar dist = elapsed;
+
+  Scalar pos[3] = { moveFromX, moveFromY, moveFromZ };
+  const Scalar target[3] = { targetX, targetY, targetZ };
+  for (int axis = 0; axis < 3; axis++) {
+    Scalar d = (target[axis] - pos[axis]).abs();
+    if (dist < d) d = dist;
+    dist -= d;
+    pos[axis] += (target[axis] > pos[axis]) ? d : -d;
+  }
+  px = pos[0].toFloat(), py = pos[1].toFloat(), pz = pos[2].toFloat();
+
+  return elapsed >= (targetX - moveFromX).abs() + (targetY - moveFromY).abs() + (targetZ - moveFromZ).abs();
+}
+
+// Move the block to where its move and turn put it at the current clock
+// time, then check for collisions
+//   boundaries - the game boundaries
+//   grid - the collision grid
+void Block::move(float boundaries[], CollisionGrid &grid)
 {
-  //
-  // Moves blocks at speed that's independent of framerate
-  //
-  float dist = speed * timeSecs / SECS_PER_FRAME;
+  bool turnDone = false, moveDone = false;
+
+  // a quarter turn is checked once, as it starts
+  if (turning && turnFresh) {
+    turnFresh = false;
+    if (mode == MODE_GLOBAL_REFERENCE && checkTurn(grid, boundaries)) hit();
+  }
 
   if (turning) {
     switch (mode) {
       case MODE_OBJECT_REFERENCE:
-        //
-        // Not now used, so framerate-independent movement speed not
-        // implemented (RAR)
-        //
+        // not now used, so still turns a step at a time
         turnToTarget();
+        if (!turning) clearCollisionTrail(grid, true);
         break;
       case MODE_GLOBAL_REFERENCE:
-        turnGlobalReference( timeSecs );
+        turnDone = turnGlobalReference();
         break;
       case MODE_VIEWING_REFERENCE:
         // not yet implemented
         break;
     }
-
-    // no longer turning, clear collision trail and 'true': store newPosition
-    if (!turning) clearCollisionTrail(collisionArray, true);
   }
 
-  if (moving) {
-    //
-    // did move at 0.1, now moves at speed
-    // Changed 'speed' to 'dist' so movement is at speed independent of
-    // framerate (RAR)
-    //
-    if (x < targetX) {
-      //translate(1, 0, 0);
-      toTarget(x, dist, targetX);
-    }else if (x > targetX) {
-      //translate(-1, 0, 0);
-      toTarget(x, dist, targetX);
-    }else if (y < targetY) {
-      //translate(0, 1, 0);
-      toTarget(y, dist, targetY);
-    }else if (y > targetY) {
-      //translate(0, -1, 0);
-      toTarget(y, dist, targetY);
-    }else if (z < targetZ) {
-      //translate(0, 0, 1);
-      toTarget(z, dist, targetZ);
-    }else if (z > targetZ) {
-      //translate(0, 0, -1);
-      toTarget(z, dist, targetZ);
-    }else{
-      x = roundf(x), y = roundf(y), z = roundf(z);
-      oldX = x, oldY = y, oldZ = z;
-      moving = false;
-      clearCollisionTrail(collisionArray, true);
-    }
-  }
+  if (moving) moveDone = getPositionAt(clock, x, y, z);
 
   if (turning || moving) {
-    //if (checkCollision(blocks, boundaries)) hit();
-    if (checkCollision(collisionArray, boundaries)) hit();
+    // check the pose it has reached before finishing the move or turn
+    // (a turn already checked in one go doesn't need it)
+    bool checked = (turning && !turnSwept) || moving;
+    if (checked && checkCollision(grid, boundaries)) hit();
+    else {
+      if (turnDone) endTurn();
+      if (moveDone) {
+        x = roundf(x), y = roundf(y), z = roundf(z);
+        oldX = x, oldY = y, oldZ = z;
+        moving = false;
+      }
+      // finished turning or moving: clear collision trail and 'true': store
+      // newPosition (from where it has ended up, if it wasn't checked)
+      if (!checked) newPositionSize = getCells(newPosition, grid, boundaries);
+      if (turnDone || moveDone) clearCollisionTrail(grid, true);
+    }
   }
-    
+
   // collision leaves a mark on the wall which fades away
   if (wallMarkAlpha > 0.0) wallMarkAlpha -= 0.01;
+
+  // a block that has landed and been let go of has nothing to change
+  if (!grounded || poseKey) hashPose(grid, true);
 }
 
 // Get block's moving status
@@ -502,14 +599,9 @@ void Block::setMode(int m)
       targetAngleX = 0, targetAngleY = 0, targetAngleZ = 0;
       angleX = 0, angleY = 0, angleZ = 0;
       // TODO this is set up in constructor also - perhaps it should only be done here??
-      // set up identity matrix
-      for (int i = 0, j = 0; i < 16; i++) {
-        matrix[i] = 0.0;
-        if (i == j) {
-          matrix[i] = 1.0;
-          j += 5;
-        }
-      }
+      // back to unrotated
+      setOrientation(0);
+      Transform::toFixed(matrix, turnFrom);
     }
   }
 }
@@ -519,7 +611,9 @@ void Block::setMode(int m)
 void Block::setTargetPosition(float nx, float ny, float nz)
 {
   oldX = x, oldY = y, oldZ = z;
-  targetX = nx, targetY = ny, targetZ = nz;
+  moveFromX = Scalar::fromFloat(x), moveFromY = Scalar::fromFloat(y), moveFromZ = Scalar::fromFloat(z);
+  moveStart = clock;
+  targetX = Scalar::fromFloat(nx), targetY = Scalar::fromFloat(ny), targetZ = Scalar::fromFloat(nz);
   //targetX = targetX / 5 * 5;
   //targetY = targetY / 5 * 5;
   //targetZ = targetZ / 5 * 5;
@@ -531,7 +625,10 @@ void Block::setTargetPosition(float nx, float ny, float nz)
 //   nx,y,z - the coordinates of the target position
 void Block::changeTargetPosition(float nx, float ny, float nz)
 {
-  targetX = nx, targetY = ny, targetZ = nz;
+  // carry on from where it has got to
+  moveFromX = Scalar::fromFloat(x), moveFromY = Scalar::fromFloat(y), moveFromZ = Scalar::fromFloat(z);
+  moveStart = clock;
+  targetX = Scalar::fromFloat(nx), targetY = Scalar::fromFloat(ny), targetZ = Scalar::fromFloat(nz);
 }
 
 // Get the coordinates of the pivot cube
@@ -560,19 +657,19 @@ int Block::getPivotZ()
 // Get the x target coordinate
 float Block::getTargetX()
 {
-  return targetX;
+  return targetX.toFloat();
 }
 
 // Get the y target coordinate
 float Block::getTargetY()
 {
-  return targetY;
+  return targetY.toFloat();
 }
 
 // Get the z target coordinate
 float Block::getTargetZ()
 {
-  return targetZ;
+  return targetZ.toFloat();
 }
 
 // Set the target x angle
@@ -584,7 +681,8 @@ void Block::setTargetAngleX(const float a)
 // 'a' is always 90 or -90
 //
 {
-  targetAngleX = a;
+  restartTurn();
+  targetAngleX = Scalar::fromFloat(a);
   //cout << endl << "x " << targetAngleX << endl;
   turning = true;
 }
@@ -593,7 +691,8 @@ void Block::setTargetAngleX(const float a)
 //   a - the target angle
 void Block::setTargetAngleY(const float a)
 {
-  targetAngleY = a;
+  restartTurn();
+  targetAngleY = Scalar::fromFloat(a);
   //cout << "y " << targetAngleY << endl;
   turning = true;
 }
@@ -602,7 +701,8 @@ void Block::setTargetAngleY(const float a)
 //   a - the target angle
 void Block::setTargetAngleZ(const float a)
 {
-  targetAngleZ = a;
+  restartTurn();
+  targetAngleZ = Scalar::fromFloat(a);
   //cout << "z " << targetAngleZ << endl;
   turning = true;
 }
@@ -610,19 +710,19 @@ void Block::setTargetAngleZ(const float a)
 // Get the target x angle
 float Block::getTargetAngleX()
 {
-  return targetAngleX;
+  return targetAngleX.toFloat();
 }
 
 // Get the target y angle
 float Block::getTargetAngleY()
 {
-  return targetAngleY;
+  return targetAngleY.toFloat();
 }
 
 // Get the target z angle
 float Block::getTargetAngleZ()
 {
-  return targetAngleZ;
+  return targetAngleZ.toFloat();
 }
 
 // Change the angles of orientation
@@ -735,387 +835,188 @@ bool Block::getGameOver()
 // Get the number of cubes that make up the block
 int Block::getNumberOfCubes()
 {
-  // count the number of cubes
-  int count = 0;
+  return numCubes;
+}
 
-  // go through block array
-  for (int z = 0; z < 5; z++) {
-    for (int y = 0; y < 5; y++) {
-      for (int x = 0; x < 5; x++) {
-        if (data[x][y][z] == 1) { // if there's a block here
-          count++;
-        }
-      }
-    }
-  }
+// Get where one of the cubes is in block data
+//   i - the cube, from 0 to getNumberOfCubes() - 1
+//   cx,cy,cz - the cube's position in block data is stored in these parameters
+void Block::getCube(int i, int &cx, int &cy, int &cz)
+{
+  cx = cubes[i].x, cy = cubes[i].y, cz = cubes[i].z;
+}
 
-  return count;
-}
-
-// Draw a curved arrow representing direction of rotation
-void Block::drawCurvedArrow()
-{
-  glNormal3f(0.0, 0.0, 1.0);
-
-  glBegin(GL_TRIANGLES);
-  glVertex3f(-3.0, -2.0, 0.0);
-  glVertex3f(-2.0, -2.0, 0.0);
-  glVertex3f(-3.0, -1.0, 0.0);
-  glEnd();
-  glBegin(GL_QUAD_STRIP);
-  glVertex3f(-2.6, -1.4, 0.0);
-  glVertex3f(-2.4, -1.6, 0.0);
-  glVertex3f(-1.0, 0.0, 0.0);
-  glVertex3f(-1.0, -0.2, 0.0);
-  glVertex3f(1.0, 0.0, 0.0);
-  glVertex3f(1.0, -0.2, 0.0);
-  glVertex3f(2.2, -0.8, 0.0);
-  glVertex3f(2.2, -1.0, 0.0);
-  glEnd();
-}
-
-// draw a flat arrow representing direction of translation
-void Block::drawArrow()
-{
-  glBegin(GL_QUADS);
-  glNormal3f(0.0, 0.0, 1.0);
-  glVertex3f(0.0, 0.0, 0.0);
-  glVertex3f(1.0, 0.0, 0.0);
-  glVertex3f(1.0, 1.0, 0.0);
-  glVertex3f(0.0, 1.0, 0.0);
-
-  glNormal3f(0.3, 0.0, 0.9);
-  glVertex3f(1.0, 0.0, 0.0);
-  glVertex3f(2.0, 0.0, 0.5);
-  glVertex3f(2.0, 1.0, 0.5);
-  glVertex3f(1.0, 1.0, 0.0);
-
-  glNormal3f(0.7, 0.0, 0.7);
-  glVertex3f(2.0, 0.0, 0.5);
-  glVertex3f(3.0, 0.0, 1.5);
-  glVertex3f(3.0, 1.0, 1.5);
-  glVertex3f(2.0, 1.0, 0.5);
-  glEnd();
-
-  glBegin(GL_TRIANGLES);
-  glNormal3f(0.9, 0.0, 0.3);
-  glVertex3f(3.0, -0.5, 1.5);
-  glVertex3f(3.5, 0.5, 2.5);
-  glVertex3f(3.0, 1.5, 1.5);
-  glEnd();
-
-  /*glNormal3f(0.0, 0.0, 1.0);
-  glBegin(GL_POLYGON);
-  glVertex3f(-1.0, 0.0, 0.0);
-  glVertex3f(0.0, -1.0, 0.0);
-  glVertex3f(1.0, 0.0, 0.0);
-  glEnd();
-
-  glBegin(GL_POLYGON);
-  glVertex3f(0.5, 0.0, 0.0);
-  glVertex3f(0.5, 1.0, 0.0);
-  glVertex3f(-0.5, 1.0, 0.0);
-  glVertex3f(-0.5, 0.0, 0.0);
-  glEnd();*/
-
-  // other side
-  /*glNormal3f(0.0, 0.0, -1.0);
-  glBegin(GL_POLYGON);
-  glVertex3f(-1.0, 0.0, 0.0);
-  glVertex3f(1.0, 0.0, 0.0);
-  glVertex3f(0.0, -1.0, 0.0);
-  glEnd();
-
-  glBegin(GL_POLYGON);
-  glVertex3f(0.5, 0.0, 0.0);
-  glVertex3f(-0.5, 0.0, 0.0);
-  glVertex3f(-0.5, 1.0, 0.0);
-  glVertex3f(0.5, 1.0, 0.0);
-  glEnd();*/
-}
-
-// Draw arrows representing directions of manipulation
-void Block::drawArrows()
-{
-  glPushMatrix();
-  glTranslatef(pivotX, pivotY, pivotZ);
-  glScalef(-2.0, 2.0, 2.0);
-  glPushMatrix();
-  //glTranslatef(0, -2, 0);
-  glColor4f(0.8, 0.5, 0.5, 1.0);
-  drawArrow(); // red right
-  //glTranslatef(0, 4, 0);
-  //glRotatef(180, 0.0, 0.0, 1.0);
-  glRotatef(180, 0.0, 1.0, 0.0);
-  //glScalef(-1.0, 1.0, 1.0);
-  //glCullFace(GL_FRONT);
-  drawArrow(); // back red
-  //glCullFace(GL_BACK);
-  glPopMatrix();
-  glPushMatrix();
-  //glTranslatef(2, 0, 0);
-  glRotatef(90, 0.0, 0.0, 1.0);
-  glColor4f(0.8, 0.8, 0.5, 1.0);
-  drawArrow(); // yellow up
-  //glTranslatef(0, 4, 0);
-  glRotatef(180, 0.0, 1.0, 0.0);
-  //glRotatef(180, 0.0, 0.0, 1.0);
-  drawArrow(); // yellow back
-  glPopMatrix();
-  glTranslatef(0, 2, 0);
-  glColor4f(0.5, 0.5, 0.8, 1.0);
-  glScalef(-1.0, 1.0, -1.0);
-  drawCurvedArrow(); // blue clockwise
-  glTranslatef(0, -4, 0);
-  glScalef(1.0, -1.0, 1.0);
-  glRotatef(180, 0.0, 1.0, 0.0);
-  glCullFace(GL_FRONT);
-  drawCurvedArrow();
-  glCullFace(GL_BACK);
-  glTranslatef(-pivotX, -pivotY, -pivotZ);
-  glPopMatrix();
-}
-
-// Draw individual block cube
-void Block::drawCube()
-{
-  float texMin = 0.0, texMax = 0.2;
-  glBegin(GL_QUADS);
-  glNormal3f(0.0, 0.0, 1.0);
-  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, -2.5, 2.5);
-  glTexCoord2f(texMax, texMin); glVertex3f(2.5, -2.5, 2.5);
-  glTexCoord2f(texMax, texMax); glVertex3f(2.5, 2.5, 2.5);
-  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, 2.5, 2.5);
-
-  glNormal3f(1.0, 0.0, 0.0);
-  glTexCoord2f(texMin, texMin); glVertex3f(2.5, -2.5, 2.5);
-  glTexCoord2f(texMax, texMin); glVertex3f(2.5, -2.5, -2.5);
-  glTexCoord2f(texMax, texMax); glVertex3f(2.5, 2.5, -2.5);
-  glTexCoord2f(texMin, texMax); glVertex3f(2.5, 2.5, 2.5);
-
-  glNormal3f(0.0, -1.0, 0.0);
-  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, -2.5, -2.5);
-  glTexCoord2f(texMax, texMin); glVertex3f(2.5, -2.5, -2.5);
-  glTexCoord2f(texMax, texMax); glVertex3f(2.5, -2.5, 2.5);
-  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, -2.5, 2.5);
-
-  glNormal3f(-1.0, 0.0, 0.0);
-  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, -2.5, -2.5);
-  glTexCoord2f(texMax, texMin); glVertex3f(-2.5, -2.5, 2.5);
-  glTexCoord2f(texMax, texMax); glVertex3f(-2.5, 2.5, 2.5);
-  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, 2.5, -2.5);
-
-  glNormal3f(0.0, 0.0, -1.0);
-  glTexCoord2f(texMin, texMin); glVertex3f(2.5, -2.5, -2.5);
-  glTexCoord2f(texMax, texMin); glVertex3f(-2.5, -2.5, -2.5);
-  glTexCoord2f(texMax, texMax); glVertex3f(-2.5, 2.5, -2.5);
-  glTexCoord2f(texMin, texMax); glVertex3f(2.5, 2.5, -2.5);
-
-  glNormal3f(0.0, 1.0, 0.0);
-  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, 2.5, 2.5);
-  glTexCoord2f(texMax, texMin); glVertex3f(2.5, 2.5, 2.5);
-  glTexCoord2f(texMax, texMax); glVertex3f(2.5, 2.5, -2.5);
-  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, 2.5, -2.5);
-  glEnd();
-}
-
-// Draw wall mark left by collision
-//   texId - the texture id's
-void Block::drawWallMark(vector <int> &texId)
-{
-  glPushMatrix();
-
-  glBindTexture(GL_TEXTURE_2D, texId[6]);
-  glEnable(GL_BLEND);
-  glDepthMask(GL_FALSE);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-  glDisable(GL_CULL_FACE);
-  glColor4f(0.8, 0.8, 0.8, wallMarkAlpha);
-
-  glNormal3f(1.0, 0.0, 0.0);
-  glTranslatef(wallMark[0], wallMark[1], wallMark[2]);
-
-  switch((int) wallMark[3]) {
-    case 1:
-      glRotatef(90, 0.0, 1.0, 0.0);
-      break;
-    case 2:
-      glRotatef(180, 0.0, 1.0, 0.0);
-      break;
-    case 3:
-      glRotatef(270, 0.0, 1.0, 0.0);
-      break;
-  }
-      
-  float size = 5.0;
-  glBegin(GL_QUADS);
-  glTexCoord2f(0.0, 0.0); glVertex3f(-size, -size, 2.5);
-  glTexCoord2f(1.0, 0.0); glVertex3f(size, -size, 2.5);
-  glTexCoord2f(1.0, 1.0); glVertex3f(size, size, 2.5);
-  glTexCoord2f(0.0, 1.0); glVertex3f(-size, size, 2.5);
-  glEnd();
-
-  glDisable(GL_BLEND);
-  glDepthMask(GL_TRUE);
-  glEnable(GL_CULL_FACE);
-
-  glPopMatrix();
-}
-
-// Draw the block
-//   texId - the texture id's
-//   selected - defines whether the block is selected (true) or not (false)
-void Block::draw(vector <int>& texId, bool selected)
-{
-  glPushMatrix();
-  //glLoadIdentity();
-  glTranslatef(x, y, z); // move to position
-  glPushMatrix(); // retain current matrix for arrows
-
-  glTranslatef(pivotX, pivotY, pivotZ); // move to pivot point
-
-  if (mode == MODE_GLOBAL_REFERENCE) glMultMatrixf(matrix);
-
-  //glPushMatrix();
-  //glLoadIdentity();
-  //glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
-  //glPopMatrix();
-
-  //rotateX(angleX);
-  //rotateY(angleY);
-  //rotateZ(angleZ);
-  if (mode == MODE_OBJECT_REFERENCE) {
-    glRotatef(angleX, 1.0, 0.0, 0.0);
-    glRotatef(angleY, 0.0, 1.0, 0.0);
-    glRotatef(angleZ, 0.0, 0.0, 1.0);
+// Get the collision grid cells of the block's cubes, where they are now
+//   cells - filled with up to BLOCK_MAX_CUBES cells
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//
+// Returns:
+//   the number of cells filled in (cubes outside the grid are left out)
+int Block::getCells(Cell cells[], const CollisionGrid &grid, float boundaries[])
+{
+  float wx = 0, wy = 0, wz = 0;
+  int n = 0;
+
+  for (int i = 0; i < numCubes; i++) {
+    cubeCoords(i, wx, wy, wz);
+    Cell cell = { (int) roundf((wx - boundaries[0]) / 5.0), (int) roundf(wy / 5.0), (int) roundf((wz - boundaries[2]) / 5.0) };
+    if (grid.inside(cell.x, cell.y, cell.z)) cells[n++] = cell;
   }
-  //glMultMatrixf(matrix);
 
-  glTranslatef(-pivotX, -pivotY, -pivotZ); // move back (from pivot)
+  return n;
+}
 
-  glGetFloatv(GL_MODELVIEW_MATRIX, outputMatrix);
-  
-  glColor4fv(color);
-  // set material properties
-  GLfloat matAmbDiff0[] = { 0.8, 0.8, 0.8, 1.0};
-  GLfloat matSpecular0[] = { 0.2, 0.2, 0.2, 1.0};
-  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, matAmbDiff0);
-  glMaterialfv(GL_FRONT, GL_SPECULAR, matSpecular0);
-  glMaterialf(GL_FRONT, GL_SHININESS, 10);
-
-  if (interactive) glBindTexture(GL_TEXTURE_2D, texId[4]);
-  else glBindTexture(GL_TEXTURE_2D, texId[6]);
-
-  /*glBegin(GL_QUADS);
-  glNormal3f(0.0, 1.0, 0.0);
-  glVertex3f(-20.0, 1.0, 1.0);
-  glVertex3f(20.0, 1.0, 1.0);
-  glVertex3f(20.0, 1.0, -1.0);
-  glVertex3f(-20.0, 1.0, -1.0);
-
-  glNormal3f(0.0, 0.0, 1.0);
-  glVertex3f(-20.0, -1.0, 1.0);
-  glVertex3f(20.0, -1.0, 1.0);
-  glVertex3f(20.0, 1.0, 1.0);
-  glVertex3f(-20.0, 1.0, 1.0);
-
-  glNormal3f(0.0, 0.0, -1.0);
-  glVertex3f(-20.0, 1.0, -1.0);
-  glVertex3f(20.0, 1.0, -1.0);
-  glVertex3f(20.0, -1.0, -1.0);
-  glVertex3f(-20.0, -1.0, -1.0);
-  
-  glNormal3f(0.0, -1.0, 0.0);
-  glVertex3f(-20.0, -1.0, 1.0);
-  glVertex3f(-20.0, -1.0, -1.0);
-  glVertex3f(20.0, -1.0, -1.0);
-  glVertex3f(20.0, -1.0, 1.0);
-  glEnd();*/
-
-  for (int k = 0; k < 5; k++) {
-    for (int j = 0; j < 5; j++) {
-      for (int i = 0; i < 5; i++) {
-
-        if (data[i][j][k] == 1) {
-          glPushMatrix();
-          glTranslatef(i * 5.0, j * 5.0, k * 5.0);
-          //glutSolidCube(5.0);
-          if (i * 5 == pivotX && j * 5 == pivotY && k * 5 == pivotZ && selected && !arrows) {
-            // draw triangle in pivot block
-            /*glDisable(GL_DEPTH_TEST);
-            glDisable(GL_CULL_FACE);
-
-            glColor4f(0.2, 0.2, 0.2, 1.0);
-            glBegin(GL_TRIANGLES);
-            glNormal3f(0.0, 0.0, 1.0);
-            glVertex3f(-0.5, -0.5, 0.0);
-            glVertex3f(0.5, -0.5, 0.0);
-            glVertex3f(0.0, 0.5, 0.0);
-            glEnd();
-            
-            glColor4fv(color);
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);*/
-            // highlight pivot block
-            glColor4f(color[0]*1.2, color[1]*1.2, color[2]*1.2, 1.0);
-            //glDisable(GL_TEXTURE_2D);
-          }else{
-            glColor4fv(color);
-            //glEnable(GL_TEXTURE_2D);
-          }
-          drawCube();
-          glPopMatrix();
-        }
+// Is this a fragment of a block that lost a layer?
+bool Block::getFragment()
+{
+  return fragment;
+}
 
-      }
+// Find how far the block could fall straight down, from the grid's
+// heightmap rather than by moving it. Only the lowest cube in each column
+// needs looking at, as the cubes above it can't land first.
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//   restingOnly - only land on resting cells, ignoring other blocks' trails
+//
+// Returns:
+//   the number of layers it could fall (0 while it is turning)
+int Block::dropDistance(const CollisionGrid &grid, float boundaries[], bool restingOnly)
+{
+  if (turning) return 0; // cubes aren't lined up with the grid
+
+  Cell cells[BLOCK_MAX_CUBES];
+  int n = getCells(cells, grid, boundaries);
+  if (n < numCubes) return 0;
+
+  int distance = grid.getHeight();
+  for (int i = 0; i < n; i++) {
+    bool lowest = true;
+    for (int j = 0; j < n && lowest; j++) {
+      if (cells[j].x == cells[i].x && cells[j].z == cells[i].z && cells[j].y < cells[i].y) lowest = false;
     }
+    if (!lowest) continue;
+
+    int d = cells[i].y - grid.getFloor(cells[i].x, cells[i].y, cells[i].z, restingOnly);
+    if (d < distance) distance = d;
   }
 
-  //glEnable(GL_TEXTURE_2D);
+  return distance;
+}
 
-  // draw arrows
-  glPopMatrix(); // end object matrix, still in initial matrix
+// Drop the block straight down in one step, onto whatever is below it
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//
+// Returns:
+//   the number of layers it fell
+int Block::drop(CollisionGrid &grid, float boundaries[])
+{
+  if (turning || moving) return 0;
+
+  // other blocks' trails count, so it can't land inside a falling block
+  int distance = dropDistance(grid, boundaries, false);
+  if (distance > 0) {
+    y -= distance * 5.0;
+    oldY = y;
+    clearCollisionTrail(grid, false);
+    placeInGrid(grid, boundaries);
+  }
 
-  if (selected && arrows) {
-    glDisable(GL_DEPTH_TEST); // so block can go through arrows and they'll still be seen
-    glDisable(GL_TEXTURE_2D);
+  // if it's sitting on something that has landed, there's nothing left
+  // for gravity to do
+  hitCount = 0;
+  if (dropDistance(grid, boundaries, true) == 0) grounded = true;
+  hashPose(grid, true);
 
-    drawArrows();
+  return distance;
+}
 
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_DEPTH_TEST);
+// Get the world coordinates of one of the block's cubes. When the block is
+// resting in one of its 24 orientations this is a table lookup, otherwise
+// (part way through a turn) it goes through the matrix.
+//   i - the cube, an index into the cube list
+//   wx,y,z - world coordinates are stored in these parameters
+void Block::cubeCoords(int i, float &wx, float &wy, float &wz)
+{
+  if (turning || cubeSlot[i] < 0) {
+    wx = cubes[i].x * 5.0, wy = cubes[i].y * 5.0, wz = cubes[i].z * 5.0;
+    worldCoords(wx, wy, wz);
+  }else{
+    Cell offset = Orientation::cell(type, orientation, cubeSlot[i]);
+    wx = x + offset.x * 5.0, wy = y + offset.y * 5.0, wz = z + offset.z * 5.0;
   }
+}
+
+// Set the resting orientation, and the matrix to match it exactly
+//   o - the orientation, see orientation.h
+void Block::setOrientation(int o)
+{
+  orientation = o;
+  Orientation::toMatrix(o, matrix);
+  updateFootprint();
+}
+
+// Work out the layer occupancy words of the resting cubes, relative to the
+// lowest offset in each direction, for testing against the collision grid
+void Block::updateFootprint()
+{
+  Cell offset[BLOCK_MAX_CUBES];
+  Cell high = { 0, 0, 0 };
+  footprintMin = high;
 
-  glPopMatrix();
+  for (int i = 0; i < numCubes; i++) {
+    if (cubeSlot[i] < 0) offset[i] = cubes[i];
+    else offset[i] = Orientation::cell(type, orientation, cubeSlot[i]);
 
-  if (wallMarkAlpha > 0.0) {
-    drawWallMark(texId);
+    if (i == 0 || offset[i].x < footprintMin.x) footprintMin.x = offset[i].x;
+    if (i == 0 || offset[i].y < footprintMin.y) footprintMin.y = offset[i].y;
+    if (i == 0 || offset[i].z < footprintMin.z) footprintMin.z = offset[i].z;
+    if (i == 0 || offset[i].x > high.x) high.x = offset[i].x;
+    if (i == 0 || offset[i].y > high.y) high.y = offset[i].y;
+    if (i == 0 || offset[i].z > high.z) high.z = offset[i].z;
   }
+
+  footprintWidth = numCubes > 0 ? high.x - footprintMin.x + 1 : 0;
+  footprintLayers = numCubes > 0 ? high.y - footprintMin.y + 1 : 0;
+  int depth = numCubes > 0 ? high.z - footprintMin.z + 1 : 0;
+
+  for (int i = 0; i < BLOCK_DATA_SIZE; i++) footprint[i] = 0, footprintColumn[i] = 0;
+
+  for (int i = 0; i < numCubes; i++)
+    footprint[offset[i].y - footprintMin.y] |= CollisionGrid::bit(offset[i].x - footprintMin.x, offset[i].z - footprintMin.z);
+
+  for (int col = 0; col < footprintWidth; col++)
+    for (int row = 0; row < depth; row++)
+      footprintColumn[col] |= CollisionGrid::bit(col, row);
+}
+
+// Move one layer of the footprint into the grid, dropping any columns that
+// fall outside it (rows outside it are shifted out)
+//   layer - the footprint layer
+//   cellX,cellZ - the grid cell for the footprint's lowest corner
+LayerMask Block::placeFootprint(int layer, int cellX, int cellZ)
+{
+  return CollisionGrid::place(footprint[layer], footprintColumn, footprintWidth, cellX, cellZ);
+}
+
+// Get the resting orientation
+int Block::getOrientation()
+{
+  return orientation;
 }
 
 // Get the world coordinates of the block
 //   wx,y,z - world coordinates are stored in these parameters
 void Block::worldCoords(float &wx, float &wy, float &wz)
 {
-  glPushMatrix();
-  glLoadIdentity();
-  glTranslatef(x + pivotX, y + pivotY, z + pivotZ); // change pivot point
-  glMultMatrixf(matrix);
-  glTranslatef(wx - pivotX, wy - pivotY, wz - pivotZ);
-  glGetFloatv(GL_MODELVIEW_MATRIX, outputMatrix);
-  glPopMatrix();
-  /*float coordVector[3];
-
-  for (int i = 0; i < 3; i += 4) {
-    coordVector[i] = matrix[i] * wx + matrix[i+1] * wy + matrix[i+2] * wz + matrix[i+3];
-  }*/
-  //for (int i = 0; i < 16; i++) {
-    //if (i%4 == 0) cout << endl;
-    //cout << outputMatrix[i] << ", ";
-  //}
-
-  // TODO outputMatrix doesn't have to be global
-  wx = outputMatrix[12], wy = outputMatrix[13], wz = outputMatrix[14];
+  // equivalent to translating to (x,y,z) + pivot, multiplying by matrix,
+  // then translating by (wx,wy,wz) - pivot, and reading the translation
+  // column back, but without going through the GL matrix stack
+  wx -= pivotX, wy -= pivotY, wz -= pivotZ;
+  Transform::transformPoint(matrix, wx, wy, wz);
+  wx += x + pivotX, wy += y + pivotY, wz += z + pivotZ;
 }
 
 float Block::getTurnedX()
@@ -1133,39 +1034,26 @@ float Block::getTurnedZ()
   return turnedZ;
 }
 
-// Copy one matrix to another
-//   m1 - the matrix to copy
-//   m2 - the matrix to fill
-void Block::matrixCopy(const float m1[16], float m2[16])
+// Set the game clock that moves and turns are worked out from. Call it
+// once per game tick, before the blocks move.
+//   t - the tick number
+void Block::setClock(int t)
 {
-  for (int i = 0; i < 16; i++) m2[i] = m1[i];
+  clock = t;
 }
 
-void Block::matrixCorrectRoundingError(float m1[])
-//
-// Hack to correct for rounding error caused by incremental rotations.
-// If rotational element (3x3) of matrix is < small no. then set to zero
-//
+// Get the game clock, in ticks
+int Block::getClock()
 {
-  int l1, l2, element;
-  const float ROUNDING = 0.1;
-
-  for( l1=0; l1<3; l1++ ) { // Columns
-
-    for( l2=0; l2<3; l2++ ) { // Rotational elements in column
-      element = l1 * 4 + l2;
+  return clock;
+}
 
-      if( fabsf( m1[element] ) < ROUNDING ) {
-        m1[element] = 0.0;
-      }
-      else if( fabsf( fabsf( m1[element] ) - 1.0 ) < ROUNDING ) {
-        m1[element] = m1[element] < 0.0 ? -1.0 : 1.0;
-      }
-      else {
-        cout << "Block::matrixCorrectRoundingError " << m1[element] << endl;
-      }
-    }
-  }
+// Copy one matrix to another
+//   m1 - the matrix to copy
+//   m2 - the matrix to fill
+void Block::matrixCopy(const float m1[16], float m2[16])
+{
+  Transform::copy(m1, m2);
 }
 
 void Block::matrixPrint( const float m1[] )
@@ -1289,8 +1177,8 @@ bool Block::getGotConfirmed()
 
 // Change the blocks properties to match the confirmed properties
 //   boundaries - the game area boundaries
-//   collisionArray - an array used for collision detection
-void Block::toConfirmed(float boundaries[], int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH])
+//   grid - the collision grid
+void Block::toConfirmed(float boundaries[], CollisionGrid &grid)
 {
   // if it's different in y and the confirmed values are not oldConfirmed
   // or it's grounded
@@ -1300,8 +1188,8 @@ void Block::toConfirmed(float boundaries[], int collisionArray[GAMEAREA_WIDTH][G
   if (turning || moving) cerr << "Block::toConfirmed: called when block active!!" << endl;
   if (confirmedX != oldConfirmedX || confirmedY != oldConfirmedY || confirmedZ != oldConfirmedZ || grounded) {
     //if (id == 27) cout << "setting to Confirmed: " << id << endl;
-    matrixCopy(confirmedMatrix, matrix);
-    matrixCopy(confirmedMatrix, oldMatrix);
+    setOrientation(Orientation::fromMatrix(confirmedMatrix));
+    matrixCopy(matrix, oldMatrix);
     x = confirmedX;
     y = confirmedY;
     z = confirmedZ;
@@ -1316,54 +1204,40 @@ void Block::toConfirmed(float boundaries[], int collisionArray[GAMEAREA_WIDTH][G
     turning = false;
 
     // update collision array
-    newPosition.clear();
-    clearCollisionTrail(collisionArray, false); // clear old position based on lastStored
+    newPositionSize = 0;
+    clearCollisionTrail(grid, false); // clear old position based on lastStored
 
-    lastStored.clear();
+    lastStoredSize = 0;
     float wx = 0, wy = 0, wz = 0;
     int worldX = 0, worldY = 0, worldZ = 0;
-    vector <int> pos;
-
-    // go through block array
-    for (int z = 0; z < 5; z++) {
-      for (int y = 0; y < 5; y++) {
-        for (int x = 0; x < 5; x++) {
-          if (data[x][y][z] == 1) { // if there's a block here
-            // get world coords of current block
-            wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-            worldCoords(wx, wy, wz);
-            worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
-
-            // check we're in range (to stop any annoying segfaults)
-            if (worldX < 0 || worldY < 0 || worldZ < 0 ||
-                //worldX >= (int) collisionArray.size() || worldY >= (int) collisionArray[0].size() ||
-                //worldZ >= (int) collisionArray[0][0].size()) {
-                worldX >= GAMEAREA_WIDTH || worldY >= GAMEAREA_HEIGHT ||
-                worldZ >= GAMEAREA_DEPTH) {
-              cerr << "Block::Block - attempt to check a world coordinate outside of collision array bounds" << endl;
-              cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
-            }else{
-              if (collisionArray[worldX][worldY][worldZ] > 0) {
-                // some sort of error?
-              }
-              collisionArray[worldX][worldY][worldZ] = id;
-              pos.clear();
-              pos.push_back(worldX);
-              pos.push_back(worldY);
-              pos.push_back(worldZ);
-              lastStored.push_back(pos);
-            }
-          }
+
+    // go through block cubes
+    for (int i = 0; i < numCubes; i++) {
+      // get world coords of current block
+      cubeCoords(i, wx, wy, wz);
+      worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
+
+      // check we're in range (to stop any annoying segfaults)
+      if (!grid.inside(worldX, worldY, worldZ)) {
+        cerr << "Block::Block - attempt to check a world coordinate outside of collision array bounds" << endl;
+        cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
+      }else{
+        if (grid.getId(worldX, worldY, worldZ) > 0) {
+          // some sort of error?
         }
+        grid.setResting(worldX, worldY, worldZ, id);
+        Cell pos = { worldX, worldY, worldZ };
+        lastStored[lastStoredSize++] = pos;
       }
     }
 
     // we've put the block in the collision array, so size of lastStored should
     // be safelyStoredSize
-    if (safelyStoredSize != (int) lastStored.size()) {
-      cerr << "Block::toConfirmed(): lastStored.size() != safelyStoredSize" << endl;
-      cerr << "lastStored.size() == " << lastStored.size() << ", safelyStoredSize == " << safelyStoredSize << endl;
+    if (safelyStoredSize != lastStoredSize) {
+      cerr << "Block::toConfirmed(): lastStoredSize != safelyStoredSize" << endl;
+      cerr << "lastStoredSize == " << lastStoredSize << ", safelyStoredSize == " << safelyStoredSize << endl;
     }
+    heldSize = lastStoredSize;
 
     gotConfirmed = false;
 
@@ -1379,6 +1253,8 @@ void Block::toConfirmed(float boundaries[], int collisionArray[GAMEAREA_WIDTH][G
 
     // NOTE does not set grounded = true here... maybe it should?
   }
+
+  hashPose(grid, true);
 }
 
 // checks for collision against other blocks and world boundaries
@@ -1395,184 +1271,184 @@ bool Block::originalCheckCollision(vector <Block> &blocks, float boundaries[])
   float wx = 0, wy = 0, wz = 0; // current
   float wx2 = 0, wy2 = 0, wz2 = 0; // other
 
-  for (int z = 0; z < 5; z++) {
-    for (int y = 0; y < 5; y++) {
-      for (int x = 0; x < 5; x++) {
-        if (data[x][y][z] == 1) { // if there's a block here
-          // get world coords of current block
-          wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-          worldCoords(wx, wy, wz);
+  for (int c = 0; c < numCubes; c++) {
+    // get world coords of current block
+    cubeCoords(c, wx, wy, wz);
+
+    // when checking points were equal, used to round
+    //wx = roundf(wx), wy = roundf(wy), wz = roundf(wz);
+
+    // has it hit the ground whilst turning?
+    // can't do < 0 because blocks actually turn through ground as they rotate
+    if (wy < -0.2) return true;
+
+    // check against X and Z boundaries (accounting for rounding errors)
+    if (wx < boundaries[0] - 0.2 || wx > boundaries[1] + 0.2 || wz < boundaries[2] - 0.2 || wz > boundaries[3] + 0.2)
+      return true;
+
+    // go through all the others
+    for (int i = 0; i < (int) blocks.size(); i++) {
 
+      if (id != blocks[i].getId()) { // don't check collision against itself!
+
+        // loop for every cube of the other block to check for collision
+        for (int c2 = 0; c2 < blocks[i].numCubes; c2++) {
+          wx2 = blocks[i].cubes[c2].x * 5.0, wy2 = blocks[i].cubes[c2].y * 5.0, wz2 = blocks[i].cubes[c2].z * 5.0; // object coords
+          blocks[i].worldCoords(wx2, wy2, wz2); // convert to world coords
           // when checking points were equal, used to round
-          //wx = roundf(wx), wy = roundf(wy), wz = roundf(wz);
-
-          // has it hit the ground whilst turning?
-          // can't do < 0 because blocks actually turn through ground as they rotate
-          if (wy < -0.2) return true;
-
-          // check against X and Z boundaries (accounting for rounding errors)
-          if (wx < boundaries[0] - 0.2 || wx > boundaries[1] + 0.2 || wz < boundaries[2] - 0.2 || wz > boundaries[3] + 0.2)
-            return true;
-
-          // go through all the others
-          for (int i = 0; i < (int) blocks.size(); i++) {
-
-            if (id != blocks[i].getId()) { // don't check collision against itself!
-
-              // loop for every bit of block data to check for collision
-              for (int z2 = 0; z2 < 5; z2++) {
-                for (int y2 = 0; y2 < 5; y2++) {
-                  for (int x2 = 0; x2 < 5; x2++) {
-                    if (blocks[i].getData(x2, y2, z2) == 1) { // if there's a block here
-                      wx2 = x2 * 5.0, wy2 = y2 * 5.0, wz2 = z2 * 5.0; // object coords
-                      blocks[i].worldCoords(wx2, wy2, wz2); // convert to world coords
-                      // when checking points were equal, used to round
-                      //wx2 = roundf(wx2), wy2 = roundf(wy2), wz2 = roundf(wz2);
-                      //if (wx == wx2 && wy == wy2 && wz == wz2) {
-                      // if within a block width of each other
-                      if (wx < wx2 + 4.9 && wx > wx2 - 4.9 && wy < wy2 + 4.9 && wy > wy2 - 4.9 && wz < wz2 + 4.9
-                          && wz > wz2 - 4.9) {
-                        //cout << collision++ << endl;
-                        // special case - block moving down has collided with one above it
-                        // if it's below, and not moving up then it's clear
-                        // so check... if it's above or equal, or it's moving up then it's hit
-                        if (wy > wy2 - 0.1 || targetY >= y) return true;
-                      }
-                    }
-                  } // x
-                } // y
-              } // z
-
-            } // end not the same block as current one
-
-          } // end for going through blocks
-        } // end if there's a block here for current block
-      } // x
-    } // y
-  } // z
+          //wx2 = roundf(wx2), wy2 = roundf(wy2), wz2 = roundf(wz2);
+          //if (wx == wx2 && wy == wy2 && wz == wz2) {
+          // if within a block width of each other
+          if (wx < wx2 + 4.9 && wx > wx2 - 4.9 && wy < wy2 + 4.9 && wy > wy2 - 4.9 && wz < wz2 + 4.9
+              && wz > wz2 - 4.9) {
+            //cout << collision++ << endl;
+            // special case - block moving down has collided with one above it
+            // if it's below, and not moving up then it's clear
+            // so check... if it's above or equal, or it's moving up then it's hit
+            if (wy > wy2 - 0.1 || targetY.toFloat() >= y) return true;
+          }
+        } // end for other block's cubes
+
+      } // end not the same block as current one
+
+    } // end for going through blocks
+  } // end for current block's cubes
 
   return false;
 }
 
 // A collision detection routine using the collision array
-//   collisionArray - the array used for collision detection
+//   grid - the collision grid
 //   boundaries - the game boundaries
 //
 // Returns:
 //   true if hit, false otherwise
-bool Block::checkCollision(int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], float boundaries[])
+bool Block::checkCollision(CollisionGrid &grid, float boundaries[])
 {
   float wx = 0, wy = 0, wz = 0; // world coordinates of block
   float checkX = 0, checkY = 0, checkZ = 0; // check coordinates (for checking ahead of movement)
   int worldX = 0, worldY = 0, worldZ = 0; // rounded world coords
-  bool hit = false, alreadyStored = false;
-  vector <int> pos; // temporary position vector
-  newPosition.clear();
+  bool hit = false;
+  newPositionSize = 0;
 
-  // remove last stored position from collisionArray
-  // this will also mean it won't check against itself
+  // check 2.2 either side in x and z, and below (not up)
+  // (because move 0.1 so that makes a total of 2.3 in direction of movement)
+  // 2.5 would enter next block even if it was staying still
+  static const float checkOffset[5][3] = {
+    { -2.2, 0.0, 0.0 }, { 2.2, 0.0, 0.0 }, { 0.0, 0.0, -2.2 }, { 0.0, 0.0, 2.2 }, { 0.0, -2.2, 0.0 }
+  };
 
   // block will not check against itself because it uses the id in
-  // collisionArray
-
-  //for (int i = 0; i < (int) lastStored.size(); i++) {
-  //  collisionArray[lastStored[i][0]][lastStored[i][1]][lastStored[i][2]] = 0;
-  //}
+  // the grid (or its own trail when checking whole layers)
   
-  // go through block array
-  for (int z = 0; z < 5; z++) {
-    for (int y = 0; y < 5; y++) {
-      for (int x = 0; x < 5; x++) {
-        if (data[x][y][z] == 1 && !hit) { // if there's a block here
-          // get world coords of current block
-          wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-          worldCoords(wx, wy, wz);
-
-          // has it hit the ground whilst turning?
-          // can't do < 0 because blocks actually turn through ground as they rotate
-          if (wy < -0.2) hit = true;
-
-          // check against X and Z boundaries (accounting for rounding errors)
-          if (wx < boundaries[0] - 0.2 || wx > boundaries[1] + 0.2 || wz < boundaries[2] - 0.2 || wz > boundaries[3] + 0.2) {
-            hit = true;
-            wallMark[0] = wx, wallMark[1] = wy, wallMark[2] = wz;
-            wallMark[3] = 0; // don't rotate
-            if (wx < boundaries[0] - 0.2) wallMark[3] = 3;
-            if (wz < boundaries[2] - 0.2) wallMark[3] = 2;
-            if (wx > boundaries[1] + 0.2) wallMark[3] = 1;
-            if (wz > boundaries[3] + 0.2) wallMark[3] = 0;
-            wallMarkAlpha = 1.0;
-          }
+  // go through block cubes
+  for (int c = 0; c < numCubes && !hit; c++) {
+    // get world coords of current block
+    cubeCoords(c, wx, wy, wz);
+
+    // has it hit the ground whilst turning?
+    // can't do < 0 because blocks actually turn through ground as they rotate
+    if (wy < -0.2) hit = true;
+
+    // check against X and Z boundaries (accounting for rounding errors)
+    if (wx < boundaries[0] - 0.2 || wx > boundaries[1] + 0.2 || wz < boundaries[2] - 0.2 || wz > boundaries[3] + 0.2) {
+      hit = true;
+      wallMark[0] = wx, wallMark[1] = wy, wallMark[2] = wz;
+      wallMark[3] = 0; // don't rotate
+      if (wx < boundaries[0] - 0.2) wallMark[3] = 3;
+      if (wz < boundaries[2] - 0.2) wallMark[3] = 2;
+      if (wx > boundaries[1] + 0.2) wallMark[3] = 1;
+      if (wz > boundaries[3] + 0.2) wallMark[3] = 0;
+      wallMarkAlpha = 1.0;
+    }
   
-          // check against collisionArray, in all directions except up
-          for (int i = 0; i < 5; i++) {
-            checkX = wx, checkY = wy, checkZ = wz;
-
-            // check 2.3 either side (because move 0.1 so that makes a total of 2.4 in direction of movement)
-            // 2.5 would enter next block even if it was staying still
-            switch (i) {
-              case 0:
-                checkX = wx - 2.2;
-                break;
-              case 1:
-                checkX = wx + 2.2;
-                break;
-              case 2:
-                checkZ = wz - 2.2;
-                break;
-              case 3:
-                checkZ = wz + 2.2;
-                break;
-              case 4:
-                checkY = wy - 2.2;
-                break;
-            }
+    // part way through a turn the cubes aren't lined up with the grid, so
+    // check each one against the grid, in all directions except up (as
+    // for any move in an arena without layer words)
+    for (int i = 0; i < 5 && (turning || !grid.getClassic()); i++) {
+      checkX = wx + checkOffset[i][0], checkY = wy + checkOffset[i][1], checkZ = wz + checkOffset[i][2];
+
+      // get array coordinates from check coordinates
+      worldX = (int) roundf((checkX - boundaries[0]) / 5.0), worldY = (int) roundf(checkY / 5.0), worldZ = (int) roundf((checkZ - boundaries[2]) / 5.0);
+
+      // could be too high (13) or x == 5 cos not picked up by boundary check
+      // (because checkX is not checked against boundary, only wx is)
+      if (grid.inside(worldX, worldY, worldZ) &&
+          grid.getId(worldX, worldY, worldZ) > 0 && grid.getId(worldX, worldY, worldZ) != id) hit = true;
+    } // end for check points
+      
+    if (!hit) {
+      // store position of block, for entry into the grid
+      worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
 
-            // get array coordinates from check coordinates
-            worldX = (int) roundf((checkX - boundaries[0]) / 5.0), worldY = (int) roundf(checkY / 5.0), worldZ = (int) roundf((checkZ - boundaries[2]) / 5.0);
-            //cout << "[0]: " << collisionArray[0].size() << ", wy: " << worldY << endl;
-            //cout << "wx: " << wx << ", wy: " << wy << ", wz: " << wz << endl;
-            //cout << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
-
-            if (worldX < 0 || worldY < 0 || worldZ < 0 ||
-                worldX >= GAMEAREA_WIDTH || worldY >= GAMEAREA_HEIGHT ||
-                worldZ >= GAMEAREA_DEPTH) {
-              //cerr << "Block::checkCollision - attempt to check a world coordinate outside of collision array bounds" << endl;
-              //cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
-              // could hit too high (13) or x == 5 cos not picked up by boundary check (because checkX is not checked
-              // against boundary, only wx is)
-            }else
-              if (collisionArray[worldX][worldY][worldZ] > 0 && collisionArray[worldX][worldY][worldZ] != id) hit = true;
-          } // end for check points
-            
-          if (!hit) {
-            // store position of block, for entry into collisionArray
-            worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
-
-            pos.clear();
-            pos.push_back(worldX);
-            pos.push_back(worldY);
-            pos.push_back(worldZ);
-            newPosition.push_back(pos);
-          }
+      Cell pos = { worldX, worldY, worldZ };
+      newPosition[newPositionSize++] = pos;
+    }
+  } // end for cubes while !hit
+
+  // in a resting orientation in the classic arena the cells to check are
+  // just the footprint moved to each check point, so test a layer at a time
+  if (!hit && !turning && grid.getClassic()) {
+    LayerMask check[CLASSIC_MAX_HEIGHT], own[CLASSIC_MAX_HEIGHT];
+    int lowY = CLASSIC_MAX_HEIGHT, highY = -1;
+
+    for (int y = 0; y < CLASSIC_MAX_HEIGHT; y++) check[y] = 0, own[y] = 0;
+
+    for (int i = 0; i < 5; i++) {
+      worldX = (int) roundf((x + checkOffset[i][0] - boundaries[0]) / 5.0) + footprintMin.x;
+      worldY = (int) roundf((y + checkOffset[i][1]) / 5.0) + footprintMin.y;
+      worldZ = (int) roundf((z + checkOffset[i][2] - boundaries[2]) / 5.0) + footprintMin.z;
+
+      for (int layer = 0; layer < footprintLayers; layer++) {
+        int checkLayer = worldY + layer;
+        if (checkLayer < 0 || checkLayer >= grid.getHeight()) continue;
+        check[checkLayer] |= placeFootprint(layer, worldX, worldZ);
+        if (checkLayer < lowY) lowY = checkLayer;
+        if (checkLayer > highY) highY = checkLayer;
+      }
+    }
+
+    // cells this block already holds don't count
+    for (int i = 0; i < lastStoredSize; i++)
+      if (grid.getId(lastStored[i].x, lastStored[i].y, lastStored[i].z) == id)
+        own[lastStored[i].y] |= CollisionGrid::bit(lastStored[i].x, lastStored[i].z);
+
+    for (int y = lowY; y <= highY && !hit; y++)
+      if (check[y] & grid.getLayer(y) & ~own[y]) hit = true;
+  }
 
-        } // end if there is a block and !hit
-      } // x
-    } // y
-  } // z
+  if (!hit) {
+    // let go of the cells the block has moved out of since it started,
+    // keeping where it started (to go back to if it hits something later)
+    // and what a turn has swept
+    int kept = heldSize;
+    for (int i = heldSize; i < lastStoredSize; i++) {
+      bool stillIn = false;
+      for (int j = 0; j < newPositionSize && !stillIn; j++)
+        if (lastStored[i].x == newPosition[j].x && lastStored[i].y == newPosition[j].y && lastStored[i].z == newPosition[j].z) stillIn = true;
+      if (stillIn) lastStored[kept++] = lastStored[i];
+      else grid.unset(lastStored[i].x, lastStored[i].y, lastStored[i].z);
+    }
+    lastStoredSize = kept;
+
+    // make sure the trail has room for the new positions; it only fills up
+    // if a turn and a move together hold an unusual number, so treat as a hit
+    int newCells = 0;
+    for (int i = 0; i < newPositionSize; i++)
+      if (!trailContains(newPosition[i])) newCells++;
+    if (lastStoredSize + newCells > BLOCK_MAX_TRAIL) {
+      cerr << "Block::checkCollision - collision trail full for block " << id << endl;
+      hit = true;
+    }
+  }
 
   if (!hit) { // we're clear to move to new position
     // so add new stored positions to collision array/lastStored
-    for (int i = 0; i < (int) newPosition.size(); i++) {
-      collisionArray[newPosition[i][0]][newPosition[i][1]][newPosition[i][2]] = id;
+    for (int i = 0; i < newPositionSize; i++) {
+      grid.set(newPosition[i].x, newPosition[i].y, newPosition[i].z, id);
 
-      // is this position already stored?
-      alreadyStored = false;
-      for (int j = 0; j < (int) lastStored.size(); j++) {
-        if (lastStored[j][0] == newPosition[i][0] && lastStored[j][1] == newPosition[i][1] && lastStored[j][2] == newPosition[i][2]) alreadyStored = true;
-      }
-      // if not add it
-      if (!alreadyStored) lastStored.push_back(newPosition[i]);
+      // if this position is not already stored add it
+      if (!trailContains(newPosition[i])) lastStored[lastStoredSize++] = newPosition[i];
     }
 
     // new position now contains only the new position vectors
@@ -1581,149 +1457,220 @@ bool Block::checkCollision(int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][G
 
     // firstly remove all stored positions from the array that were not in the
     // original part
-    for (int i = safelyStoredSize; i < (int) lastStored.size(); i++)
-      collisionArray[lastStored[i][0]][lastStored[i][1]][lastStored[i][2]] = 0;
+    for (int i = safelyStoredSize; i < lastStoredSize; i++)
+      grid.unset(lastStored[i].x, lastStored[i].y, lastStored[i].z);
 
     // secondly remove those stored positions from the array
-    while ((int) lastStored.size() > safelyStoredSize) lastStored.pop_back();
+    if (lastStoredSize > safelyStoredSize) lastStoredSize = safelyStoredSize;
+    heldSize = lastStoredSize;
   }
 
   return hit; // collision?
 }
 
 // Clear the collision trail
-//   collisionArray - the array storing collision data
+//   grid - the collision grid
 //   storeNewPosition - whether or not to store new block position
-void Block::clearCollisionTrail(int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], bool storeNewPosition)
+void Block::clearCollisionTrail(CollisionGrid &grid, bool storeNewPosition)
 {
   // clear lastStored and set newPosition
-  for (int i = 0; i < (int) lastStored.size(); i++)
-    collisionArray[lastStored[i][0]][lastStored[i][1]][lastStored[i][2]] = 0;
+  for (int i = 0; i < lastStoredSize; i++)
+    grid.unset(lastStored[i].x, lastStored[i].y, lastStored[i].z);
   
   if (storeNewPosition) {
-    lastStored = newPosition;
-    if ((int) lastStored.size() != safelyStoredSize) {
-      cerr << "Block::clearCollisionTrail: lastStored.size() != safelyStoredSize" << endl;
-      cerr << "lastStored.size() == " << lastStored.size() << ", safelyStoredSize == " << safelyStoredSize << endl;
+    for (int i = 0; i < newPositionSize; i++) lastStored[i] = newPosition[i];
+    lastStoredSize = newPositionSize;
+    heldSize = lastStoredSize;
+    if (lastStoredSize != safelyStoredSize) {
+      cerr << "Block::clearCollisionTrail: lastStoredSize != safelyStoredSize" << endl;
+      cerr << "lastStoredSize == " << lastStoredSize << ", safelyStoredSize == " << safelyStoredSize << endl;
     } else {
-      for (int i = 0; i < (int) lastStored.size(); i++)
-        collisionArray[lastStored[i][0]][lastStored[i][1]][lastStored[i][2]] = id;
+      for (int i = 0; i < lastStoredSize; i++)
+        grid.setResting(lastStored[i].x, lastStored[i].y, lastStored[i].z, id);
+    }
+  }
+}
+
+// Check a quarter turn that is about to start against the grid in one go,
+// from the cells it sweeps through (see sweep.h). If it's clear, the cells
+// are held in the collision trail until it ends, so nothing else can move
+// into them, and it isn't checked again on the way round. Any other turn is
+// left to be checked a tick at a time.
+//   grid - the collision grid
+//   boundaries - the game boundaries
+//
+// Returns:
+//   true if the turn would hit something
+bool Block::checkTurn(CollisionGrid &grid, float boundaries[])
+{
+  // one quarter turn, of a block with all its type's cubes
+  const Scalar target[3] = { targetAngleX, targetAngleY, targetAngleZ };
+  int axis = -1;
+  for (int i = 0; i < 3; i++) {
+    if (target[i] == 0) continue;
+    if (axis >= 0) return false;
+    axis = i;
+  }
+  if (axis < 0 || target[axis].abs() != 90) return false;
+  for (int i = 0; i < numCubes; i++) if (cubeSlot[i] < 0) return false;
+
+  const SweptCells &s = Sweep::get(type, orientation, axis, target[axis] > 0);
+
+  // the floor and walls, from the cube centres on the way round
+  // (accounting for rounding errors, as checkCollision)
+  if (y + s.low[1] * 5.0 < -0.2) return true;
+  float lowX = x + s.low[0] * 5.0, highX = x + s.high[0] * 5.0;
+  float lowZ = z + s.low[2] * 5.0, highZ = z + s.high[2] * 5.0;
+  if (lowX < boundaries[0] - 0.2 || highX > boundaries[1] + 0.2 || lowZ < boundaries[2] - 0.2 || highZ > boundaries[3] + 0.2) {
+    wallMark[0] = x, wallMark[1] = y, wallMark[2] = z;
+    if (lowX < boundaries[0] - 0.2) wallMark[0] = boundaries[0], wallMark[3] = 3;
+    if (lowZ < boundaries[2] - 0.2) wallMark[2] = boundaries[2], wallMark[3] = 2;
+    if (highX > boundaries[1] + 0.2) wallMark[0] = boundaries[1], wallMark[3] = 1;
+    if (highZ > boundaries[3] + 0.2) wallMark[2] = boundaries[3], wallMark[3] = 0;
+    wallMarkAlpha = 1.0;
+    return true;
+  }
+
+  int cellX = (int) roundf((x - boundaries[0]) / 5.0), cellY = (int) roundf(y / 5.0), cellZ = (int) roundf((z - boundaries[2]) / 5.0);
+  bool hit = false;
+
+  if (grid.getClassic()) {
+    // a layer word at a time; cells this block already holds don't count
+    LayerMask own[CLASSIC_MAX_HEIGHT];
+    for (int y = 0; y < CLASSIC_MAX_HEIGHT; y++) own[y] = 0;
+    for (int i = 0; i < lastStoredSize; i++)
+      if (grid.getId(lastStored[i].x, lastStored[i].y, lastStored[i].z) == id)
+        own[lastStored[i].y] |= CollisionGrid::bit(lastStored[i].x, lastStored[i].z);
+
+    for (int layer = 0; layer < s.layers && !hit; layer++) {
+      int checkLayer = cellY + s.min.y + layer;
+      if (checkLayer < 0 || checkLayer >= grid.getHeight()) continue;
+      LayerMask swept = CollisionGrid::place(s.layer[layer], s.column, s.width, cellX + s.min.x, cellZ + s.min.z);
+      if (swept & grid.getLayer(checkLayer) & ~own[checkLayer]) hit = true;
+    }
+  }else{
+    for (int i = 0; i < s.numCells && !hit; i++) {
+      int cx = cellX + s.cells[i].x, cy = cellY + s.cells[i].y, cz = cellZ + s.cells[i].z;
+      if (grid.inside(cx, cy, cz) && grid.getId(cx, cy, cz) > 0 && grid.getId(cx, cy, cz) != id) hit = true;
     }
   }
+  if (hit) return true;
+
+  // hold the swept cells, if the trail has room for them
+  int newCells = 0;
+  for (int i = 0; i < s.numCells; i++) {
+    Cell cell = { cellX + s.cells[i].x, cellY + s.cells[i].y, cellZ + s.cells[i].z };
+    if (grid.inside(cell.x, cell.y, cell.z) && !trailContains(cell)) newCells++;
+  }
+  if (lastStoredSize + newCells > BLOCK_MAX_TRAIL) return false; // check it a tick at a time
+
+  for (int i = 0; i < s.numCells; i++) {
+    Cell cell = { cellX + s.cells[i].x, cellY + s.cells[i].y, cellZ + s.cells[i].z };
+    if (!grid.inside(cell.x, cell.y, cell.z)) continue;
+    grid.set(cell.x, cell.y, cell.z, id);
+    if (!trailContains(cell)) lastStored[lastStoredSize++] = cell;
+  }
+  heldSize = lastStoredSize;
+
+  turnSwept = true;
+  return false;
+}
+
+// Is a collision array cell already in the collision trail?
+//   cell - the cell to look for
+bool Block::trailContains(const Cell &cell) const
+{
+  for (int i = 0; i < lastStoredSize; i++) {
+    if (lastStored[i].x == cell.x && lastStored[i].y == cell.y && lastStored[i].z == cell.z) return true;
+  }
+  return false;
 }
 
-// Remove a layer of cubes from the block.
-//   blocks - the global store of game blocks
-//   outputBlocks - new 'split' blocks are stored in this
-//   collisionArray - the array used for collisionDetection
+// Remove any number of layers of cubes from the block.
+//   layers - the layers being removed, n for the layer at y = n * 5
+//   fragments - new 'split' blocks are added to this
+//   grid - the collision grid
 //   boundaries - the game boundaries
 //   blockId - the block id number
-//   layerY - the layer being removed
 //
 // Returns:
 //   true if a layer has been removed (and therefore this block can be deleted)
 //   false otherwise
-bool Block::removeLayer(vector <Block> blocks, vector <Block> &outputBlocks, int collisionArray[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], float boundaries[], int &blockId, int layerY)
+bool Block::removeLayers(const LayerSet &layers, vector <Block> &fragments, CollisionGrid &grid, float boundaries[], int &blockId)
 {
-  // outputBlocks is appended with the new split blocks, or is left alone
+  // fragments is appended with the new split blocks, or is left alone
 
   float wx = 0, wy = 0, wz = 0; // world coords
   int worldX, worldY, worldZ; // rounded world coords for collision array
   bool broken = false;
+  // work from a copy of the cube list and world coords, as removing cubes
+  // rebuilds the list
+  Cell layerCubes[BLOCK_MAX_CUBES];
+  float cubeX[BLOCK_MAX_CUBES], cubeY[BLOCK_MAX_CUBES], cubeZ[BLOCK_MAX_CUBES];
+  int n = numCubes;
+  for (int i = 0; i < n; i++) {
+    layerCubes[i] = cubes[i];
+    cubeCoords(i, cubeX[i], cubeY[i], cubeZ[i]);
+  }
   
-  for (int z = 0; z < 5; z++) {
-    for (int y = 0; y < 5; y++) {
-      for (int x = 0; x < 5; x++) {
-        if (data[x][y][z] == 1) { // if there's a block here
-          // get world coords of current block
-          wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-          worldCoords(wx, wy, wz);
-
-          if (wy > layerY - 0.1 && wy < layerY + 0.1) { // does it match layerY
-            data[x][y][z] = 0;
-            interactive = false; // block is now broken into pieces and cannot be manipulated
-            broken = true;
-            worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
-            if (worldX < 0 || worldY < 0 || worldZ < 0 ||
-                //worldX >= (int) collisionArray.size() || worldY >= (int) collisionArray[0].size() ||
-                //worldZ >= (int) collisionArray[0][0].size()) {
-                worldX >= GAMEAREA_WIDTH || worldY >= GAMEAREA_HEIGHT ||
-                worldZ >= GAMEAREA_DEPTH) {
-              cerr << "Block::removeLayer - attempt to check a world coordinate outside of collision array bounds" << endl;
-              cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
-            }else
-              collisionArray[worldX][worldY][worldZ] = 0;
-          }
-        }
-      } // end x
-    } // end y
-  } // end z
+  for (int i = 0; i < n; i++) {
+    // get world coords of current block
+    wx = cubeX[i], wy = cubeY[i], wz = cubeZ[i];
+    int layerY = (int) roundf(wy / 5.0);
+
+    // does it match one of the layers
+    if (layerY >= 0 && layerY < GRID_MAX_HEIGHT && layers[layerY] && wy > layerY * 5 - 0.1 && wy < layerY * 5 + 0.1) {
+      setCube(layerCubes[i].x, layerCubes[i].y, layerCubes[i].z, false);
+      interactive = false; // block is now broken into pieces and cannot be manipulated
+      broken = true;
+      worldX = (int) roundf((wx - boundaries[0]) / 5.0), worldY = (int) roundf(wy / 5.0), worldZ = (int) roundf((wz - boundaries[2]) / 5.0);
+      if (!grid.inside(worldX, worldY, worldZ)) {
+        cerr << "Block::removeLayers - attempt to check a world coordinate outside of collision array bounds" << endl;
+        cerr << "worldX: " << worldX << ", worldY: " << worldY << ", worldZ: " << worldZ << endl;
+      }else
+        grid.unset(worldX, worldY, worldZ);
+    }
+  }
 
   if (broken) { // only split if it's just been broken (to avoid recursion)
-    clearCollisionTrail(collisionArray, false);
-    // split block into individual pieces
-    for (int z = 0; z < 5; z++) {
-      for (int y = 0; y < 5; y++) {
-        for (int x = 0; x < 5; x++) {
-          if (data[x][y][z] == 1) { // if there is a block here
-            // get world coords of current block
-            wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-            worldCoords(wx, wy, wz);
-
-            //cout << "about to add a block" << endl;
-            // add the new split blocks to the output vector
-            outputBlocks.push_back(Block(blockId++, 0, roundf(wx), roundf(wy), roundf(wz), false, collisionArray, boundaries));
-            // new blocks are not grounded by default
-            //cout << "block added" << endl;
+    clearCollisionTrail(grid, false);
+    // split what's left into connected groups of cubes (cubes touching
+    // face to face), each of which carries on as one fragment
+    unsigned int left = (1u << numCubes) - 1;
+    while (left) {
+      unsigned int group = left & -left, grown = 0;
+      while (group != grown) {
+        grown = group;
+        for (int i = 0; i < numCubes; i++) {
+          if (!(left & (1u << i)) || (group & (1u << i))) continue;
+          for (int j = 0; j < numCubes; j++) {
+            if (!(group & (1u << j))) continue;
+            if (abs(cubes[i].x - cubes[j].x) + abs(cubes[i].y - cubes[j].y) + abs(cubes[i].z - cubes[j].z) == 1) {
+              group |= 1u << i;
+              break;
+            }
           }
-        } // end x
-      } // end y
-    } // end z
+        }
+      }
+      left &= ~group;
+
+      // build the fragment in place at the end of fragments
+      // (new blocks are not grounded by default)
+      fragments.emplace_back(blockId++, *this, group, grid, boundaries);
+    }
 
-    return true; // notify that a layer has been removed from this block and it should not be added to outputBlocks
+    hashPose(grid, false); // it's about to go
+    return true; // notify that a layer has been removed from this block and it should be deleted
   }
 
   return false; // continue as normal
 }
 
-// Return vectors containing x and z positions at a particular layer
-//   layerY - the y coordinate of the layer
-vector <vector <float> > Block::getLayer(int layerY)
-{
-  vector <float> temp;
-  vector <vector <float> > layer; // all the position vectors
-  
-  float wx = 0, wy = 0, wz = 0; // world coords
-  
-  for (int z = 0; z < 5; z++) {
-    for (int y = 0; y < 5; y++) {
-      for (int x = 0; x < 5; x++) {
-        if (getData(x, y, z) == 1) { // if there's a block here
-          // get world coords of current block
-          wx = x * 5.0, wy = y * 5.0, wz = z * 5.0;
-          worldCoords(wx, wy, wz);
-
-          if (wy > layerY - 0.1 && wy < layerY + 0.1) { // does it match layerY
-            temp.clear();
-            temp.push_back(wx);
-            temp.push_back(wy);
-            temp.push_back(wz);
-
-            layer.push_back(temp);
-          }
-        }
-      } // end x
-    } // end y
-  } // end z
-
-  return layer;
-}
-
 // Called when a collision takes place
 void Block::hit()
 {
   //cout << "oldX,Y,Z: " << oldX << ", " << oldY << ", " << oldZ << endl;
-  if (y > targetY && hitCount < 5) hitCount++; // if moving down
+  if (y > targetY.toFloat() && hitCount < 5) hitCount++; // if moving down
   else hitCount = 0; // otherwise reset
   
   // must not be equal to above condition i.e. conditions must cover all posibilities
@@ -1747,3 +1694,20 @@ void Block::unGrounded()
   grounded = false;
 }
 
+// Keep the block's pose key in the grid's pose hash up to date: folded in
+// with where it is now while it may be falling, and out once it's grounded
+// (its cells are in the grid's own hash then) or going. Called as the block
+// moves, turns, drops, is corrected or broken up; a block ungrounded
+// between moves is folded in at its next move.
+//   grid - the collision grid
+//   present - false if the block is about to be destroyed
+void Block::hashPose(CollisionGrid &grid, bool present)
+{
+  unsigned long long key = 0;
+  if (present && !grounded)
+    key = CollisionGrid::poseKey(id, orientation, (int) roundf(x / 5.0), (int) roundf(y / 5.0), (int) roundf(z / 5.0));
+  if (key == poseKey) return;
+  grid.togglePose(poseKey ^ key);
+  poseKey = key;
+}
+
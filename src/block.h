@@ -20,28 +20,22 @@
 #ifndef _BLOCK_
 #define _BLOCK_
 
-#include <GL/glut.h>
 #include <iostream>
 #include <vector>
 #include "pawn.h"
+#include "orientation.h"
+#include "grid.h"
+#include "fixed.h"
 
 #define MODE_OBJECT_REFERENCE 0
 #define MODE_GLOBAL_REFERENCE 1
 #define MODE_VIEWING_REFERENCE 2
 
-// define the boundaries for the game area
-#define BOUNDARY_MIN_X -10.0
-#define BOUNDARY_MAX_X 10.0
-#define BOUNDARY_MIN_Z -10.0
-#define BOUNDARY_MAX_Z 10.0
-
-// define the starting height of the blocks
-#define BLOCK_START_Y 50.0
-
-// how many blocks can fit into the game?
-#define GAMEAREA_WIDTH ((int) (BOUNDARY_MAX_X - BOUNDARY_MIN_X) / 5 + 1)
-#define GAMEAREA_DEPTH ((int) (BOUNDARY_MAX_Z - BOUNDARY_MIN_Z) / 5 + 1)
-#define GAMEAREA_HEIGHT ((int) BLOCK_START_Y / 5 + 2)
+// most collision array cells a block can hold at once: its resting cells,
+// the cells a quarter turn sweeps through, and where it is now (the cells
+// it has left on the way are let go, so this doesn't depend on how far it
+// moves or how big the arena is)
+#define BLOCK_MAX_TRAIL 64
 
 using namespace std;
 
@@ -51,15 +45,38 @@ class Block : public Pawn {
     int type;
     int lockedBy;
     bool remoteMovement;
-    vector <vector <vector <int> > > data;
+    // shape stored as a 125 bit occupancy mask (bit x + 5y + 25z) and as
+    // a list of the occupied cells, in x, y, z order of the mask bits
+    unsigned long long shape[2];
+    Cell cubes[BLOCK_MAX_CUBES];
+    int cubeSlot[BLOCK_MAX_CUBES]; // index of each cube in BLOCK_SHAPES
+    int numCubes;
+    int orientation; // resting orientation, see orientation.h
+    // resting cubes as layer occupancy words, relative to footprintMin, with
+    // the bits of each local x column (see updateFootprint)
+    LayerMask footprint[BLOCK_DATA_SIZE];
+    LayerMask footprintColumn[BLOCK_DATA_SIZE];
+    Cell footprintMin;
+    int footprintWidth, footprintLayers;
     float matrix[16], confirmedMatrix[16];
     float confirmedX, confirmedY, confirmedZ;
     float oldConfirmedX, oldConfirmedY, oldConfirmedZ;
     float outputMatrix[16];
     float turnedX, turnedY, turnedZ;
     bool turning, moving;
-    float targetAngleX, targetAngleY, targetAngleZ;
-    float targetX, targetY, targetZ;
+    // moves and turns are simulated in fixed point, so they come out the
+    // same on every machine; the float pose is worked out from them
+    Scalar targetAngleX, targetAngleY, targetAngleZ;
+    Scalar targetX, targetY, targetZ;
+    // a turn or move in progress starts from here at this clock tick (see
+    // getTurnAt and getPositionAt)
+    Scalar turnFrom[16];
+    int turnStart;
+    Scalar moveFromX, moveFromY, moveFromZ;
+    int moveStart;
+    bool turnFresh; // a turn from rest that hasn't been checked yet
+    bool turnSwept; // the whole turn has been checked (see checkTurn)
+    static int clock; // game time, in ticks
     int pivotX, pivotY, pivotZ;
     float oldX, oldY, oldZ;
     float oldMatrix[16];
@@ -68,25 +85,39 @@ class Block : public Pawn {
     bool interactive; // can block be manipulated by a user?
     bool grounded; // is block grounded? if so don't check collision
     int hitCount; // how many times have we collided?
-    vector <vector <int> > newPosition; // store new position of blocks
-    vector <vector <int> > lastStored; // store old position/collision trail
+    Cell newPosition[BLOCK_MAX_CUBES]; // store new position of blocks
+    int newPositionSize;
+    Cell lastStored[BLOCK_MAX_TRAIL]; // store old position/collision trail
+    int lastStoredSize;
     int safelyStoredSize;
+    int heldSize; // trail cells held until the move or turn ends (see checkTurn)
     bool arrows; // draw arrows?
     float wallMark[4]; // leave mark on wall on collision
     float wallMarkAlpha;
     bool gotConfirmed;
     bool gameOver;
+    bool fragment; // left over from a removed layer, some of its type's cubes
+    unsigned long long poseKey; // folded into the grid's pose hash, or 0 (see hashPose)
 
+    void placeInGrid(CollisionGrid&, float[]);
     bool toTarget(float&, float, float);
+    void restartTurn();
+    void endTurn();
+    void setCube(int, int, int, bool);
+    bool trailContains(const Cell&) const;
+    void cubeCoords(int, float&, float&, float&);
+    void setOrientation(int);
+    void updateFootprint();
+    LayerMask placeFootprint(int, int, int);
     void drawCube();
     void drawArrows();
     void drawArrow();
     void drawCurvedArrow();
     void drawWallMark(vector <int>&);
     bool originalCheckCollision(vector <Block>&, float[]);
-    bool checkCollision(int[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], float[]);
-    void clearCollisionTrail(int[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], bool);
-    void matrixCorrectRoundingError( float* );
+    bool checkCollision(CollisionGrid&, float[]);
+    bool checkTurn(CollisionGrid&, float[]);
+    void clearCollisionTrail(CollisionGrid&, bool);
     void matrixPrint( const float* );
 
     void makeShadowObjects();
@@ -94,7 +125,8 @@ class Block : public Pawn {
   protected:
     
   public:
-    Block(int, int, float, float, float, bool, int[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], float[]); // constructor
+    Block(int, int, float, float, float, bool, CollisionGrid&, float[]); // constructor
+    Block(int, const Block&, unsigned int, CollisionGrid&, float[]); // fragment constructor
     
     void setType(int);
     int getType();
@@ -107,7 +139,7 @@ class Block : public Pawn {
     void turn3D(float, float, float);
     void translate(float, float, float);
     void snap();
-    void turnGlobalReference( const float timeSecs );
+    bool turnGlobalReference();
     void turnToTarget();
     void setTargetPosition(float, float, float);
     void changeTargetPosition(float, float, float);
@@ -118,8 +150,11 @@ class Block : public Pawn {
     float getTargetX();
     float getTargetY();
     float getTargetZ();
-    void move(vector <Block> &blocks, float[],
-      int[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], const float);
+    void move(float[], CollisionGrid&);
+    bool getTurnAt(int, float[]) const;
+    bool getPositionAt(int, float&, float&, float&) const;
+    static void setClock(int);
+    static int getClock();
     bool getMoving();
     void setMode(int);
     void setTargetAngleX(const float);
@@ -145,14 +180,20 @@ class Block : public Pawn {
     int getId();
     bool getGameOver();
     int getNumberOfCubes();
+    void getCube(int, int&, int&, int&);
+    int getCells(Cell[], const CollisionGrid&, float[]);
+    bool getFragment();
+    int dropDistance(const CollisionGrid&, float[], bool);
+    int drop(CollisionGrid&, float[]);
 
     void draw(vector <int>&, bool);
 
     void worldCoords(float&, float&, float&);
+    int getOrientation();
     float getTurnedX();
     float getTurnedY();
     float getTurnedZ();
-    void matrixCopy(const float*, float*);
+    static void matrixCopy(const float*, float*);
     float getMatrix(int);
     void getMatrix(float[]);
     void setMatrix(int, float);
@@ -166,11 +207,11 @@ class Block : public Pawn {
     float getConfirmedZ();
     void setGotConfirmed(bool);
     bool getGotConfirmed();
-    void toConfirmed(float[], int[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH]);
-    bool removeLayer(vector <Block>, vector <Block>&, int[GAMEAREA_WIDTH][GAMEAREA_HEIGHT][GAMEAREA_DEPTH], float[], int&, int);
-    vector <vector <float> > getLayer(int);
+    void toConfirmed(float[], CollisionGrid&);
+    bool removeLayers(const LayerSet&, vector <Block>&, CollisionGrid&, float[], int&);
     void hit();
     void unGrounded();
+    void hashPose(CollisionGrid&, bool);
 
 };
 
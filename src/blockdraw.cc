@@ -0,0 +1,358 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Drawing for Block, kept apart from the simulation in block.cc so that the
+// game core builds without GL (see libtetris3d.a in the Makefile)
+
+#include <GL/glut.h>
+#include "block.h"
+
+// Draw a curved arrow representing direction of rotation
+void Block::drawCurvedArrow()
+{
+  glNormal3f(0.0, 0.0, 1.0);
+
+  glBegin(GL_TRIANGLES);
+  glVertex3f(-3.0, -2.0, 0.0);
+  glVertex3f(-2.0, -2.0, 0.0);
+  glVertex3f(-3.0, -1.0, 0.0);
+  glEnd();
+  glBegin(GL_QUAD_STRIP);
+  glVertex3f(-2.6, -1.4, 0.0);
+  glVertex3f(-2.4, -1.6, 0.0);
+  glVertex3f(-1.0, 0.0, 0.0);
+  glVertex3f(-1.0, -0.2, 0.0);
+  glVertex3f(1.0, 0.0, 0.0);
+  glVertex3f(1.0, -0.2, 0.0);
+  glVertex3f(2.2, -0.8, 0.0);
+  glVertex3f(2.2, -1.0, 0.0);
+  glEnd();
+}
+
+// draw a flat arrow representing direction of translation
+void Block::drawArrow()
+{
+  glBegin(GL_QUADS);
+  glNormal3f(0.0, 0.0, 1.0);
+  glVertex3f(0.0, 0.0, 0.0);
+  glVertex3f(1.0, 0.0, 0.0);
+  glVertex3f(1.0, 1.0, 0.0);
+  glVertex3f(0.0, 1.0, 0.0);
+
+  glNormal3f(0.3, 0.0, 0.9);
+  glVertex3f(1.0, 0.0, 0.0);
+  glVertex3f(2.0, 0.0, 0.5);
+  glVertex3f(2.0, 1.0, 0.5);
+  glVertex3f(1.0, 1.0, 0.0);
+
+  glNormal3f(0.7, 0.0, 0.7);
+  glVertex3f(2.0, 0.0, 0.5);
+  glVertex3f(3.0, 0.0, 1.5);
+  glVertex3f(3.0, 1.0, 1.5);
+  glVertex3f(2.0, 1.0, 0.5);
+  glEnd();
+
+  glBegin(GL_TRIANGLES);
+  glNormal3f(0.9, 0.0, 0.3);
+  glVertex3f(3.0, -0.5, 1.5);
+  glVertex3f(3.5, 0.5, 2.5);
+  glVertex3f(3.0, 1.5, 1.5);
+  glEnd();
+
+  /*glNormal3f(0.0, 0.0, 1.0);
+  glBegin(GL_POLYGON);
+  glVertex3f(-1.0, 0.0, 0.0);
+  glVertex3f(0.0, -1.0, 0.0);
+  glVertex3f(1.0, 0.0, 0.0);
+  glEnd();
+
+  glBegin(GL_POLYGON);
+  glVertex3f(0.5, 0.0, 0.0);
+  glVertex3f(0.5, 1.0, 0.0);
+  glVertex3f(-0.5, 1.0, 0.0);
+  glVertex3f(-0.5, 0.0, 0.0);
+  glEnd();*/
+
+  // other side
+  /*glNormal3f(0.0, 0.0, -1.0);
+  glBegin(GL_POLYGON);
+  glVertex3f(-1.0, 0.0, 0.0);
+  glVertex3f(1.0, 0.0, 0.0);
+  glVertex3f(0.0, -1.0, 0.0);
+  glEnd();
+
+  glBegin(GL_POLYGON);
+  glVertex3f(0.5, 0.0, 0.0);
+  glVertex3f(-0.5, 0.0, 0.0);
+  glVertex3f(-0.5, 1.0, 0.0);
+  glVertex3f(0.5, 1.0, 0.0);
+  glEnd();*/
+}
+
+// Draw arrows representing directions of manipulation
+void Block::drawArrows()
+{
+  glPushMatrix();
+  glTranslatef(pivotX, pivotY, pivotZ);
+  glScalef(-2.0, 2.0, 2.0);
+  glPushMatrix();
+  //glTranslatef(0, -2, 0);
+  glColor4f(0.8, 0.5, 0.5, 1.0);
+  drawArrow(); // red right
+  //glTranslatef(0, 4, 0);
+  //glRotatef(180, 0.0, 0.0, 1.0);
+  glRotatef(180, 0.0, 1.0, 0.0);
+  //glScalef(-1.0, 1.0, 1.0);
+  //glCullFace(GL_FRONT);
+  drawArrow(); // back red
+  //glCullFace(GL_BACK);
+  glPopMatrix();
+  glPushMatrix();
+  //glTranslatef(2, 0, 0);
+  glRotatef(90, 0.0, 0.0, 1.0);
+  glColor4f(0.8, 0.8, 0.5, 1.0);
+  drawArrow(); // yellow up
+  //glTranslatef(0, 4, 0);
+  glRotatef(180, 0.0, 1.0, 0.0);
+  //glRotatef(180, 0.0, 0.0, 1.0);
+  drawArrow(); // yellow back
+  glPopMatrix();
+  glTranslatef(0, 2, 0);
+  glColor4f(0.5, 0.5, 0.8, 1.0);
+  glScalef(-1.0, 1.0, -1.0);
+  drawCurvedArrow(); // blue clockwise
+  glTranslatef(0, -4, 0);
+  glScalef(1.0, -1.0, 1.0);
+  glRotatef(180, 0.0, 1.0, 0.0);
+  glCullFace(GL_FRONT);
+  drawCurvedArrow();
+  glCullFace(GL_BACK);
+  glTranslatef(-pivotX, -pivotY, -pivotZ);
+  glPopMatrix();
+}
+
+// Draw individual block cube
+void Block::drawCube()
+{
+  float texMin = 0.0, texMax = 0.2;
+  glBegin(GL_QUADS);
+  glNormal3f(0.0, 0.0, 1.0);
+  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, -2.5, 2.5);
+  glTexCoord2f(texMax, texMin); glVertex3f(2.5, -2.5, 2.5);
+  glTexCoord2f(texMax, texMax); glVertex3f(2.5, 2.5, 2.5);
+  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, 2.5, 2.5);
+
+  glNormal3f(1.0, 0.0, 0.0);
+  glTexCoord2f(texMin, texMin); glVertex3f(2.5, -2.5, 2.5);
+  glTexCoord2f(texMax, texMin); glVertex3f(2.5, -2.5, -2.5);
+  glTexCoord2f(texMax, texMax); glVertex3f(2.5, 2.5, -2.5);
+  glTexCoord2f(texMin, texMax); glVertex3f(2.5, 2.5, 2.5);
+
+  glNormal3f(0.0, -1.0, 0.0);
+  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, -2.5, -2.5);
+  glTexCoord2f(texMax, texMin); glVertex3f(2.5, -2.5, -2.5);
+  glTexCoord2f(texMax, texMax); glVertex3f(2.5, -2.5, 2.5);
+  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, -2.5, 2.5);
+
+  glNormal3f(-1.0, 0.0, 0.0);
+  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, -2.5, -2.5);
+  glTexCoord2f(texMax, texMin); glVertex3f(-2.5, -2.5, 2.5);
+  glTexCoord2f(texMax, texMax); glVertex3f(-2.5, 2.5, 2.5);
+  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, 2.5, -2.5);
+
+  glNormal3f(0.0, 0.0, -1.0);
+  glTexCoord2f(texMin, texMin); glVertex3f(2.5, -2.5, -2.5);
+  glTexCoord2f(texMax, texMin); glVertex3f(-2.5, -2.5, -2.5);
+  glTexCoord2f(texMax, texMax); glVertex3f(-2.5, 2.5, -2.5);
+  glTexCoord2f(texMin, texMax); glVertex3f(2.5, 2.5, -2.5);
+
+  glNormal3f(0.0, 1.0, 0.0);
+  glTexCoord2f(texMin, texMin); glVertex3f(-2.5, 2.5, 2.5);
+  glTexCoord2f(texMax, texMin); glVertex3f(2.5, 2.5, 2.5);
+  glTexCoord2f(texMax, texMax); glVertex3f(2.5, 2.5, -2.5);
+  glTexCoord2f(texMin, texMax); glVertex3f(-2.5, 2.5, -2.5);
+  glEnd();
+}
+
+// Draw wall mark left by collision
+//   texId - the texture id's
+void Block::drawWallMark(vector <int> &texId)
+{
+  glPushMatrix();
+
+  glBindTexture(GL_TEXTURE_2D, texId[6]);
+  glEnable(GL_BLEND);
+  glDepthMask(GL_FALSE);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+  glDisable(GL_CULL_FACE);
+  glColor4f(0.8, 0.8, 0.8, wallMarkAlpha);
+
+  glNormal3f(1.0, 0.0, 0.0);
+  glTranslatef(wallMark[0], wallMark[1], wallMark[2]);
+
+  switch((int) wallMark[3]) {
+    case 1:
+      glRotatef(90, 0.0, 1.0, 0.0);
+      break;
+    case 2:
+      glRotatef(180, 0.0, 1.0, 0.0);
+      break;
+    case 3:
+      glRotatef(270, 0.0, 1.0, 0.0);
+      break;
+  }
+      
+  float size = 5.0;
+  glBegin(GL_QUADS);
+  glTexCoord2f(0.0, 0.0); glVertex3f(-size, -size, 2.5);
+  glTexCoord2f(1.0, 0.0); glVertex3f(size, -size, 2.5);
+  glTexCoord2f(1.0, 1.0); glVertex3f(size, size, 2.5);
+  glTexCoord2f(0.0, 1.0); glVertex3f(-size, size, 2.5);
+  glEnd();
+
+  glDisable(GL_BLEND);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_CULL_FACE);
+
+  glPopMatrix();
+}
+
+// Draw the block
+//   texId - the texture id's
+//   selected - defines whether the block is selected (true) or not (false)
+void Block::draw(vector <int>& texId, bool selected)
+{
+  glPushMatrix();
+  //glLoadIdentity();
+  glTranslatef(getDrawX(), getDrawY(), getDrawZ()); // move to position
+  glPushMatrix(); // retain current matrix for arrows
+
+  glTranslatef(pivotX, pivotY, pivotZ); // move to pivot point
+
+  if (mode == MODE_GLOBAL_REFERENCE) glMultMatrixf(matrix);
+
+  //glPushMatrix();
+  //glLoadIdentity();
+  //glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
+  //glPopMatrix();
+
+  //rotateX(angleX);
+  //rotateY(angleY);
+  //rotateZ(angleZ);
+  if (mode == MODE_OBJECT_REFERENCE) {
+    glRotatef(angleX, 1.0, 0.0, 0.0);
+    glRotatef(angleY, 0.0, 1.0, 0.0);
+    glRotatef(angleZ, 0.0, 0.0, 1.0);
+  }
+  //glMultMatrixf(matrix);
+
+  glTranslatef(-pivotX, -pivotY, -pivotZ); // move back (from pivot)
+
+  glGetFloatv(GL_MODELVIEW_MATRIX, outputMatrix);
+  
+  glColor4fv(color);
+  // set material properties
+  GLfloat matAmbDiff0[] = { 0.8, 0.8, 0.8, 1.0};
+  GLfloat matSpecular0[] = { 0.2, 0.2, 0.2, 1.0};
+  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, matAmbDiff0);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, matSpecular0);
+  glMaterialf(GL_FRONT, GL_SHININESS, 10);
+
+  if (interactive) glBindTexture(GL_TEXTURE_2D, texId[4]);
+  else glBindTexture(GL_TEXTURE_2D, texId[6]);
+
+  /*glBegin(GL_QUADS);
+  glNormal3f(0.0, 1.0, 0.0);
+  glVertex3f(-20.0, 1.0, 1.0);
+  glVertex3f(20.0, 1.0, 1.0);
+  glVertex3f(20.0, 1.0, -1.0);
+  glVertex3f(-20.0, 1.0, -1.0);
+
+  glNormal3f(0.0, 0.0, 1.0);
+  glVertex3f(-20.0, -1.0, 1.0);
+  glVertex3f(20.0, -1.0, 1.0);
+  glVertex3f(20.0, 1.0, 1.0);
+  glVertex3f(-20.0, 1.0, 1.0);
+
+  glNormal3f(0.0, 0.0, -1.0);
+  glVertex3f(-20.0, 1.0, -1.0);
+  glVertex3f(20.0, 1.0, -1.0);
+  glVertex3f(20.0, -1.0, -1.0);
+  glVertex3f(-20.0, -1.0, -1.0);
+  
+  glNormal3f(0.0, -1.0, 0.0);
+  glVertex3f(-20.0, -1.0, 1.0);
+  glVertex3f(-20.0, -1.0, -1.0);
+  glVertex3f(20.0, -1.0, -1.0);
+  glVertex3f(20.0, -1.0, 1.0);
+  glEnd();*/
+
+  for (int c = 0; c < numCubes; c++) {
+    int i = cubes[c].x, j = cubes[c].y, k = cubes[c].z;
+    glPushMatrix();
+    glTranslatef(i * 5.0, j * 5.0, k * 5.0);
+    //glutSolidCube(5.0);
+    if (i * 5 == pivotX && j * 5 == pivotY && k * 5 == pivotZ && selected && !arrows) {
+      // draw triangle in pivot block
+      /*glDisable(GL_DEPTH_TEST);
+      glDisable(GL_CULL_FACE);
+
+      glColor4f(0.2, 0.2, 0.2, 1.0);
+      glBegin(GL_TRIANGLES);
+      glNormal3f(0.0, 0.0, 1.0);
+      glVertex3f(-0.5, -0.5, 0.0);
+      glVertex3f(0.5, -0.5, 0.0);
+      glVertex3f(0.0, 0.5, 0.0);
+      glEnd();
+      
+      glColor4fv(color);
+      glEnable(GL_CULL_FACE);
+      glEnable(GL_DEPTH_TEST);*/
+      // highlight pivot block
+      glColor4f(color[0]*1.2, color[1]*1.2, color[2]*1.2, 1.0);
+      //glDisable(GL_TEXTURE_2D);
+    }else{
+      glColor4fv(color);
+      //glEnable(GL_TEXTURE_2D);
+    }
+    drawCube();
+    glPopMatrix();
+  }
+
+  //glEnable(GL_TEXTURE_2D);
+
+  // draw arrows
+  glPopMatrix(); // end object matrix, still in initial matrix
+
+  if (selected && arrows) {
+    glDisable(GL_DEPTH_TEST); // so block can go through arrows and they'll still be seen
+    glDisable(GL_TEXTURE_2D);
+
+    drawArrows();
+
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_DEPTH_TEST);
+  }
+
+  glPopMatrix();
+
+  if (wallMarkAlpha > 0.0) {
+    drawWallMark(texId);
+  }
+}
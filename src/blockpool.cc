@@ -0,0 +1,248 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "blockpool.h"
+
+// BlockPool constructor
+BlockPool::BlockPool()
+{
+  freeSlot = -1;
+  searchCount = 0;
+}
+
+// BlockPool copy constructor
+//   other - the pool to copy
+BlockPool::BlockPool(const BlockPool &other)
+{
+  freeSlot = -1;
+  searchCount = 0;
+  *this = other;
+}
+
+// Make this pool a copy of another, slot for slot, so that the other's
+// handles find the same blocks here. The pages already here are reused.
+//   other - the pool to copy
+//
+// Returns:
+//   this pool
+BlockPool &BlockPool::operator=(const BlockPool &other)
+{
+  if (this == &other) return *this;
+
+  for (int i = 0; i < (int) live.size(); i++) blockIn(slot(live[i]))->~Block();
+
+  while (pages.size() > other.pages.size()) {
+    delete [] pages.back();
+    pages.pop_back();
+  }
+  while (pages.size() < other.pages.size()) pages.push_back(new Slot[BLOCKPOOL_PAGE_SIZE]);
+
+  for (int p = 0; p < (int) pages.size(); p++) {
+    for (int i = 0; i < BLOCKPOOL_PAGE_SIZE; i++) {
+      Slot &s = pages[p][i];
+      const Slot &o = other.pages[p][i];
+      s.generation = o.generation;
+      s.next = o.next;
+      s.activePlace = o.activePlace;
+      s.mark = o.mark;
+      s.used = o.used;
+      if (o.used) new (s.storage) Block(*reinterpret_cast<const Block*>(o.storage));
+    }
+  }
+
+  live = other.live;
+  active = other.active;
+  freeSlot = other.freeSlot;
+  byId = other.byId;
+  pending.clear();
+  searchCount = other.searchCount;
+  return *this;
+}
+
+// BlockPool destructor
+BlockPool::~BlockPool()
+{
+  clear();
+  for (int i = 0; i < (int) pages.size(); i++) delete [] pages[i];
+}
+
+// Take a slot off the free list, adding a page of slots if there are none
+//
+// Returns:
+//   the slot, or -1 if the pool is full
+int BlockPool::allocate()
+{
+  if (freeSlot < 0) {
+    int first = pages.size() * BLOCKPOOL_PAGE_SIZE;
+    if (first >= BLOCKPOOL_MAX_BLOCKS) {
+      cerr << "BlockPool::allocate - no more room for blocks" << endl;
+      return -1;
+    }
+
+    Slot *page = new Slot[BLOCKPOOL_PAGE_SIZE];
+    pages.push_back(page);
+    // chain the new slots so they're handed out in order
+    for (int i = BLOCKPOOL_PAGE_SIZE - 1; i >= 0; i--) {
+      page[i].generation = 1;
+      page[i].used = false;
+      page[i].activePlace = -1;
+      page[i].mark = 0;
+      page[i].next = freeSlot;
+      freeSlot = first + i;
+    }
+  }
+
+  int index = freeSlot;
+  Slot &s = slot(index);
+  freeSlot = s.next;
+  s.used = true;
+  s.next = live.size();
+  live.push_back(index);
+  return index;
+}
+
+// Put a slot's block in the active list, if it isn't already
+//   index - the slot
+void BlockPool::activate(int index)
+{
+  Slot &s = slot(index);
+  if (s.activePlace >= 0) return;
+  s.activePlace = active.size();
+  active.push_back(index);
+}
+
+// Take a block out of the active list, moving the last one into its place
+//   i - the block's place in the active list
+void BlockPool::removeActive(int i)
+{
+  int index = active[i];
+  active[i] = active.back();
+  slot(active[i]).activePlace = i;
+  active.pop_back();
+  slot(index).activePlace = -1;
+}
+
+// Destroy a block and free its slot. Handles to it are no longer valid.
+// A slot that has been through all its generations is retired instead of
+// freed, and its page keeps it for good.
+//   h - the block's handle (nothing happens if it's already gone)
+void BlockPool::destroy(BlockHandle h)
+{
+  Block *b = get(h);
+  if (b == NULL) return;
+
+  int index = h & (BLOCKPOOL_MAX_BLOCKS - 1);
+  Slot &s = slot(index);
+  if (s.activePlace >= 0) removeActive(s.activePlace);
+  byId.erase(b->getId());
+  b->~Block();
+
+  // fill the gap in the live list with the last block in it
+  int place = s.next;
+  live[place] = live.back();
+  slot(live[place]).next = place;
+  live.pop_back();
+
+  s.used = false;
+  if (++s.generation == BLOCKPOOL_GENERATIONS) return; // retired
+  s.next = freeSlot;
+  freeSlot = index;
+}
+
+// Destroy all the blocks
+void BlockPool::clear()
+{
+  while (live.size() > 0) destroy(handle(live.size() - 1));
+}
+
+// Unground a block, so gravity works on it again
+//   h - the block's handle
+void BlockPool::unGround(BlockHandle h)
+{
+  Block *b = get(h);
+  if (b == NULL) return;
+  b->unGrounded();
+  activate(h & (BLOCKPOOL_MAX_BLOCKS - 1));
+}
+
+// Unground a block and everything resting on it: whatever is above it in
+// the columns it occupies, then whatever is above those, and so on
+//   h - the block's handle
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+void BlockPool::unGroundAbove(BlockHandle h, const CollisionGrid &grid, float boundaries[])
+{
+  if (get(h) == NULL) return;
+
+  searchCount++;
+  slot(h & (BLOCKPOOL_MAX_BLOCKS - 1)).mark = searchCount;
+  pending.clear();
+  pending.push_back(h);
+
+  while (pending.size() > 0) {
+    Block *b = get(pending.back());
+    unGround(pending.back());
+    pending.pop_back();
+
+    Cell cells[BLOCK_MAX_CUBES];
+    int n = b->getCells(cells, grid, boundaries);
+    for (int i = 0; i < n; i++) {
+      // the occupied cells above this cube, lowest first
+      for (int y = grid.getAbove(cells[i].x, cells[i].y, cells[i].z); y >= 0; y = grid.getAbove(cells[i].x, y, cells[i].z)) {
+        int id = grid.getId(cells[i].x, y, cells[i].z);
+        if (id == b->getId()) continue;
+
+        BlockHandle other = find(id);
+        if (other == NO_BLOCK) continue;
+        Slot &s = slot(other & (BLOCKPOOL_MAX_BLOCKS - 1));
+        if (s.mark == searchCount) continue; // already found
+        s.mark = searchCount;
+        pending.push_back(other);
+      }
+    }
+  }
+}
+
+// Name a block for sending over the network: its id, which is the same on
+// every peer, as base 64 digits from '0' (a handle is only good here).
+// None of the characters can be null, STX or ETX.
+//   h - the block's handle
+//
+// Returns:
+//   BLOCK_ID_CHARS characters, for id 0 (no block) if h has gone
+string BlockPool::toNetwork(BlockHandle h)
+{
+  Block *b = get(h);
+  int id = b == NULL ? 0 : b->getId();
+  string s;
+  for (int i = BLOCK_ID_CHARS - 1; i >= 0; i--) s += (char) ('0' + (id >> (i * 6)) % 64);
+  return s;
+}
+
+// Find a block named by toNetwork
+//   c - the BLOCK_ID_CHARS characters
+//
+// Returns:
+//   the block's handle here, or NO_BLOCK if there isn't a block with that id
+BlockHandle BlockPool::fromNetwork(const char *c) const
+{
+  int id = 0;
+  for (int i = 0; i < BLOCK_ID_CHARS; i++) id = (id << 6) | ((c[i] - '0') & 63);
+  return id == 0 ? NO_BLOCK : find(id);
+}
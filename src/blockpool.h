@@ -0,0 +1,199 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * blockpool.h
+ *
+ * The game blocks, held in slots that are addressed by handle.
+ *
+ * A handle is a slot number plus the slot's generation, which goes up every
+ * time the slot is freed. Looking a handle up is O(1), and a handle to a
+ * block that has gone (split by a layer, or cleared at the end of a game)
+ * comes back as NULL rather than whichever block took its place. A slot
+ * whose generations have all been used is retired rather than starting
+ * again, so an old handle can never be good for a new block. Slots are
+ * allocated a page at a time and never move, so a Block* stays good until
+ * its block is destroyed.
+ *
+ * The blocks in use are also kept in a dense list for going through them
+ * all, with blocks[i] for i from 0 to size() - 1. Destroying a block moves
+ * the last one in the list into its place.
+ *
+ * Blocks that may be falling are kept in a second, active list, so gravity
+ * only looks at those. New blocks start active, and unGround() makes a block
+ * active again; a block leaves the list when gravity finds it grounded. To
+ * keep the list right, unground blocks through the pool rather than with
+ * Block::unGrounded().
+ *
+ * Handles only mean anything to the pool that made them: two peers' pools
+ * have had different blocks come and go in their slots. Over the network a
+ * block goes by its id, which every peer gives it (see toNetwork).
+ *
+ * Copying a pool (for a snapshot, see snapshot.h) copies every slot, so
+ * handles from the original work the same in the copy. Copying back into a
+ * pool reuses its pages.
+ */
+
+#ifndef _BLOCKPOOL_
+#define _BLOCKPOOL_
+
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "block.h"
+
+// handles are (generation << BLOCKPOOL_INDEX_BITS) | slot, never 0
+typedef unsigned int BlockHandle;
+
+#define NO_BLOCK 0
+
+#define BLOCKPOOL_INDEX_BITS 18
+#define BLOCKPOOL_MAX_BLOCKS (1 << BLOCKPOOL_INDEX_BITS)
+#define BLOCKPOOL_GENERATIONS 4096
+#define BLOCKPOOL_PAGE_SIZE 64
+
+// number of characters in a block id sent over the network, six bits each
+// (see toNetwork)
+#define BLOCK_ID_CHARS 5
+
+using namespace std;
+
+class BlockPool {
+
+  private:
+    struct Slot {
+      alignas(Block) unsigned char storage[sizeof(Block)];
+      int generation; // 1 to BLOCKPOOL_GENERATIONS - 1, or BLOCKPOOL_GENERATIONS once retired
+      int next; // next free slot while free, place in live while in use
+      int activePlace; // place in active, or -1
+      int mark; // last unGroundAbove() search to reach this block
+      bool used;
+    };
+
+    vector <Slot*> pages;
+    vector <int> live; // slots in use, in no particular order
+    vector <int> active; // slots of blocks that may be falling
+    int freeSlot; // first free slot, or -1
+    unordered_map <int, BlockHandle> byId; // block id to handle
+    vector <BlockHandle> pending; // blocks still to search above
+    int searchCount; // number of unGroundAbove() searches
+
+    Slot &slot(int index) {
+      return pages[index / BLOCKPOOL_PAGE_SIZE][index % BLOCKPOOL_PAGE_SIZE];
+    }
+
+    Block *blockIn(Slot &s) {
+      return reinterpret_cast<Block*>(s.storage);
+    }
+
+    int allocate();
+    void activate(int);
+
+  public:
+    BlockPool();
+    BlockPool(const BlockPool&);
+    ~BlockPool();
+
+    BlockPool &operator=(const BlockPool&);
+
+    // Build a block in a free slot
+    //   args - passed on to the Block constructor
+    //
+    // Returns:
+    //   the handle of the new block, or NO_BLOCK if the pool is full
+    template <class... Args>
+    BlockHandle create(Args&&... args) {
+      int index = allocate();
+      if (index < 0) return NO_BLOCK;
+      Slot &s = slot(index);
+      new (s.storage) Block(std::forward<Args>(args)...);
+      BlockHandle h = (BlockHandle) (s.generation << BLOCKPOOL_INDEX_BITS) | index;
+      byId[blockIn(s)->getId()] = h;
+      activate(index); // new blocks aren't grounded
+      return h;
+    }
+
+    void destroy(BlockHandle);
+    void clear();
+
+    // Find a block by its id (as stored in the collision grid)
+    //   id - the block id
+    //
+    // Returns:
+    //   the block's handle, or NO_BLOCK
+    BlockHandle find(int id) const {
+      unordered_map <int, BlockHandle>::const_iterator i = byId.find(id);
+      return i == byId.end() ? NO_BLOCK : i->second;
+    }
+
+    // Look up a block
+    //   h - the block's handle
+    //
+    // Returns:
+    //   the block, or NULL if it has been destroyed (or h is NO_BLOCK)
+    Block *get(BlockHandle h) {
+      int index = h & (BLOCKPOOL_MAX_BLOCKS - 1);
+      int generation = h >> BLOCKPOOL_INDEX_BITS;
+      if (index >= (int) pages.size() * BLOCKPOOL_PAGE_SIZE) return NULL;
+      Slot &s = slot(index);
+      if (!s.used || s.generation != generation) return NULL;
+      return blockIn(s);
+    }
+
+    // Get the number of blocks in use
+    int size() const {
+      return live.size();
+    }
+
+    // Get a block from the dense list of blocks in use
+    //   i - from 0 to size() - 1
+    Block &operator[](int i) {
+      return *blockIn(slot(live[i]));
+    }
+
+    // Get the handle of a block from the dense list of blocks in use
+    //   i - from 0 to size() - 1
+    BlockHandle handle(int i) {
+      return (BlockHandle) (slot(live[i]).generation << BLOCKPOOL_INDEX_BITS) | live[i];
+    }
+
+    void unGround(BlockHandle);
+    void unGroundAbove(BlockHandle, const CollisionGrid&, float[]);
+
+    // Get the number of blocks in the active list
+    int getActiveSize() const {
+      return active.size();
+    }
+
+    // Get a block from the active list
+    //   i - from 0 to getActiveSize() - 1
+    Block &getActive(int i) {
+      return *blockIn(slot(active[i]));
+    }
+
+    void removeActive(int);
+
+    string toNetwork(BlockHandle);
+    BlockHandle fromNetwork(const char*) const;
+
+};
+
+#endif
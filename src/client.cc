@@ -31,6 +31,7 @@ Client::Client()
   master = false;
   sendBlock = 0;
   oldNetworkData = "";
+  hashMismatches = 0;
 }
 
 // Initialise server address struct and attempt connection to server
@@ -123,6 +124,28 @@ int Client::charToInt(char c)
   return v;
 }
 
+// Write a board hash as base 64 digits from '0', for sending over the
+// network. None of the characters can be null, STX or ETX.
+//   hash - the hash (see CollisionGrid::getHash)
+//
+// Returns:
+//   a HASH_CHARS character string
+string Client::hashToNetwork(unsigned long long hash)
+{
+  string s;
+  for (int i = HASH_CHARS - 1; i >= 0; i--) s += (char) ('0' + (hash >> (i * 6)) % 64);
+  return s;
+}
+
+// Read a board hash written by hashToNetwork
+//   c - the HASH_CHARS characters
+unsigned long long Client::hashFromNetwork(const char *c)
+{
+  unsigned long long hash = 0;
+  for (int i = 0; i < HASH_CHARS; i++) hash = (hash << 6) | ((c[i] - '0') & 63);
+  return hash;
+}
+
 // Deal with adding zeros to the beginning of a number to make it
 // an eight character string
 //   num - the number to make an eight character string
@@ -249,65 +272,65 @@ void Client::transmitBufferedData()
 }
 
 // Manipulate a block based on a received manipulation data unit
-//   blocks - a vector storing all the game blocks
-//   blockNum - the number of the block to be manipulated
+//   blocks - the pool storing all the game blocks
+//   handle - the handle of the block to be manipulated
 //   axis - the axis to rotate the block about
 //   direction - the direction in which rotation should take place
-void Client::manipulateBlock(vector <Block> &blocks, int blockNum, char axis, int direction)
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+void Client::manipulateBlock(BlockPool &blocks, BlockHandle handle, char axis, int direction, CollisionGrid &grid, float boundaries[])
 {
-  if (blockNum < 0 || blockNum > (int) blocks.size() - 1) {
-    cerr << "Client::manipulateBlock(): blockNum out of range: " << blockNum << endl;
+  Block *block = blocks.get(handle);
+  if (block == NULL) {
+    cerr << "Client::manipulateBlock(): block no longer exists: " << handle << endl;
   }else{
     bool turningOrMoving = false;
 
-    if ((blocks[blockNum].getTurning() || blocks[blockNum].getMoving())) turningOrMoving = true;
+    if ((block->getTurning() || block->getMoving())) turningOrMoving = true;
 
     // if block is being moved or turned (by you), and not master, then hit and move (let master take priority)
-    if (turningOrMoving && !blocks[blockNum].getRemoteMovement() && !master) {
-      blocks[blockNum].hit();
+    if (turningOrMoving && !block->getRemoteMovement() && !master) {
+      block->hit();
     }
 
     // block is not turningOrMoving -- go ahead
     // block is turningOrMoving by you and you're !master -- go ahead (will have hit above)
     // block is turning or moving by remote -- add to target position
-    if (!turningOrMoving || (!blocks[blockNum].getRemoteMovement() && !master) || blocks[blockNum].getRemoteMovement()) {
+    if (!turningOrMoving || (!block->getRemoteMovement() && !master) || block->getRemoteMovement()) {
       float newAngle = direction * 180 - 90; // -90 or 90
 
       // narrow down condition
       // first adds to target, second sets target
-      if (turningOrMoving && blocks[blockNum].getRemoteMovement()) {
+      if (turningOrMoving && block->getRemoteMovement()) {
         // buffer the movement for later
-        char temp[4];
-        temp[0] = blockNum + '0';
-        temp[1] = axis + '0';
-        temp[2] = direction + '0';
-        temp[3] = '\0';
-        manipBuf.write(temp);
+        string temp = blocks.toNetwork(handle);
+        temp += axis + '0';
+        temp += direction + '0';
+        manipBuf.write(temp.c_str());
       }else{
-        if (axis == 'X') blocks[blockNum].setTargetAngleX(newAngle);
-        if (axis == 'Y') blocks[blockNum].setTargetAngleY(newAngle);
-        if (axis == 'Z') blocks[blockNum].setTargetAngleZ(newAngle);
+        if (axis == 'X') block->setTargetAngleX(newAngle);
+        if (axis == 'Y') block->setTargetAngleY(newAngle);
+        if (axis == 'Z') block->setTargetAngleZ(newAngle);
       }
 
-      blocks[blockNum].unGrounded();
-      
-      // unground anything above this block
-      for (int i = 0; i < (int) blocks.size(); i++) {
-        if (blocks[i].getY() > blocks[blockNum].getY()) blocks[i].unGrounded();
-      }
+      // unground this block and anything resting on it
+      blocks.unGroundAbove(handle, grid, boundaries);
     }
 
   }
 }
 
 // Move a block based on a received data unit
-//   blocks - the vector storing all the game blocks
-//   blockNum - the number of the block to be moved
+//   blocks - the pool storing all the game blocks
+//   handle - the handle of the block to be moved
 //   direction - the direction in which to move the game block
-void Client::moveBlock(vector <Block> &blocks, int blockNum, int direction)
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+void Client::moveBlock(BlockPool &blocks, BlockHandle handle, int direction, CollisionGrid &grid, float boundaries[])
 {
-  if (blockNum < 0 || blockNum > (int) blocks.size() - 1) {
-    cerr << "Client::moveBlock(): blockNum out of range: " << blockNum << endl;
+  Block *block = blocks.get(handle);
+  if (block == NULL) {
+    cerr << "Client::moveBlock(): block no longer exists: " << handle << endl;
   }else{
     float moveBlockX = 0.0, moveBlockY = 0.0, moveBlockZ = 0.0;
     switch (direction) {
@@ -335,45 +358,59 @@ void Client::moveBlock(vector <Block> &blocks, int blockNum, int direction)
 
     bool turningOrMoving = false;
 
-    if ((blocks[blockNum].getTurning() || blocks[blockNum].getMoving())) turningOrMoving = true;
+    if ((block->getTurning() || block->getMoving())) turningOrMoving = true;
 
     // if block is already turning (by you) and you're not the master then allow received data priority
-    if (turningOrMoving && !blocks[blockNum].getRemoteMovement() && !master){
-      blocks[blockNum].hit();
+    if (turningOrMoving && !block->getRemoteMovement() && !master){
+      block->hit();
     }
 
     // block is not turningOrMoving -- go ahead
     // block is turningOrMoving by you and you're !master -- go ahead (will have hit above)
     // block is turning or moving by remote -- add to target position
-    if (!turningOrMoving || (!blocks[blockNum].getRemoteMovement() && !master) || blocks[blockNum].getRemoteMovement()) {
+    if (!turningOrMoving || (!block->getRemoteMovement() && !master) || block->getRemoteMovement()) {
      
       // narrow down condition
       // first adds to target, second adds to position
-      if (turningOrMoving && blocks[blockNum].getRemoteMovement()) {
-        char temp[3];
-        temp[0] = blockNum + '0';
-        temp[1] = direction + '0';
-        temp[2] = '\0';
-        moveBuf.write(temp);
+      if (turningOrMoving && block->getRemoteMovement()) {
+        string temp = blocks.toNetwork(handle);
+        temp += direction + '0';
+        moveBuf.write(temp.c_str());
       }else{
-        blocks[blockNum].setRemoteMovement(true);
+        block->setRemoteMovement(true);
         // setTargetPosition sets oldX,Y,Z for collision purposes, changeTargetPosition doesn't do that
-        blocks[blockNum].setTargetPosition(blocks[blockNum].getX() + moveBlockX,
-            blocks[blockNum].getY() + moveBlockY, blocks[blockNum].getZ() + moveBlockZ);
+        block->setTargetPosition(block->getX() + moveBlockX,
+            block->getY() + moveBlockY, block->getZ() + moveBlockZ);
       }
 
-      blocks[blockNum].unGrounded();
-      
-      // unground anything above this block
-      for (int i = 0; i < (int) blocks.size(); i++) {
-        if (blocks[i].getY() > blocks[blockNum].getY()) blocks[i].unGrounded();
-      }
+      // unground this block and anything resting on it
+      blocks.unGroundAbove(handle, grid, boundaries);
     }
 
   }
 
 }
 
+// Drop a block straight down based on a received data unit
+//   blocks - the pool storing all the game blocks
+//   handle - the handle of the block to be dropped
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+void Client::dropBlock(BlockPool &blocks, BlockHandle handle, CollisionGrid &grid, float boundaries[])
+{
+  Block *block = blocks.get(handle);
+  if (block == NULL) {
+    cerr << "Client::dropBlock(): block no longer exists: " << handle << endl;
+  }else{
+    // stop any movement in progress, the drop takes priority
+    if (block->getTurning() || block->getMoving()) block->hit();
+
+    // unground anything resting on it before it goes
+    blocks.unGroundAbove(handle, grid, boundaries);
+    block->drop(grid, boundaries);
+  }
+}
+
 // Called to do all client operations
 //   player - the player object
 //   humans - the humans inhabiting the CVE
@@ -382,12 +419,15 @@ void Client::moveBlock(vector <Block> &blocks, int blockNum, int direction)
 //   gravity - a boolean to initiate gravity
 //   receivedLock - a boolean indicating that a lock has been received
 //   receivedRemoveLayer - a boolean indicating that a 'remove layer' request has been received
-void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &blocks, int &blockType, bool &gravity, bool &receivedLock, vector <int> &receivedRemoveLayer)
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+void Client::doClient(Pawn& player, vector <Human>& humans, BlockPool &blocks, int &blockType, bool &gravity, bool &receivedLock, vector <int> &receivedRemoveLayer,
+  CollisionGrid &grid, float boundaries[])
 {
   // client stuff
   int numReadable = 0; // number of sockets readable
   char buf[MAXRECVDATASIZE];
-  int lockNumber = 0; // which block is to be locked?
+  BlockHandle lockHandle = NO_BLOCK; // which block is to be locked?
 
   timeout.tv_sec = 0;
   timeout.tv_usec = 0;
@@ -496,9 +536,10 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
 
       // if while loop will fail, go back to original index so STX is not lost
       // IF ALTERING CHUNK SIZE DO IT IN THE WHILE LOOP TOO!
-      if (!(((flag == FLAG_POSITION && chunk > 39) || (flag == FLAG_LOCK && chunk > 0) || (flag == FLAG_MANIPULATE && chunk > 2)
-             || (flag == FLAG_NEW_BLOCK && chunk > 0) || (flag == FLAG_MOVE && chunk > 1) || (flag == FLAG_GRAVITY && chunk > -1)
-             || (flag == FLAG_BLOCK && chunk > 19 * 8 + 1) || (flag == FLAG_LAYER_FOUND && chunk > 0) || (flag == FLAG_LAYER_REMOVE && chunk > 0))
+      if (!(((flag == FLAG_POSITION && chunk > 39) || (flag == FLAG_LOCK && chunk > BLOCK_ID_CHARS - 1) || (flag == FLAG_MANIPULATE && chunk > BLOCK_ID_CHARS + 1)
+             || (flag == FLAG_NEW_BLOCK && chunk > 0) || (flag == FLAG_MOVE && chunk > BLOCK_ID_CHARS) || (flag == FLAG_GRAVITY && chunk > -1)
+             || (flag == FLAG_BLOCK && chunk > 19 * 8 + BLOCK_ID_CHARS - 1) || (flag == FLAG_LAYER_FOUND && chunk > 0) || (flag == FLAG_LAYER_REMOVE && chunk > 0)
+             || (flag == FLAG_DROP && chunk > BLOCK_ID_CHARS - 1) || (flag == FLAG_HASH && chunk > HASH_CHARS - 1))
              && !overflow)) {
         // since we've not got enough data, the while loop will not execute (flag is FLAG_NONE)
         // and the array will be shifted back based on startIndex. But we want the STX (2) character
@@ -510,10 +551,11 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
       // also can't process data if we have an overflow
       // do add a new flag we need to add a condition here
       // IF ALTERING CHUNK SIZE DO IT IN THE ABOVE CONDITION TOO!
-      while (((flag == FLAG_POSITION && chunk > 39) || (flag == FLAG_LOCK && chunk > 0) || (flag == FLAG_MANIPULATE && chunk > 2)
-             || (flag == FLAG_NEW_BLOCK && chunk > 0) || (flag == FLAG_MOVE && chunk > 1) || (flag == FLAG_GRAVITY && chunk > -1)
-             || (flag == FLAG_BLOCK && chunk > 19 * 8 + 1) || (flag == FLAG_LAYER_FOUND && chunk > 0)
-             || (flag == FLAG_LAYER_REMOVE && chunk > 0)) && !overflow) {
+      while (((flag == FLAG_POSITION && chunk > 39) || (flag == FLAG_LOCK && chunk > BLOCK_ID_CHARS - 1) || (flag == FLAG_MANIPULATE && chunk > BLOCK_ID_CHARS + 1)
+             || (flag == FLAG_NEW_BLOCK && chunk > 0) || (flag == FLAG_MOVE && chunk > BLOCK_ID_CHARS) || (flag == FLAG_GRAVITY && chunk > -1)
+             || (flag == FLAG_BLOCK && chunk > 19 * 8 + BLOCK_ID_CHARS - 1) || (flag == FLAG_LAYER_FOUND && chunk > 0)
+             || (flag == FLAG_LAYER_REMOVE && chunk > 0) || (flag == FLAG_DROP && chunk > BLOCK_ID_CHARS - 1)
+             || (flag == FLAG_HASH && chunk > HASH_CHARS - 1)) && !overflow) {
 
         // if it's not you
         if (id != dataId) {
@@ -574,12 +616,13 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
 
           }else if (flag == FLAG_LOCK && humanId > -1) {
             //cout << "flag lock" << endl;
-            // get block number to lock
-            lockNumber = (int) (receivedSoFar[startIndex++] - '0'); // advance startIndex
-            //if (lockNumber > blocks.size() - 1 || lockNumber < 0) {
-            //  cerr << "client::doClient: lockNumber out of range: " << lockNumber << endl;
+            // get handle of block to lock
+            lockHandle = blocks.fromNetwork(&receivedSoFar[startIndex]);
+            startIndex += BLOCK_ID_CHARS; // advance startIndex
+            //if (blocks.get(lockHandle) == NULL) {
+            //  cerr << "client::doClient: lockHandle is not a block: " << lockHandle << endl;
             //}else{
-            humans[humanId].setLocked(lockNumber);
+            humans[humanId].setLocked(lockHandle);
             receivedLock = true;
             //}
           }else if (flag == FLAG_NEW_BLOCK) {
@@ -589,28 +632,26 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
           }else if (flag == FLAG_GRAVITY) {
             gravity = true;
           }else if (flag == FLAG_MANIPULATE) {
-            manipulateBlock(blocks, receivedSoFar[startIndex] - '0', receivedSoFar[startIndex+1], receivedSoFar[startIndex+2] - '0');
-            startIndex += 3;
+            manipulateBlock(blocks, blocks.fromNetwork(&receivedSoFar[startIndex]),
+              receivedSoFar[startIndex+BLOCK_ID_CHARS], receivedSoFar[startIndex+BLOCK_ID_CHARS+1] - '0', grid, boundaries);
+            startIndex += BLOCK_ID_CHARS + 2;
           }else if (flag == FLAG_MOVE) {
-            moveBlock(blocks, receivedSoFar[startIndex] - '0', receivedSoFar[startIndex+1] - '0');
-            startIndex += 2;
+            moveBlock(blocks, blocks.fromNetwork(&receivedSoFar[startIndex]), receivedSoFar[startIndex+BLOCK_ID_CHARS] - '0', grid, boundaries);
+            startIndex += BLOCK_ID_CHARS + 1;
+          }else if (flag == FLAG_DROP) {
+            dropBlock(blocks, blocks.fromNetwork(&receivedSoFar[startIndex]), grid, boundaries);
+            startIndex += BLOCK_ID_CHARS;
           }else if (flag == FLAG_BLOCK) {
             // interpret the data
             negative = false;
             value = 0;
             data.clear();
 
-            // we know the id of the block in question, but which element of
-            // the array is this?
-            int blockId = (int) (receivedSoFar[startIndex++] - '0');
-            int blockNum = -1;
-            for (int i = 0; i < (int) blocks.size(); i++) {
-              if (blocks[i].getId() == blockId) blockNum = i;
-            }
-
-            // does block exist? array may have changed due to a layer being
+            // does block exist? it may have been split by a layer being
             // completed
-            if (blockNum > -1) {
+            Block *block = blocks.get(blocks.fromNetwork(&receivedSoFar[startIndex]));
+            startIndex += BLOCK_ID_CHARS;
+            if (block != NULL) {
               // read in main chunk of data - if size of chunk alters then alter 'startIndex +=' below
               for (int i = startIndex; i < startIndex+19*8; i+=8) {
                 if (receivedSoFar[i] == '1') negative = true;
@@ -629,23 +670,38 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
               }
               bool same = true;
               for (int i = 0; i < 16; i++) {
-                if (blocks[blockNum].getConfirmedMatrix(i) < data[i] - 0.1 || blocks[blockNum].getConfirmedMatrix(i) > data[i] + 0.1) same = false;
-                blocks[blockNum].setConfirmedMatrix(i, data[i]);
+                if (block->getConfirmedMatrix(i) < data[i] - 0.1 || block->getConfirmedMatrix(i) > data[i] + 0.1) same = false;
+                block->setConfirmedMatrix(i, data[i]);
               }
-              if (blocks[blockNum].getConfirmedX() < data[16] - 0.1 || blocks[blockNum].getConfirmedX() > data[16] + 0.1) same = false;
-              if (blocks[blockNum].getConfirmedY() < data[17] - 0.1 || blocks[blockNum].getConfirmedY() > data[17] + 0.1) same = false;
-              if (blocks[blockNum].getConfirmedZ() < data[18] - 0.1 || blocks[blockNum].getConfirmedZ() > data[18] + 0.1) same = false;
-              blocks[blockNum].setConfirmedX(data[16]);
-              blocks[blockNum].setConfirmedY(data[17]);
-              blocks[blockNum].setConfirmedZ(data[18]);
+              if (block->getConfirmedX() < data[16] - 0.1 || block->getConfirmedX() > data[16] + 0.1) same = false;
+              if (block->getConfirmedY() < data[17] - 0.1 || block->getConfirmedY() > data[17] + 0.1) same = false;
+              if (block->getConfirmedZ() < data[18] - 0.1 || block->getConfirmedZ() > data[18] + 0.1) same = false;
+              block->setConfirmedX(data[16]);
+              block->setConfirmedY(data[17]);
+              block->setConfirmedZ(data[18]);
               if (same) {
-                blocks[blockNum].setGotConfirmed(true);
+                block->setGotConfirmed(true);
                 //cout << "same" << endl;
               }
-              startIndex += 19 * 8 + 1;
             }
+            startIndex += 19 * 8;
+          }else if (flag == FLAG_HASH) {
+            // the master's landed blocks, to check ours against. Only
+            // what has landed is compared: falling blocks are a round trip
+            // behind on one side or the other, and the hash comes at no
+            // particular tick. A difference that lasts is reported, and
+            // FLAG_BLOCK goes on putting blocks where the master has them.
+            if (!master) {
+              if (hashFromNetwork(&receivedSoFar[startIndex]) == grid.getHash()) {
+                if (hashMismatches >= HASH_MISMATCH_LIMIT) cerr << "Client::doClient - board back in step with the master's" << endl;
+                hashMismatches = 0;
+              }else if (++hashMismatches == HASH_MISMATCH_LIMIT) {
+                cerr << "Client::doClient - board out of step with the master's (hash differs)" << endl;
+              }
+            }
+            startIndex += HASH_CHARS;
           }else if (flag == FLAG_LAYER_REMOVE) {
-            receivedRemoveLayer.push_back((int) receivedSoFar[startIndex++] - 1);
+            receivedRemoveLayer.push_back((int) (unsigned char) receivedSoFar[startIndex++] - 1);
             cout << "received remove layer data unit: " << receivedRemoveLayer[(int) receivedRemoveLayer.size()-1] << endl;
           }else if (flag == FLAG_LAYER_FOUND) {
             cout << "received flag layer found... shouldn't have" << endl;
@@ -664,22 +720,28 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
               startIndex += 40; // move the cursor to the next unread piece of data
               break;
             case FLAG_LOCK:
-              startIndex ++;
+              startIndex += BLOCK_ID_CHARS;
               break;
             case FLAG_MANIPULATE:
-              startIndex += 3; // block number, axis, direction
+              startIndex += BLOCK_ID_CHARS + 2; // block id, axis, direction
               break;
             case FLAG_MOVE:
               // only move on remote instruction so any bugs affect both clients!!
-              moveBlock(blocks, receivedSoFar[startIndex] - '0', receivedSoFar[startIndex+1] - '0');
-              startIndex += 2; // block number, direction
+              moveBlock(blocks, blocks.fromNetwork(&receivedSoFar[startIndex]), receivedSoFar[startIndex+BLOCK_ID_CHARS] - '0', grid, boundaries);
+              startIndex += BLOCK_ID_CHARS + 1; // block id, direction
+              break;
+            case FLAG_DROP:
+              startIndex += BLOCK_ID_CHARS;
+              break;
+            case FLAG_HASH:
+              startIndex += HASH_CHARS;
               break;
             case FLAG_NEW_BLOCK:
               cerr << "error: got a server message for new block but dataId was same as me" << endl;
               startIndex ++;
               break;
             case FLAG_BLOCK:
-              startIndex += 19 * 8 + 1;
+              startIndex += 19 * 8 + BLOCK_ID_CHARS;
               break;
             case FLAG_GRAVITY:
               cerr << "error: got a server message for gravity but dataId was same as me" << endl;
@@ -737,14 +799,17 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
       oldNetworkData = networkData;
     }
 
+    // the landed blocks in a few bytes, for the slaves to check theirs
+    if (master) sendData(FLAG_HASH + hashToNetwork(grid.getHash()));
+
     if (sendBlock < (int) blocks.size()) {
       if (!blocks[sendBlock].getMoving() && !blocks[sendBlock].getTurning() && master) { // && blocks[sendBlock].getGrounded()) 
         networkData = "";
         networkData += FLAG_BLOCK;
         // we want to go through all blocks available and send them (sendBlock)
-        // but because blocks may be split (and the vector change) the receiver needs to identify blocks
-        // by their global id number not their element number
-        networkData += (blocks[sendBlock].getId() + '0');
+        // but because blocks may be split (and the pool change) the receiver needs to identify blocks
+        // by their id, which it finds in its own pool
+        networkData += blocks.toNetwork(blocks.handle(sendBlock));
         for (int i = 0; i < 16; i++)
           networkData += dealZeros(blocks[sendBlock].getMatrix(i));
         networkData += dealZeros(blocks[sendBlock].getX());
@@ -763,44 +828,42 @@ void Client::doClient(Pawn& player, vector <Human>& humans, vector <Block> &bloc
 
   // if there is data waiting to be sent, then attempt transmission
   if (sendBuf.getDataOnBuffer() > 0) transmitBufferedData();
-  if (moveBuf.getDataOnBuffer() > 1) {
+  if (moveBuf.getDataOnBuffer() > BLOCK_ID_CHARS) {
     // read the data from buffer
-    char tempBlockNum;
-    int tempBlockNumInt;
+    char c[BLOCK_ID_CHARS + 1];
 
-    // look at next character on buffer
-    if (moveBuf.getChar(tempBlockNum, 0)) {
+    // look at the block id at the front of the buffer
+    bool gotId = true;
+    for (int i = 0; i < BLOCK_ID_CHARS; i++) gotId = gotId && moveBuf.getChar(c[i], i);
 
-      tempBlockNumInt = (int) (tempBlockNum - '0');
+    if (gotId) {
+      Block *block = blocks.get(blocks.fromNetwork(c));
 
-      // we've got the block number, so if it's not turning or moving then read off the buffer and move it!
-      if (tempBlockNumInt > (int) blocks.size() -1 || tempBlockNumInt < 0) {
-        cerr << "client::doClient(): tempBlockNumInt out of range for moving blocks: " << tempBlockNumInt << endl;
-      }else if (!blocks[tempBlockNumInt].getMoving() && !blocks[tempBlockNumInt].getTurning()) {
-        char c[2];
-        if (moveBuf.read(c, 2) == 2){
-          moveBlock(blocks, (int) (c[0] - '0'), (int) (c[1] - '0'));
+      // we've got the block, so if it's not turning or moving then read off the buffer and move it!
+      // (if it's gone, moveBlock() drops the movement)
+      if (block == NULL || (!block->getMoving() && !block->getTurning())) {
+        if (moveBuf.read(c, BLOCK_ID_CHARS + 1) == BLOCK_ID_CHARS + 1){
+          moveBlock(blocks, blocks.fromNetwork(c), (int) (c[BLOCK_ID_CHARS] - '0'), grid, boundaries);
         }
       }
     }
   }
-  if (manipBuf.getDataOnBuffer() > 2) {
+  if (manipBuf.getDataOnBuffer() > BLOCK_ID_CHARS + 1) {
     // read the data from buffer
-    char tempBlockNum;
-    int tempBlockNumInt;
+    char c[BLOCK_ID_CHARS + 2];
 
-    // look at next character on buffer
-    if (manipBuf.getChar(tempBlockNum, 0)) {
+    // look at the block id at the front of the buffer
+    bool gotId = true;
+    for (int i = 0; i < BLOCK_ID_CHARS; i++) gotId = gotId && manipBuf.getChar(c[i], i);
 
-      tempBlockNumInt = (int) (tempBlockNum - '0');
+    if (gotId) {
+      Block *block = blocks.get(blocks.fromNetwork(c));
 
-      // we've got the block number, so if it's not turning or moving then read off the buffer and manip it!
-      if (tempBlockNumInt > (int) blocks.size() -1 || tempBlockNumInt < 0) {
-        cerr << "client::doClient(): tempBlockNumInt out of range for manipulating blocks: " << tempBlockNumInt << endl;
-      }else if (!blocks[tempBlockNumInt].getMoving() && !blocks[tempBlockNumInt].getTurning()) {
-        char c[3];
-        if (manipBuf.read(c, 3) == 3){
-          manipulateBlock(blocks, (int) (c[0] - '0'), (int) (c[1] - '0'), (int) (c[2] - '0'));
+      // we've got the block, so if it's not turning or moving then read off the buffer and manip it!
+      // (if it's gone, manipulateBlock() drops the manipulation)
+      if (block == NULL || (!block->getMoving() && !block->getTurning())) {
+        if (manipBuf.read(c, BLOCK_ID_CHARS + 2) == BLOCK_ID_CHARS + 2){
+          manipulateBlock(blocks, blocks.fromNetwork(c), (int) (c[BLOCK_ID_CHARS] - '0'), (int) (c[BLOCK_ID_CHARS + 1] - '0'), grid, boundaries);
         }
       }
     }
@@ -43,6 +43,7 @@
 #include "pawn.h"
 #include "human.h"
 #include "block.h"
+#include "blockpool.h"
 #include "buffer.h"
 
 #define PORT 3490 // the port client will be connecting to 
@@ -55,6 +56,8 @@
 #define FLAG_MANIPULATE 'a'
 #define FLAG_MOVE 'b'
 #define FLAG_BLOCK 'B'
+#define FLAG_DROP 'x'
+#define FLAG_HASH 'h'
 
 // the following flags are also defined in the server
 #define FLAG_MASTER 'M'
@@ -67,6 +70,17 @@
 
 #define SERVER_ID 's'
 
+// number of characters in a board hash sent over the network, six bits
+// each (see hashToNetwork)
+#define HASH_CHARS 11
+// how many hashes in a row can differ from the master's before the board is
+// reported out of step (they can differ for a moment while a block lands)
+#define HASH_MISMATCH_LIMIT 20
+
+// layers are sent as y + 1 in a single byte, which limits how high a
+// networked game area can be
+#define NETWORK_MAX_ARENA_HEIGHT 51
+
 using namespace std;
 
 class Client {
@@ -88,6 +102,7 @@ class Client {
     Buffer sendBuf, moveBuf, manipBuf;
     int sendBlock;
     string oldNetworkData;
+    int hashMismatches; // hashes in a row that differ from the master's
 
   public:
     Client();
@@ -95,12 +110,15 @@ class Client {
     char intToChar(int);
     int charToInt(char);
     string dealZeros(float);
+    string hashToNetwork(unsigned long long);
+    unsigned long long hashFromNetwork(const char*);
     int makeNewHuman(int, vector <Human>&);
     void sendData(string);
     void transmitBufferedData();
-    void manipulateBlock(vector <Block>&, int, char, int);
-    void moveBlock(vector <Block>&, int, int);
-    void doClient(Pawn&, vector <Human>&, vector <Block>&, int&, bool&, bool&, vector <int>&);
+    void manipulateBlock(BlockPool&, BlockHandle, char, int, CollisionGrid&, float[]);
+    void moveBlock(BlockPool&, BlockHandle, int, CollisionGrid&, float[]);
+    void dropBlock(BlockPool&, BlockHandle, CollisionGrid&, float[]);
+    void doClient(Pawn&, vector <Human>&, BlockPool&, int&, bool&, bool&, vector <int>&, CollisionGrid&, float[]);
     bool getMaster();
     void setHost(const char*);
     void setReadyToSend(int);
@@ -0,0 +1,1026 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * coretest.cc
+ *
+ * Checks of the game core (libtetris3d.a) without a window: each test sets
+ * up an arena and some blocks, runs the rules on them, and looks at where
+ * things end up. The server's queues (outqueue.h, framereader.h, over a
+ * socket pair) and timers (timerwheel.h) are checked here too. Prints what
+ * failed, and exits with 1 if anything did, so it can be run with
+ * "make check".
+ */
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "blockpool.h"
+#include "framereader.h"
+#include "grid.h"
+#include "outqueue.h"
+#include "rules.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "timerwheel.h"
+#include "trig.h"
+
+using namespace std;
+
+// most ticks a test waits for blocks to stop moving
+#define CORETEST_MAX_TICKS 100000
+
+// values Trig is given at a time, in its batch forms
+#define CORETEST_TRIG_BATCH 1000
+
+BlockPool blocks;
+CollisionGrid collisionGrid;
+float boundaries[4];
+float blockStartY;
+int blockId = 1;
+int clockTick = 0;
+int failures = 0;
+
+// Say if something isn't as it should be
+//   ok - whether it is
+//   test - the test
+//   what - what was checked
+void check(bool ok, const char *test, const char *what)
+{
+  if (ok) return;
+  cerr << test << ": " << what << endl;
+  failures++;
+}
+
+// Start again with an empty arena, centred on the origin (as cve.cc)
+//   width,height,depth - the size in cells
+void setArena(int width, int height, int depth)
+{
+  blocks.clear();
+  boundaries[0] = -5.0 * (width / 2), boundaries[1] = boundaries[0] + 5.0 * (width - 1);
+  boundaries[2] = -5.0 * (depth / 2), boundaries[3] = boundaries[2] + 5.0 * (depth - 1);
+  blockStartY = 5.0 * (height - 2);
+  collisionGrid.resize(width, height, depth);
+  collisionGrid.clear();
+}
+
+// Count the grid cells holding a block, resting or not
+//   id - the block's id
+int cellsHeld(int id)
+{
+  int count = 0;
+  for (int x = 0; x < collisionGrid.getWidth(); x++)
+    for (int y = 0; y < collisionGrid.getHeight(); y++)
+      for (int z = 0; z < collisionGrid.getDepth(); z++)
+        if (collisionGrid.getId(x, y, z) == id) count++;
+  return count;
+}
+
+// A block sent most of the way across a large arena gets there, holding no
+// more than where it started and where it is on the way
+void testLongMove()
+{
+  const char *test = "long move";
+  setArena(64, 16, 64);
+
+  Block *block = blocks.get(Rules::newBlock(blocks, blockId, 1, blockStartY, collisionGrid, boundaries));
+  check(block != NULL, test, "no block made");
+  if (block == NULL) return;
+
+  Cell cells[BLOCK_MAX_CUBES];
+  int numCells = block->getCells(cells, collisionGrid, boundaries);
+  float targetX = block->getX() + 5 * 30;
+  block->setTargetPosition(targetX, block->getY(), block->getZ());
+
+  int mostHeld = 0;
+  for (int i = 0; i < CORETEST_MAX_TICKS && block->getMoving(); i++) {
+    Block::setClock(++clockTick);
+    check(!Rules::moveBlocks(blocks, collisionGrid, boundaries), test, "game over");
+    int held = cellsHeld(block->getId());
+    if (held > mostHeld) mostHeld = held;
+  }
+
+  check(!block->getMoving(), test, "still moving");
+  check(block->getX() == targetX, test, "didn't get to the target");
+  check(mostHeld <= 2 * numCells, test, "held the cells it moved through");
+  check(cellsHeld(block->getId()) == numCells, test, "not in the grid where it ended up");
+}
+
+// Turn a block until the turn is done
+//   block - the block, just given a target angle
+void finishTurn(Block *block)
+{
+  for (int i = 0; i < CORETEST_MAX_TICKS && block->getTurning(); i++) {
+    Block::setClock(++clockTick);
+    Rules::moveBlocks(blocks, collisionGrid, boundaries);
+  }
+}
+
+// A long run of quarter turns, each made in steps of Fixed<16> angle, ends
+// with the block exactly on the grid: its matrix is whole numbers, the same
+// as a table of the turns it was given would say, and it holds just its
+// cells in the collision grid
+void testQuarterTurns()
+{
+  const char *test = "quarter turns";
+  setArena(16, 20, 16);
+  Block::setClock(clockTick = 0);
+
+  Block *block = blocks.get(blocks.create(blockId++, 2, 0, 50, 0, true, collisionGrid, boundaries));
+  check(block != NULL, test, "no block made");
+  if (block == NULL) return;
+  float x = block->getX(), y = block->getY(), z = block->getZ();
+  int numCubes = BLOCK_SHAPES[2].numCubes;
+
+  // learn what each of the six turns does from the start, as rotations
+  int step[6][3][3];
+  for (int t = 0; t < 6; t++) {
+    float angle = t % 2 ? -90 : 90;
+    if (t / 2 == 0) block->setTargetAngleX(angle);
+    else if (t / 2 == 1) block->setTargetAngleY(angle);
+    else block->setTargetAngleZ(angle);
+    finishTurn(block);
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 3; c++) step[t][r][c] = Orientation::rotation(block->getOrientation(), r, c);
+    if (t / 2 == 0) block->setTargetAngleX(-angle);
+    else if (t / 2 == 1) block->setTargetAngleY(-angle);
+    else block->setTargetAngleZ(-angle);
+    finishTurn(block);
+    check(block->getOrientation() == 0, test, "a turn and its opposite didn't cancel");
+  }
+
+  // then give it a long run of them, working out where each should leave it
+  int expected[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+  unsigned int seed = 1;
+  bool exact = true, onGrid = true, held = true, stuck = false;
+  for (int i = 0; i < 1000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int t = (seed >> 16) % 6;
+    float angle = t % 2 ? -90 : 90;
+    if (t / 2 == 0) block->setTargetAngleX(angle);
+    else if (t / 2 == 1) block->setTargetAngleY(angle);
+    else block->setTargetAngleZ(angle);
+    finishTurn(block);
+    if (block->getTurning()) stuck = true;
+
+    // the turns are about the arena's axes, so each goes on the left
+    int turned[3][3];
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 3; c++)
+        turned[r][c] = step[t][r][0] * expected[0][c] + step[t][r][1] * expected[1][c] + step[t][r][2] * expected[2][c];
+    memcpy(expected, turned, sizeof expected);
+
+    float m[16];
+    block->getMatrix(m);
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 3; c++)
+        if (m[c * 4 + r] != expected[r][c] || Orientation::rotation(block->getOrientation(), r, c) != expected[r][c])
+          exact = false;
+    if (m[3] != 0 || m[7] != 0 || m[11] != 0 || m[12] != 0 || m[13] != 0 || m[14] != 0 || m[15] != 1) exact = false;
+    if (block->getX() != x || block->getY() != y || block->getZ() != z) onGrid = false;
+    if (cellsHeld(block->getId()) != numCubes) held = false;
+  }
+
+  check(!stuck, test, "a turn didn't finish");
+  check(exact, test, "matrix not exactly the turns it was given");
+  check(onGrid, test, "moved off its cell");
+  check(held, test, "held the wrong cells");
+
+  Cell cells[BLOCK_MAX_CUBES];
+  int numCells = block->getCells(cells, collisionGrid, boundaries);
+  bool inPlace = numCells == numCubes;
+  for (int i = 0; i < numCells; i++)
+    if (collisionGrid.getId(cells[i].x, cells[i].y, cells[i].z) != block->getId()) inPlace = false;
+  check(inPlace, test, "not in the grid where its cubes are");
+}
+
+// Put a block into the arena and drop it onto what's there
+//   type - the block type, not turned
+//   x - the cell of its first cube across the arena (z is 0)
+//
+// Returns:
+//   the block, or NULL if it couldn't be made
+Block *dropBlock(int type, int x)
+{
+  Block *block = blocks.get(blocks.create(blockId++, type, boundaries[0] + 5.0 * x, blockStartY, boundaries[2], true, collisionGrid, boundaries));
+  if (block != NULL) block->drop(collisionGrid, boundaries);
+  return block;
+}
+
+// Taking out a layer under a block that overhangs a gap leaves the pieces
+// above to settle onto what's left, still hanging over the gap. In a 3x8x1
+// arena (y up the rows, x across):
+//
+//   before       after
+//   . Z Z        . . .
+//   Z Z .        . Z Z
+//   C T .        Z Z .
+//   T T T        C T .
+//
+// so the bottom layer goes, C and what's left of T fall a layer, and Z
+// falls onto them with its right cube still over the gap.
+void testSettleOverhang()
+{
+  const char *test = "settle overhang";
+  setArena(3, 8, 1);
+
+  Block *t = dropBlock(6, 0); // T shape
+  Block *c = dropBlock(0, 0); // single cube
+  Block *z = dropBlock(5, 0); // Z shape
+  check(t != NULL && c != NULL && z != NULL, test, "no block made");
+  if (t == NULL || c == NULL || z == NULL) return;
+  int cId = c->getId(), zId = z->getId();
+  check(cellsHeld(zId) == 4 && collisionGrid.getId(0, 2, 0) == zId && collisionGrid.getId(2, 3, 0) == zId,
+    test, "Z didn't land on C and T");
+
+  LayerSet complete = collisionGrid.takeNewlyComplete();
+  check(complete.count() == 1 && complete[0], test, "bottom layer not complete");
+  Rules::removeLayers(blocks, complete, collisionGrid, boundaries, blockId);
+  check(collisionGrid.getLayerCount(0) == 0, test, "bottom layer not taken out");
+
+  // C, the stem of T and Z all fall
+  check(Rules::settle(blocks, collisionGrid, boundaries) == 3, test, "wrong number of blocks settled");
+
+  const char *after[] = { "CT.", "ZZ.", ".ZZ", "..." };
+  for (int y = 0; y < 4; y++) {
+    for (int x = 0; x < 3; x++) {
+      int id = collisionGrid.getId(x, y, 0);
+      bool ok;
+      if (after[y][x] == 'C') ok = id == cId;
+      else if (after[y][x] == 'Z') ok = id == zId;
+      else if (after[y][x] == 'T') ok = id > 0 && id != cId && id != zId;
+      else ok = id == 0;
+      check(ok, test, "a cell isn't where it should be");
+    }
+  }
+  check(collisionGrid.getLayerCount(0) == 2 && collisionGrid.getLayerCount(1) == 2 && collisionGrid.getLayerCount(2) == 2,
+    test, "layer counts wrong");
+
+  // and it's all landed, so another pass moves nothing
+  check(Rules::settle(blocks, collisionGrid, boundaries) == 0, test, "settled twice");
+}
+
+// Cells either side of a chunk boundary (GRID_CHUNK_SIZE) are kept apart,
+// and a column is followed across chunks, both ways
+void testGridChunks()
+{
+  const char *test = "grid chunks";
+  CollisionGrid grid;
+  grid.resize(20, 20, 20);
+  check(!grid.getClassic(), test, "not chunked");
+
+  int b = GRID_CHUNK_SIZE;
+  grid.setResting(b - 1, b - 1, b - 1, 1);
+  grid.setResting(b, b - 1, b - 1, 2);
+  grid.setResting(b - 1, b, b - 1, 3);
+  grid.setResting(b - 1, b - 1, b, 4);
+  grid.set(b, b, b, 5); // a collision trail
+  check(grid.getId(b - 1, b - 1, b - 1) == 1 && grid.getId(b, b - 1, b - 1) == 2 && grid.getId(b - 1, b, b - 1) == 3
+    && grid.getId(b - 1, b - 1, b) == 4 && grid.getId(b, b, b) == 5, test, "cell ids mixed up");
+  check(grid.getId(b - 2, b - 1, b - 1) == 0 && grid.getId(b + 1, b, b) == 0, test, "cells set that weren't");
+  check(grid.getLayerCount(b - 1) == 3 && grid.getLayerCount(b) == 1, test, "layer counts wrong");
+
+  // the column through x,z = b - 1 has cells at b - 1 and b, either side of
+  // a chunk boundary, and nothing in the chunks above or below
+  check(grid.getFloor(b - 1, 19, b - 1, true) == b + 1, test, "floor not found from a chunk above");
+  check(grid.getFloor(b - 1, b, b - 1, true) == b, test, "floor not found in the chunk below");
+  check(grid.getAbove(b - 1, 0, b - 1) == b - 1, test, "cell above not found");
+  check(grid.getAbove(b - 1, b - 1, b - 1) == b, test, "cell above not found in the chunk above");
+  check(grid.getAbove(b - 1, b, b - 1) == -1, test, "cell above that isn't there");
+  // a trail is only a floor when trails count
+  check(grid.getFloor(b, 19, b, true) == 0 && grid.getFloor(b, 19, b, false) == b + 1, test, "trail counted as resting");
+
+  grid.unset(b - 1, b, b - 1);
+  grid.unset(b, b, b);
+  check(grid.getId(b - 1, b, b - 1) == 0 && grid.getId(b, b, b) == 0, test, "cells not emptied");
+  check(grid.getFloor(b - 1, 19, b - 1, true) == b && grid.getLayerCount(b) == 0, test, "emptied cells still counted");
+  check(grid.getAbove(b - 1, b - 1, b - 1) == -1, test, "emptied cell still above");
+}
+
+// Layers that fill up are noted once as newly complete, and stop being
+// complete when a cell goes
+void testGridLayers()
+{
+  const char *test = "grid layers";
+  // a classic arena and a chunked one wider than a chunk
+  int sizes[2][3] = { { CLASSIC_WIDTH, 12, CLASSIC_DEPTH }, { 10, 12, 10 } };
+
+  for (int s = 0; s < 2; s++) {
+    CollisionGrid grid;
+    grid.resize(sizes[s][0], sizes[s][1], sizes[s][2]);
+    int w = grid.getWidth(), d = grid.getDepth(), y = 9;
+
+    for (int x = 0; x < w; x++)
+      for (int z = 0; z < d; z++) {
+        if (x == w - 1 && z == d - 1) continue;
+        grid.setResting(x, y, z, 1 + x + z * w);
+      }
+    grid.set(w - 1, y, d - 1, 99); // passing through doesn't complete it
+    check(grid.getLayerCount(y) == w * d - 1 && !grid.getCompleteLayers()[y] && grid.takeNewlyComplete().none(),
+      test, "incomplete layer counted as complete");
+
+    grid.setResting(w - 1, y, d - 1, 99);
+    check(grid.getLayerCount(y) == w * d && grid.getCompleteLayers().count() == 1 && grid.getCompleteLayers()[y],
+      test, "full layer not complete");
+    LayerSet newly = grid.takeNewlyComplete();
+    check(newly.count() == 1 && newly[y], test, "full layer not newly complete");
+    check(grid.takeNewlyComplete().none() && grid.getCompleteLayers()[y], test, "newly complete twice");
+
+    grid.setResting(0, y, 0, 1); // again, no change
+    check(grid.getLayerCount(y) == w * d && grid.takeNewlyComplete().none(), test, "cell counted twice");
+
+    grid.unset(0, y, 0);
+    check(grid.getLayerCount(y) == w * d - 1 && grid.getCompleteLayers().none(), test, "layer still complete");
+    grid.setResting(0, y, 0, 1);
+    check(grid.takeNewlyComplete()[y], test, "refilled layer not newly complete");
+  }
+}
+
+// A copy of a chunked grid shares its chunks, but changes to either one
+// don't show in the other
+void testGridCopy()
+{
+  const char *test = "grid copy";
+  CollisionGrid a;
+  a.resize(20, 20, 20);
+  for (int i = 0; i < 16; i++) a.setResting(i, 0, 3, 1 + i);
+  unsigned long long hash = a.getHash();
+
+  CollisionGrid b = a;
+  check(b.getHash() == hash && b.getId(5, 0, 3) == 6, test, "copy differs");
+
+  b.setResting(2, 1, 3, 50); // in a shared chunk
+  b.unset(9, 0, 3); // in the other shared chunk
+  b.set(4, 0, 3, 60); // overwrites a resting cell's id
+  check(a.getId(2, 1, 3) == 0 && a.getId(9, 0, 3) == 10 && a.getId(4, 0, 3) == 5, test, "copy's changes show in the original");
+  check(a.getHash() == hash && a.getLayerCount(0) == 16 && a.getLayerCount(1) == 0, test, "original's counts changed");
+  check(a.getFloor(2, 19, 3, true) == 1 && a.getAbove(9, 0, 3) == -1, test, "original's columns changed");
+
+  a.unset(0, 0, 3);
+  a.setResting(15, 5, 3, 70);
+  check(b.getId(0, 0, 3) == 1 && b.getId(15, 5, 3) == 0 && b.getId(2, 1, 3) == 50 && b.getId(9, 0, 3) == 0,
+    test, "original's changes show in the copy");
+  check(b.getLayerCount(0) == 15 && b.getLayerCount(1) == 1 && b.getLayerCount(5) == 0, test, "copy's counts wrong");
+
+  // a classic grid is copied whole
+  CollisionGrid c;
+  c.setResting(1, 1, 1, 1);
+  CollisionGrid e = c;
+  e.unset(1, 1, 1);
+  check(c.getId(1, 1, 1) == 1 && c.getHash() != 0 && e.getHash() == 0, test, "classic copy not separate");
+}
+
+// The Zobrist hash depends on which ids rest where, not the order cells
+// were set and emptied in, nor on collision trails
+void testGridHash()
+{
+  const char *test = "grid hash";
+  int sizes[2][3] = { { CLASSIC_WIDTH, 12, CLASSIC_DEPTH }, { 20, 20, 20 } };
+
+  for (int s = 0; s < 2; s++) {
+    CollisionGrid a, b;
+    a.resize(sizes[s][0], sizes[s][1], sizes[s][2]);
+    b.resize(sizes[s][0], sizes[s][1], sizes[s][2]);
+
+    // the same 37 cells, in a different order, one of them with a
+    // different id first and some with trails through them
+    int cells[37][3];
+    for (int i = 0; i < 37; i++) cells[i][0] = i % 5, cells[i][1] = i / 5, cells[i][2] = (i * 3) % 5;
+    for (int i = 0; i < 37; i++) a.setResting(cells[i][0], cells[i][1], cells[i][2], 1 + i);
+    b.setResting(cells[0][0], cells[0][1], cells[0][2], 99);
+    for (int i = 0; i < 37; i++) {
+      int j = (i * 10) % 37; // 10 and 37 have no common factor, so every cell comes once
+      if (j == 0) b.unset(cells[0][0], cells[0][1], cells[0][2]);
+      b.set(cells[j][0], 11, cells[j][2], 100 + j);
+      b.setResting(cells[j][0], cells[j][1], cells[j][2], 1 + j);
+    }
+    check(a.getHash() == b.getHash(), test, "hash depends on the order, or counts trails");
+    for (int i = 0; i < 37; i++) b.unset(cells[i][0], 11, cells[i][2]);
+    check(a.getHash() == b.getHash(), test, "emptying trails changed the hash");
+
+    // the same id somewhere else, or another id in the same place, differs
+    unsigned long long before = a.getHash();
+    a.unset(cells[5][0], cells[5][1], cells[5][2]);
+    a.setResting(cells[5][0], 10, cells[5][2], 6);
+    check(a.getHash() != before, test, "moved cell hashes the same");
+    a.unset(cells[5][0], 10, cells[5][2]);
+    a.setResting(cells[5][0], cells[5][1], cells[5][2], 7);
+    check(a.getHash() != before, test, "changed id hashes the same");
+    a.set(cells[5][0], cells[5][1], cells[5][2], 6); // a new id in a resting cell
+    check(a.getHash() == before, test, "id changed in place not hashed");
+
+    for (int i = 0; i < 37; i++) a.unset(cells[i][0], cells[i][1], cells[i][2]);
+    check(a.getHash() == 0, test, "empty grid doesn't hash to 0");
+  }
+}
+
+// Make a single cube block in a pool, at the start height over the middle
+//   pool - the pool
+//   id - the block's id
+BlockHandle makeCube(BlockPool &pool, int id)
+{
+  return pool.create(id, 0, 0.0, blockStartY, 0.0, true, collisionGrid, boundaries);
+}
+
+// A handle to a block that has gone finds nothing, even once its slot has
+// a new block in it
+void testPoolStaleHandle()
+{
+  const char *test = "pool stale handle";
+  setArena(5, 12, 5);
+  BlockPool pool;
+
+  BlockHandle a = makeCube(pool, 1);
+  BlockHandle b = makeCube(pool, 2);
+  pool.destroy(a);
+  BlockHandle c = makeCube(pool, 3); // takes a's slot
+  check((c & (BLOCKPOOL_MAX_BLOCKS - 1)) == (a & (BLOCKPOOL_MAX_BLOCKS - 1)), test, "slot not reused");
+  check(c != a && pool.get(a) == NULL, test, "old handle finds the new block");
+  check(pool.get(c) != NULL && pool.get(c)->getId() == 3 && pool.get(b)->getId() == 2, test, "handles find the wrong blocks");
+  check(pool.find(1) == NO_BLOCK && pool.find(3) == c, test, "ids find the wrong blocks");
+
+  pool.destroy(a); // already gone, so nothing happens
+  check(pool.size() == 2 && pool.get(c) != NULL, test, "destroying a stale handle destroyed a block");
+
+  // handles past the pages, or with a generation never given out
+  check(pool.get(NO_BLOCK) == NULL, test, "NO_BLOCK finds a block");
+  check(pool.get((BlockHandle) (1 << BLOCKPOOL_INDEX_BITS) | (BLOCKPOOL_MAX_BLOCKS - 1)) == NULL, test, "handle past the pages finds a block");
+  check(pool.get((BlockHandle) (5 << BLOCKPOOL_INDEX_BITS) | (b & (BLOCKPOOL_MAX_BLOCKS - 1))) == NULL, test, "future generation finds a block");
+}
+
+// A slot goes through every generation once, then is retired so none of
+// its handles can be good again
+void testPoolGenerations()
+{
+  const char *test = "pool generations";
+  setArena(5, 12, 5);
+  BlockPool pool;
+
+  vector <BlockHandle> handles;
+  for (int i = 1; i < BLOCKPOOL_GENERATIONS; i++) {
+    BlockHandle h = makeCube(pool, i);
+    handles.push_back(h);
+    pool.destroy(h);
+  }
+  bool sameSlot = true, stale = true;
+  for (int i = 0; i < (int) handles.size(); i++) {
+    if ((handles[i] & (BLOCKPOOL_MAX_BLOCKS - 1)) != (handles[0] & (BLOCKPOOL_MAX_BLOCKS - 1))) sameSlot = false;
+    if (handles[i] == NO_BLOCK || (int) (handles[i] >> BLOCKPOOL_INDEX_BITS) != i + 1) stale = false;
+  }
+  check(sameSlot, test, "slot not reused");
+  check(stale, test, "generations not counted up from 1");
+
+  // the slot is retired, so the next block goes somewhere else and none of
+  // the old handles find it
+  BlockHandle next = makeCube(pool, BLOCKPOOL_GENERATIONS);
+  check((next & (BLOCKPOOL_MAX_BLOCKS - 1)) != (handles[0] & (BLOCKPOOL_MAX_BLOCKS - 1)), test, "retired slot reused");
+  bool found = false;
+  for (int i = 0; i < (int) handles.size(); i++) if (pool.get(handles[i]) != NULL) found = true;
+  check(!found && pool.get(next) != NULL, test, "old handle finds a block");
+}
+
+// Blocks are named over the network by id: another pool finds its own
+// block with that id, whichever slot it's in, right up to the largest id
+// that fits in BLOCK_ID_CHARS
+void testPoolNetwork()
+{
+  const char *test = "pool network";
+  setArena(5, 12, 5);
+  int ids[] = { 1, 63, 64, BLOCKPOOL_MAX_BLOCKS - 1, BLOCKPOOL_MAX_BLOCKS, BLOCKPOOL_MAX_BLOCKS + 1, (1 << (6 * BLOCK_ID_CHARS)) - 1 };
+  int n = sizeof(ids) / sizeof(ids[0]);
+
+  // the peer has the blocks in the other order, after some that have gone
+  BlockPool pool, peer;
+  BlockHandle handles[sizeof(ids) / sizeof(ids[0])];
+  for (int i = 0; i < n; i++) handles[i] = makeCube(pool, ids[i]);
+  for (int i = 0; i < 3; i++) peer.destroy(makeCube(peer, 1000 + i));
+  for (int i = n - 1; i >= 0; i--) makeCube(peer, ids[i]);
+
+  for (int i = 0; i < n; i++) {
+    string s = pool.toNetwork(handles[i]);
+    bool printable = (int) s.size() == BLOCK_ID_CHARS;
+    for (int j = 0; j < (int) s.size(); j++) if (s[j] < '0' || s[j] >= '0' + 64) printable = false;
+    check(printable, test, "id not written as base 64 digits");
+    check(pool.fromNetwork(s.c_str()) == handles[i], test, "id doesn't come back to the same handle");
+    Block *b = peer.get(peer.fromNetwork(s.c_str()));
+    check(b != NULL && b->getId() == ids[i], test, "peer doesn't find the block with the id");
+  }
+
+  // a block that has gone is sent as no block
+  pool.destroy(handles[0]);
+  check(pool.fromNetwork(pool.toNetwork(handles[0]).c_str()) == NO_BLOCK
+    && peer.fromNetwork(pool.toNetwork(handles[0]).c_str()) == NO_BLOCK, test, "gone block found");
+}
+
+// the game as a snapshot keeps it for the snapshot test (as GameState in
+// cve.cc)
+struct CoreState {
+  BlockPool blocks;
+  CollisionGrid grid;
+  Scheduler scheduler;
+  int blockId;
+};
+
+Scheduler scheduler;
+int gravityRuns = 0, layersCleared = 0, blocksSettled = 0;
+int poseHashMisses = 0; // ticks the kept pose hash was wrong
+
+// Work out the falling blocks' pose hash from the blocks, as kept by the
+// grid (see Block::hashPose)
+unsigned long long poseHashFromBlocks()
+{
+  unsigned long long h = 0;
+  for (int i = 0; i < blocks.getActiveSize(); i++) {
+    Block &b = blocks.getActive(i);
+    if (b.getGrounded()) continue;
+    h ^= CollisionGrid::poseKey(b.getId(), b.getOrientation(), (int) roundf(b.getX() / 5.0),
+      (int) roundf(b.getY() / 5.0), (int) roundf(b.getZ() / 5.0));
+  }
+  return h;
+}
+
+// Gravity on a timer, as the game does it
+//   value - not used
+void gravityTimer(int value)
+{
+  gravityRuns++;
+  Rules::gravity(blocks, false);
+  scheduler.after(100, gravityTimer, value);
+}
+
+// A tick of the game: move the blocks, then take out full layers and settle
+// what's left
+//   tick - the scheduler's tick
+void gameTick(int tick)
+{
+  Block::setClock(tick);
+  Rules::moveBlocks(blocks, collisionGrid, boundaries);
+  if (collisionGrid.getPoseHash() != poseHashFromBlocks()) poseHashMisses++;
+  LayerSet complete = collisionGrid.takeNewlyComplete();
+  if (complete.any()) {
+    Rules::removeLayers(blocks, complete, collisionGrid, boundaries, blockId);
+    layersCleared += complete.count();
+    blocksSettled += Rules::settle(blocks, collisionGrid, boundaries);
+  }
+}
+
+// Run the game for a while
+//   ms - how long
+void runFor(int ms)
+{
+  static int now = 0;
+  for (int t = 0; t < ms; t += SIM_TICK_MS) scheduler.advance(now += SIM_TICK_MS, gameTick);
+}
+
+// Going back to a snapshot after blocks have moved, landed, filled a layer
+// and settled brings back the same game: the same hash, cells, blocks and
+// timers, so playing on from there does the same again
+void testSnapshotRestore()
+{
+  const char *test = "snapshot restore";
+  setArena(3, 10, 1);
+  scheduler = Scheduler();
+  Block::setClock(0); // the scheduler's ticks from here
+  layersCleared = 0, blocksSettled = 0, poseHashMisses = 0;
+
+  // two thirds of the bottom layer, a cube on top, and one falling
+  dropBlock(0, 0);
+  dropBlock(0, 1);
+  dropBlock(0, 0);
+  BlockHandle falling = blocks.create(blockId++, 0, boundaries[0] + 5.0, blockStartY, boundaries[2], true, collisionGrid, boundaries);
+  scheduler.after(100, gravityTimer, 0);
+  runFor(150);
+  for (int i = 0; i < CORETEST_MAX_TICKS && blocks.get(falling)->getMoving(); i++) runFor(SIM_TICK_MS);
+
+  SnapshotRing <CoreState, 4> ring;
+  SnapshotHandle h;
+  CoreState &saved = ring.take(h);
+  saved.blocks = blocks, saved.grid = collisionGrid, saved.scheduler = scheduler, saved.blockId = blockId;
+  unsigned long long before = Rules::hash(collisionGrid);
+  long long tick = scheduler.getTick();
+  float fallingY = blocks.get(falling)->getY();
+  int blockCount = blocks.size();
+
+  // move the falling cube over the gap (between falls, as a player would)
+  // and let it land, filling the layer
+  Block *block = blocks.get(falling);
+  block->setTargetPosition(block->getX() + 5.0, block->getY(), block->getZ());
+  blocks.unGround(falling);
+  runFor(5000);
+  check(layersCleared == 1 && blocksSettled > 0, test, "layer not cleared and settled");
+  unsigned long long after = Rules::hash(collisionGrid);
+  check(after != before, test, "game didn't change");
+
+  const CoreState *s = ring.get(h);
+  check(s != NULL, test, "snapshot lost");
+  if (s == NULL) return;
+  blocks = s->blocks, collisionGrid = s->grid, blockId = s->blockId;
+  scheduler.restore(s->scheduler);
+  Block::setClock((int) scheduler.getTick()); // as restoreSnapshot in cve.cc
+
+  check(Rules::hash(collisionGrid) == before, test, "hash not the same as before");
+  check(scheduler.getTick() == tick && blocks.size() == blockCount, test, "ticks or blocks not brought back");
+  check(collisionGrid.getLayerCount(0) == 2 && collisionGrid.getLayerCount(1) == 1, test, "layers not brought back");
+  block = blocks.get(falling);
+  check(block != NULL && block->getY() == fallingY && block->getX() == boundaries[0] + 5.0, test, "falling block not brought back");
+  if (block == NULL) return;
+
+  // the gravity timer was saved too, so the same again ends the same way
+  int runs = gravityRuns;
+  block->setTargetPosition(block->getX() + 5.0, block->getY(), block->getZ());
+  blocks.unGround(falling);
+  runFor(5000);
+  check(gravityRuns > runs, test, "timers not brought back");
+  check(layersCleared == 2 && Rules::hash(collisionGrid) == after, test, "didn't play on the same way");
+  check(poseHashMisses == 0, test, "kept pose hash differs from the falling blocks");
+}
+
+// Trig is within the error its header gives of <cmath>, worked out in
+// double: 2e-7 for sine and cosine up to 1e4 degrees either way, 2e-5
+// degrees for arcsine, and the batch forms give the same as the single
+
+void testTrig()
+{
+  const char *test = "trig";
+  const double degToRad = M_PI / 180;
+
+  float degrees[CORETEST_TRIG_BATCH], s[CORETEST_TRIG_BATCH], c[CORETEST_TRIG_BATCH];
+  double worstSin = 0, worstCos = 0;
+  bool same = true;
+  for (int start = -10000000; start < 10000000; start += CORETEST_TRIG_BATCH) {
+    // thousandths of a degree, so the quarter turns and halfway between are hit exactly
+    for (int i = 0; i < CORETEST_TRIG_BATCH; i++) degrees[i] = (start + i) * 0.001f;
+    Trig::sinCos(degrees, s, c, CORETEST_TRIG_BATCH);
+    for (int i = 0; i < CORETEST_TRIG_BATCH; i++) {
+      worstSin = max(worstSin, fabs(s[i] - sin(degrees[i] * degToRad)));
+      worstCos = max(worstCos, fabs(c[i] - cos(degrees[i] * degToRad)));
+      if (i % 97 == 0 && (Trig::sn(degrees[i]) != s[i] || Trig::cs(degrees[i]) != c[i])) same = false;
+    }
+  }
+  check(worstSin < 2e-7, test, "sine out by more than 2e-7");
+  check(worstCos < 2e-7, test, "cosine out by more than 2e-7");
+  check(same, test, "sinCos not the same as sn and cs");
+
+  float n[CORETEST_TRIG_BATCH], a[CORETEST_TRIG_BATCH];
+  double worstAsin = 0;
+  same = true;
+  for (int start = -1000000; start <= 1000000; start += CORETEST_TRIG_BATCH) {
+    for (int i = 0; i < CORETEST_TRIG_BATCH; i++) n[i] = min(start + i, 1000000) * 1e-6f;
+    Trig::asin(n, a, CORETEST_TRIG_BATCH);
+    for (int i = 0; i < CORETEST_TRIG_BATCH; i++) {
+      worstAsin = max(worstAsin, fabs(a[i] - asin((double) n[i]) / degToRad));
+      if (i % 97 == 0 && Trig::asn(n[i]) != a[i]) same = false;
+    }
+  }
+  check(worstAsin < 2e-5, test, "arcsine out by more than 2e-5 degrees");
+  check(same, test, "asin not the same as asn");
+  check(Trig::asn(1.5f) == Trig::asn(1.0f) && Trig::asn(-1.5f) == Trig::asn(-1.0f), test, "arcsine not clamped");
+
+  if (worstSin >= 2e-7 || worstCos >= 2e-7 || worstAsin >= 2e-5)
+    cerr << test << ": worst sine " << worstSin << ", cosine " << worstCos << ", arcsine " << worstAsin << endl;
+}
+
+// Messages of each policy around the outgoing queue's marks: past
+// OUTQUEUE_HIGH_WATER MERGE_OR_DROP ones are dropped while KEEP and MERGE
+// ones still go in, and nothing but a same size MERGE gets past
+// OUTQUEUE_MAX_BYTES
+void testOutQueueWater()
+{
+  const char *test = "out queue water";
+  string k(1024, 'k');
+
+  OutQueue q;
+  bool queued = q.push(k.data(), 1024, OUTQUEUE_MERGE, "p");
+  while (queued && q.size() < OUTQUEUE_HIGH_WATER) queued = q.push(k.data(), 1024, OUTQUEUE_KEEP, "");
+  check(queued && q.size() == OUTQUEUE_HIGH_WATER, test, "didn't queue up to the high water mark");
+  check(!q.isCongested(), test, "congested at the high water mark, not past it");
+
+  check(q.push("dd", 2, OUTQUEUE_MERGE_OR_DROP, "d") && q.size() == OUTQUEUE_HIGH_WATER + 2, test, "MERGE_OR_DROP dropped before congested");
+  check(q.isCongested(), test, "not congested past the high water mark");
+  check(q.push("ddd", 3, OUTQUEUE_MERGE_OR_DROP, "d") && q.size() == OUTQUEUE_HIGH_WATER + 2, test, "MERGE_OR_DROP queued while congested");
+  check(q.push("eee", 3, OUTQUEUE_MERGE_OR_DROP, "e") && q.size() == OUTQUEUE_HIGH_WATER + 2, test, "new MERGE_OR_DROP queued while congested");
+  check(q.push("m", 1, OUTQUEUE_MERGE, "m") && q.size() == OUTQUEUE_HIGH_WATER + 3, test, "MERGE not queued while congested");
+  check(q.push("mm", 2, OUTQUEUE_MERGE, "m") && q.size() == OUTQUEUE_HIGH_WATER + 4, test, "MERGE didn't replace the one waiting");
+
+  queued = true;
+  while (queued && q.size() + 1024 <= OUTQUEUE_MAX_BYTES) queued = q.push(k.data(), 1024, OUTQUEUE_KEEP, "");
+  queued = queued && q.push(k.data(), OUTQUEUE_MAX_BYTES - q.size(), OUTQUEUE_KEEP, "");
+  check(queued && q.size() == OUTQUEUE_MAX_BYTES, test, "KEEP not queued up to the limit");
+  check(!q.push("k", 1, OUTQUEUE_KEEP, "") && q.size() == OUTQUEUE_MAX_BYTES, test, "KEEP queued past the limit");
+  check(!q.push("n", 1, OUTQUEUE_MERGE, "n") && q.size() == OUTQUEUE_MAX_BYTES, test, "new MERGE queued past the limit");
+  check(q.push(k.data(), 1024, OUTQUEUE_MERGE, "p") && q.size() == OUTQUEUE_MAX_BYTES, test, "same size MERGE not queued at the limit");
+  check(!q.push(k.data(), 1025, OUTQUEUE_MERGE, "p") && q.size() == OUTQUEUE_MAX_BYTES, test, "bigger MERGE queued past the limit");
+}
+
+// Read what's waiting on a socket
+//   sock - a non-blocking socket
+//   got - what's read is added
+//   most - the most to read
+void readSome(int sock, string &got, int most)
+{
+  char buffer[4096];
+  while (most > 0) {
+    int n = read(sock, buffer, most < (int) sizeof buffer ? most : sizeof buffer);
+    if (n <= 0) return;
+    got.append(buffer, n);
+    most -= n;
+  }
+}
+
+// A congested outgoing queue stays so as it drains, a bit at a time into
+// a full socket, until it's down to OUTQUEUE_LOW_WATER; what comes out is
+// the KEEP messages in order, with only the last of the merged ones, where
+// it was last queued
+void testOutQueueDrain()
+{
+  const char *test = "out queue drain";
+  int sock[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) == -1) {
+    check(false, test, "no socket pair");
+    return;
+  }
+  fcntl(sock[0], F_SETFL, O_NONBLOCK);
+  fcntl(sock[1], F_SETFL, O_NONBLOCK);
+
+  // fill the socket, so the queue can only go as it's read
+  string junk(1024, 'j');
+  int junkBytes = 0, n;
+  while ((n = write(sock[0], junk.data(), junk.size())) > 0) junkBytes += n;
+
+  OutQueue q;
+  string expected;
+  for (int i = 0; q.size() <= OUTQUEUE_HIGH_WATER + 1024; i++) {
+    string m(100, 'A' + i % 26);
+    if (i % 50 == 10) {
+      m[0] = '0' + i / 50;
+      q.push(m.data(), m.size(), OUTQUEUE_MERGE, "position");
+    }
+    else {
+      q.push(m.data(), m.size(), OUTQUEUE_KEEP, "");
+      expected += m;
+    }
+  }
+  string last(100, 'z');
+  q.push(last.data(), last.size(), OUTQUEUE_MERGE, "position");
+  expected += last;
+
+  check(q.send(sock[0]) == -1 && errno == EAGAIN, test, "full socket took everything");
+  check(q.isCongested(), test, "not congested past the high water mark");
+
+  string got;
+  bool sawBetween = false, marks = true;
+  for (int i = 0; i < CORETEST_MAX_TICKS && q.size() > 0; i++) {
+    readSome(sock[1], got, 512);
+    q.send(sock[0]);
+    if (q.size() > OUTQUEUE_LOW_WATER && q.size() <= OUTQUEUE_HIGH_WATER) sawBetween = true;
+    if (q.isCongested() != (q.size() > OUTQUEUE_LOW_WATER)) marks = false;
+  }
+  readSome(sock[1], got, junkBytes + (int) expected.size() + 1);
+  close(sock[0]);
+  close(sock[1]);
+
+  check(q.size() == 0, test, "didn't drain");
+  check(sawBetween, test, "never stopped between the marks");
+  check(marks, test, "congestion didn't end at the low water mark");
+  check((int) got.size() == junkBytes + (int) expected.size() && got.compare(junkBytes, string::npos, expected) == 0,
+    test, "wrong messages sent");
+}
+
+// Give a FrameReader characters as recv() would
+//   reader - the reader
+//   data - the characters
+//   chunk - the most to give it at once
+//   frames - the frames that are complete are added
+//   wrapped - set if any came in two pieces
+//
+// Returns:
+//   false if the two ways of reading a frame disagreed
+bool feed(FrameReader &reader, const string &data, int chunk, vector <string> &frames, bool &wrapped)
+{
+  bool same = true;
+  for (int at = 0; at < (int) data.size(); ) {
+    char *p;
+    int n = reader.space(p);
+    if (n > chunk) n = chunk;
+    if (n > (int) data.size() - at) n = data.size() - at;
+    if (n == 0) return false;
+    memcpy(p, data.data() + at, n);
+    reader.wrote(n);
+    at += n;
+
+    FrameView frame;
+    while (reader.next(frame)) {
+      string s(frame.size(), ' ');
+      frame.copyTo(&s[0]);
+      for (int i = 0; i < frame.size(); i++)
+        if (frame[i] != s[i]) same = false;
+      if (frame.length[1] > 0) wrapped = true;
+      frames.push_back(s);
+    }
+  }
+  return same;
+}
+
+// Frames come out whole whatever they're split by: two reads, the end of
+// the ring, or both, with what's outside STX and ETX skipped
+void testFrameReader()
+{
+  const char *test = "frame reader";
+  FrameReader reader;
+  vector <string> frames;
+  bool wrapped = false;
+
+  string first = "\2hel", second = "lo\3";
+  check(feed(reader, first, 100, frames, wrapped) && frames.size() == 0, test, "half a frame came out");
+  check(feed(reader, second, 100, frames, wrapped) && frames.size() == 1 && frames[0] == "hello",
+    test, "frame split across two reads");
+
+  string noisy = "xx\2a\3yy\2\3\2b\3";
+  frames.clear();
+  check(feed(reader, noisy, 100, frames, wrapped) && frames.size() == 3
+    && frames[0] == "a" && frames[1] == "" && frames[2] == "b", test, "noise between frames not skipped");
+  check(!wrapped, test, "wrapped before the end of the ring");
+
+  // to 6 before the end of the ring, then a frame over the end
+  int used = first.size() + second.size() + noisy.size();
+  string almost = "\2" + string(FRAMEREADER_SIZE - 6 - used - 2, 'x') + "\3";
+  frames.clear();
+  feed(reader, almost, FRAMEREADER_SIZE, frames, wrapped);
+  check(frames.size() == 1 && frames[0].size() == almost.size() - 2 && !wrapped, test, "long frame");
+
+  frames.clear();
+  check(feed(reader, "\2" "0123456789\3", 100, frames, wrapped) && frames.size() == 1 && frames[0] == "0123456789",
+    test, "frame across the end of the ring");
+  check(wrapped, test, "frame across the end of the ring not in two pieces");
+
+  // the same, a few characters at a time
+  FrameReader again;
+  frames.clear();
+  wrapped = false;
+  feed(again, "\2" + string(FRAMEREADER_SIZE - 8, 'x') + "\3", FRAMEREADER_SIZE, frames, wrapped);
+  frames.clear();
+  check(feed(again, "\2" "0123456789\3\2after\3", 3, frames, wrapped) && frames.size() == 2
+    && frames[0] == "0123456789" && frames[1] == "after", test, "frame across the end of the ring and several reads");
+  check(wrapped, test, "frame across the end of the ring and several reads not in two pieces");
+}
+
+// what the timer wheel tests saw: when each value's timer ran
+vector <long long> timerRan;
+long long wheelNow;
+
+// Note when a timer ran
+//   value - which timer
+void recordTimer(int value)
+{
+  timerRan[value] = wheelNow;
+}
+
+// Run a timer wheel on, a millisecond at a time or as its timeout says
+//   wheel - the wheel
+//   until - the time to stop
+//   step - whether to go a millisecond at a time
+//
+// Returns:
+//   false if timeout() ever said to wait for nothing
+bool runWheel(TimerWheel &wheel, long long until, bool step)
+{
+  bool waited = true;
+  while (wheelNow < until) {
+    long long wait = wheel.timeout(wheelNow);
+    if (wait == 0) waited = false;
+    if (step || wait < 0 || wheelNow + wait > until) wait = 1;
+    wheelNow += wait;
+    wheel.advance(wheelNow);
+  }
+  return waited;
+}
+
+// Timers run in the millisecond they're due, either side of where each level
+// of the wheel takes over and on the slot boundaries, whether the wheel is
+// run on every millisecond or only when timeout() says
+void testTimerWheelLevels()
+{
+  const char *test = "timer wheel levels";
+  const long long delays[] = { 1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+    16777215, 16777216, 16777217, 20000000 };
+  const int numDelays = sizeof delays / sizeof delays[0];
+  // a start on a boundary of every level, and one on none
+  const long long starts[] = { 0, 1000003 };
+
+  for (int s = 0; s < 2; s++) {
+    for (int step = 0; step < 2; step++) {
+      TimerWheel wheel(starts[s]);
+      wheelNow = starts[s];
+      timerRan.assign(numDelays + TIMERWHEEL_LEVELS, -1);
+      vector <long long> due(numDelays + TIMERWHEEL_LEVELS);
+      for (int i = 0; i < numDelays; i++) {
+        due[i] = starts[s] + delays[i];
+        wheel.after(delays[i], recordTimer, i);
+      }
+      // and one on the next boundary of each level
+      for (int level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        long long unit = 1LL << (level * TIMERWHEEL_SLOT_BITS);
+        due[numDelays + level] = (starts[s] / unit + 1) * unit;
+        wheel.after(due[numDelays + level] - starts[s], recordTimer, numDelays + level);
+      }
+      check(wheel.size() == numDelays + TIMERWHEEL_LEVELS, test, "timers not all waiting");
+
+      // a millisecond at a time past the third level, then as timeout() says
+      bool waited = runWheel(wheel, starts[s] + (step ? 300000 : 0), true);
+      waited = runWheel(wheel, starts[s] + 20000001, false) && waited;
+
+      bool onTime = true;
+      for (int i = 0; i < (int) due.size(); i++)
+        if (timerRan[i] != due[i]) onTime = false;
+      check(onTime, test, step ? "a timer didn't run on time, stepping" : "a timer didn't run on time, waiting");
+      check(waited, test, "timeout() said something was due that wasn't run");
+      check(wheel.size() == 0 && wheel.timeout(wheelNow) == -1, test, "timers left over");
+    }
+  }
+}
+
+// A timer cancelled after it has been moved down to a lower level, or to
+// the bottom one, doesn't run, and the ones due with it still do
+void testTimerWheelCancel()
+{
+  const char *test = "timer wheel cancel";
+  TimerWheel wheel(0);
+  wheelNow = 0;
+  timerRan.assign(5, -1);
+
+  // 5000 ms is on level 2, moved to level 1 at 4096 and to level 0 at 4992
+  int first = wheel.after(5000, recordTimer, 0);
+  int second = wheel.after(5000, recordTimer, 1);
+  wheel.after(5000, recordTimer, 2);
+  int soon = wheel.after(10, recordTimer, 3);
+
+  runWheel(wheel, 4100, true);
+  check(timerRan[3] == 10 && !wheel.cancel(soon), test, "cancelled a timer that had run");
+  check(wheel.cancel(first) && wheel.size() == 2, test, "couldn't cancel a timer moved down to level 1");
+  check(!wheel.cancel(first), test, "cancelled the same timer twice");
+
+  runWheel(wheel, 4995, true);
+  check(wheel.cancel(second) && wheel.size() == 1, test, "couldn't cancel a timer moved down to level 0");
+
+  runWheel(wheel, 6000, true);
+  check(timerRan[0] == -1 && timerRan[1] == -1, test, "a cancelled timer ran");
+  check(timerRan[2] == 5000, test, "a timer due with cancelled ones didn't run");
+  check(wheel.size() == 0 && wheel.timeout(wheelNow) == -1, test, "timers left over");
+
+  // nothing is waited for on a cancelled timer's account: the one left is
+  // on level 1, so the wait is until its slot comes round
+  int lone = wheel.after(1000, recordTimer, 4);
+  wheel.after(3000, recordTimer, 3);
+  long long slotStart = (wheelNow + 3000) >> TIMERWHEEL_SLOT_BITS << TIMERWHEEL_SLOT_BITS;
+  check(wheel.cancel(lone) && wheel.timeout(wheelNow) == slotStart - wheelNow, test, "waited for a cancelled timer");
+  runWheel(wheel, 10000, false);
+  check(timerRan[4] == -1 && timerRan[3] == 9000, test, "wrong timer ran after a cancel");
+}
+
+int main(int argc, char **argv)
+{
+  testLongMove();
+  testQuarterTurns();
+  testSettleOverhang();
+  testGridChunks();
+  testGridLayers();
+  testGridCopy();
+  testGridHash();
+  testPoolStaleHandle();
+  testPoolGenerations();
+  testPoolNetwork();
+  testSnapshotRestore();
+  testTrig();
+  testOutQueueWater();
+  testOutQueueDrain();
+  testFrameReader();
+  testTimerWheelLevels();
+  testTimerWheelCancel();
+
+  if (failures > 0) {
+    cerr << failures << " checks failed" << endl;
+    return 1;
+  }
+  cout << "All checks passed" << endl;
+  return 0;
+}
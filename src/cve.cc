@@ -43,14 +43,19 @@
 #include <deque>
 #include <string>
 #include <cstring>
+#include <cstdio>
 #include "pawn.h"
 #include "trig.h"
 #include "client.h"
 #include "human.h"
 #include "texture.h"
 #include "block.h"
+#include "blockpool.h"
+#include "scheduler.h"
+#include "snapshot.h"
 #include "explosion.h"
 #include "game.h"
+#include "rules.h"
 
 using namespace std;
 
@@ -135,6 +140,10 @@ float rightFrustumBorder, topFrustumBorder;
 #define GRAVITY_COUNT_DECREASE 8
 // only for slow game
 
+// the fixed timestep simulation, which runs the gameplay timers below
+Scheduler scheduler;
+void tick(int);
+
 // set up properties for gravity
 int gravityTimer = GRAVITY_COUNT_START; // for moving down blocks
 bool stopGravity = false;
@@ -145,29 +154,21 @@ int blockId = 1, newBlockTimer = NEW_BLOCK_COUNT_START; // for making new blocks
 bool cancelBlock = false;
 void newBlock(int);
 
-// how often do we call the idle function?
+// how often do we call the idle function (to run the simulation ticks
+// that are due and redraw)?
 // how often do we redraw the screen?
 #define TIMER_IDLE 5
 #define TIMER_REDISPLAY 5
 void idle(int);
 void postRedisplay(int);
 
-// define the boundaries for the game area
-#define BOUNDARY_MIN_X -10.0
-#define BOUNDARY_MAX_X 10.0
-#define BOUNDARY_MIN_Z -10.0
-#define BOUNDARY_MAX_Z 10.0
-
-// define the starting height of the blocks
-#define BLOCK_START_Y 50.0
-
-// how many blocks can fit into the game?
-#define GAMEBLOCK_WIDTH ((int) (BOUNDARY_MAX_X - BOUNDARY_MIN_X) / 5 + 1)
-#define GAMEBLOCK_DEPTH ((int) (BOUNDARY_MAX_Z - BOUNDARY_MIN_Z) / 5 + 1)
-#define GAMEBLOCK_HEIGHT ((int) BLOCK_START_Y / 5 + 1)
+// the boundaries of the classic game area and the starting height of the
+// blocks are defined in grid.h; a different size can be chosen with -a
+// (see setArena)
 
 // store the boundaries in an array
 float boundaries[] = {BOUNDARY_MIN_X, BOUNDARY_MAX_X, BOUNDARY_MIN_Z, BOUNDARY_MAX_Z};
+float blockStartY = BLOCK_START_Y;
 
 // set up light 0 attributes
 //GLfloat lightCoords0[] = { 5.0, 44.0, 6.0, 0 };
@@ -206,14 +207,13 @@ int humanFace = 6; // texture of human
 // specify the camera height in first person view (i.e. height of player)
 float cameraHeight = 0.0;
 
-// a vector to store the blocks in the game
-vector <Block> blocks;
-int selectedBlock = -1; // id of block selected
+// a pool to store the blocks in the game
+BlockPool blocks;
+BlockHandle selectedBlock = NO_BLOCK; // handle of block selected
 int selectedX = 0, selectedY = 0;
 
-// the collision array
-//vector <vector <vector <int> > > collisionArray;
-int collisionArray[GAMEBLOCK_WIDTH][GAMEBLOCK_HEIGHT+1][GAMEBLOCK_DEPTH];
+// the collision grid
+CollisionGrid collisionGrid;
 
 // explosions occur when a layer is completed
 deque <Explosion> explosions;
@@ -272,11 +272,27 @@ vector <int> fpsStore; // store FPS values
 int score = 0, scoreCount = 0; // score count is used to allow for multiple completed layers
 int blockScore = 0; // points for blocks in game area
 
-// for trig operations that don't need to be too accurate
-// they can just be looked up from an array
-float Trig::cosValues[721];
-float Trig::sinValues[721];
-float Trig::asinValues[121];
+// the game as saved in a snapshot: everything the simulation needs to carry
+// on from where it was (see snapshot.h)
+struct GameState {
+  BlockPool blocks;
+  BlockHandle selectedBlock;
+  CollisionGrid grid;
+  Scheduler scheduler; // ticks and timers
+  int gravityTimer, blockId, newBlockTimer;
+  bool stopGravity, cancelBlock, gameOver;
+  vector <int> sentFoundLayer, receivedRemoveLayer;
+  int score, scoreCount, blockScore, numberOfLayers;
+};
+
+// recent game states, taken as new blocks appear, for rewinding a
+// standalone game. A snapshot copies every block, so they're taken no more
+// than once every SNAPSHOT_MIN_TICKS, however fast blocks come.
+#define SNAPSHOT_RING_SIZE 32
+#define SNAPSHOT_MIN_TICKS (2000 / SIM_TICK_MS)
+SnapshotRing <GameState, SNAPSHOT_RING_SIZE> snapshots;
+int rewindAge = 0; // how many snapshots back the next rewind goes
+long long snapshotTick = 0; // scheduler tick of the last snapshot taken or restored
 
 // the texture numbers and filenames
 vector <int> Texture::texId;
@@ -572,7 +588,7 @@ void makeShadowBlocks()
       for (int k = 0; k < 3; k++)
         shadowBlock[i].pFaces[j].neighbourIndices[k] = -1;
     }
-    Block b(0, i, 0, 0, 0, true, collisionArray, boundaries);
+    Block b(0, i, 0, 0, 0, true, collisionGrid, boundaries);
     face = 0;
     vertex = 0;
 
@@ -995,29 +1011,82 @@ void KillGLObjects()
 
 
 // Continually sets when the data is ready to send
-//   value - the value required by glutTimerFunc()
+//   value - the value required by Scheduler::after()
 //           expected to be always 1 (true - ready to send)
 void setReadyToSend(int value)
 {
   client.setReadyToSend(value);
 
-  glutTimerFunc(100, setReadyToSend, 1);
+  scheduler.after(100, setReadyToSend, 1);
 }
 
-// Clears and resets the three-dimensional collision array (vector)
+// Clears and resets the collision grid
 void clearCollisionArray()
 {
-  for (int i = 0; i < GAMEBLOCK_WIDTH; i++)
-    for (int j = 0; j < GAMEBLOCK_HEIGHT; j++)
-      for (int k = 0; k < GAMEBLOCK_DEPTH; k++)
-        collisionArray[i][j][k] = 0;
-  /*collisionArray.clear();
-  vector <int> temp;
-  vector <vector <int> > temp2;
-  for (int i = 0; i < GAMEBLOCK_DEPTH; i++) temp.push_back(0);
-  for (int i = 0; i < GAMEBLOCK_HEIGHT + 1; i++) temp2.push_back(temp); // + 1 because blocks stick up above height
-  for (int i = 0; i < GAMEBLOCK_WIDTH; i++) collisionArray.push_back(temp2);
-  */
+  collisionGrid.clear();
+}
+
+// Save the game in a new snapshot
+//
+// Returns:
+//   the snapshot's handle
+SnapshotHandle takeSnapshot()
+{
+  SnapshotHandle h;
+  GameState &s = snapshots.take(h);
+
+  s.blocks = blocks;
+  s.selectedBlock = selectedBlock;
+  s.grid = collisionGrid;
+  s.scheduler = scheduler;
+  s.gravityTimer = gravityTimer, s.blockId = blockId, s.newBlockTimer = newBlockTimer;
+  s.stopGravity = stopGravity, s.cancelBlock = cancelBlock, s.gameOver = gameOver;
+  s.sentFoundLayer = sentFoundLayer, s.receivedRemoveLayer = receivedRemoveLayer;
+  s.score = score, s.scoreCount = scoreCount, s.blockScore = blockScore, s.numberOfLayers = numberOfLayers;
+
+  rewindAge = 0;
+  snapshotTick = scheduler.getTick();
+  return h;
+}
+
+// Put the game back as it was in a snapshot
+//   h - the snapshot's handle
+//
+// Returns:
+//   false if there is no such snapshot (it may have been overwritten)
+bool restoreSnapshot(SnapshotHandle h)
+{
+  const GameState *s = snapshots.get(h);
+  if (s == NULL) return false;
+
+  blocks = s->blocks;
+  selectedBlock = s->selectedBlock;
+  collisionGrid = s->grid;
+  scheduler.restore(s->scheduler);
+  // moves and turns started before the next tick go from the restored time
+  Block::setClock((int) scheduler.getTick());
+  gravityTimer = s->gravityTimer, blockId = s->blockId, newBlockTimer = s->newBlockTimer;
+  stopGravity = s->stopGravity, cancelBlock = s->cancelBlock, gameOver = s->gameOver;
+  sentFoundLayer = s->sentFoundLayer, receivedRemoveLayer = s->receivedRemoveLayer;
+  score = s->score, scoreCount = s->scoreCount, blockScore = s->blockScore, numberOfLayers = s->numberOfLayers;
+  snapshotTick = scheduler.getTick();
+
+  // nothing to draw the blocks moving from
+  for (int i = 0; i < (int) blocks.size(); i++) blocks[i].storeLast();
+  return true;
+}
+
+// Set the size of the game area, centred on the origin, before the game
+// starts. Arenas other than the classic one are stored in chunks (see
+// grid.h).
+//   width,height,depth - the size in cells
+void setArena(int width, int height, int depth)
+{
+  boundaries[0] = -5.0 * (width / 2), boundaries[1] = boundaries[0] + 5.0 * (width - 1);
+  boundaries[2] = -5.0 * (depth / 2), boundaries[3] = boundaries[2] + 5.0 * (depth - 1);
+  // blocks start two layers from the top, as in the classic arena
+  blockStartY = 5.0 * (height - 2);
+  collisionGrid.resize(width, height, depth);
 }
 
 // Initialisation function - called once to set up program
@@ -1087,7 +1156,6 @@ void init()
 
   glMatrixMode (GL_MODELVIEW);
 
-  Trig::init();
   Texture::init();
   Texture::loadTextures();
 
@@ -1111,13 +1179,13 @@ void init()
     message += "These are recommended, but ";
     message += "you can also move\nusing the arrow keys.\n\n(Press Return for next level)";
     trainTimebase = glutGet(GLUT_ELAPSED_TIME);
-    blocks.push_back(Block(blockId++, 5, -5, 30, 0, true, collisionArray, boundaries));
+    blocks.create(blockId++, 5, -5, 30, 0, true, collisionGrid, boundaries);
     // note blockId is not reset when training is complete
   }
 
   // for network start gravity based on server call instead to help synchronise gravity
   if (!network && !training) {
-    glutTimerFunc(gravityTimer, gravity, 0);
+    scheduler.after(gravityTimer, gravity, 0);
     // make a new block
     newBlock(rand()%8); // this function starts the timer for itself
   }
@@ -1222,7 +1290,7 @@ void drawSkybox()
   glDisable(GL_LIGHTING);
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glTranslatef(player.getX(), player.getY(), player.getZ());
+  glTranslatef(player.getDrawX(), player.getDrawY(), player.getDrawZ());
 
   glBindTexture(GL_TEXTURE_2D, Texture::texId[7]);
   glColor3f(0.6, 0.5, 0.0); 
@@ -1311,16 +1379,49 @@ void drawSkybox()
 // Draw the game blocks
 void drawBlocks()
 {
-  for (int i = 0; i < (int) blocks.size(); i++) {
-    if (i != selectedBlock) { // draw selected block on top
-      glLoadName(i);
+  // blocks are named by handle, for picking
+  for (int i = 0; i < blocks.size(); i++) {
+    if (blocks.handle(i) != selectedBlock) { // draw selected block on top
+      glLoadName(blocks.handle(i));
       blocks[i].draw(Texture::texId, false);
     }
   }
-  if (selectedBlock > -1) { // this way arrows appear on top
+  Block *selected = blocks.get(selectedBlock);
+  if (selected != NULL) { // this way arrows appear on top
     glLoadName(selectedBlock);
-    blocks[selectedBlock].draw(Texture::texId, true);
+    selected->draw(Texture::texId, true);
+  }
+}
+
+// Draw a ghost of the selected block where it would land if dropped
+void drawGhost()
+{
+  Block *selected = blocks.get(selectedBlock);
+  if (selected == NULL || selected->getTurning()) return;
+
+  // the same query as Block::drop, so the ghost is where the block goes
+  int distance = selected->dropDistance(collisionGrid, boundaries, false);
+  if (distance == 0) return;
+
+  Cell cells[BLOCK_MAX_CUBES];
+  int n = selected->getCells(cells, collisionGrid, boundaries);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDepthMask(GL_FALSE);
+  glDisable(GL_TEXTURE_2D);
+
+  glColor4f(1.0, 1.0, 1.0, 0.25);
+  for (int i = 0; i < n; i++) {
+    glPushMatrix();
+    glTranslatef(boundaries[0] + cells[i].x * 5, (cells[i].y - distance) * 5, boundaries[2] + cells[i].z * 5);
+    glutSolidCube(5.0);
+    glPopMatrix();
   }
+
+  glEnable(GL_TEXTURE_2D);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
 }
 
 // Draw the game boundaries
@@ -1336,26 +1437,26 @@ void drawBoundaries()
   glNormal3f(0.0, 0.0, -1.0);
   glVertex3f(boundaries[0]-2.5, -2.5, boundaries[2]-2.5);
   glVertex3f(boundaries[1]+2.5, -2.5, boundaries[2]-2.5);
-  glVertex3f(boundaries[1]+2.5, BLOCK_START_Y + 2.5, boundaries[2]-2.5);
-  glVertex3f(boundaries[0]-2.5, BLOCK_START_Y + 2.5, boundaries[2]-2.5);
+  glVertex3f(boundaries[1]+2.5, blockStartY + 2.5, boundaries[2]-2.5);
+  glVertex3f(boundaries[0]-2.5, blockStartY + 2.5, boundaries[2]-2.5);
 
   glNormal3f(0.0, 0.0, 1.0);
   glVertex3f(boundaries[0]-2.5, -2.5, boundaries[3]+2.5);
-  glVertex3f(boundaries[0]-2.5, BLOCK_START_Y + 2.5, boundaries[3]+2.5);
-  glVertex3f(boundaries[1]+2.5, BLOCK_START_Y + 2.5, boundaries[3]+2.5);
+  glVertex3f(boundaries[0]-2.5, blockStartY + 2.5, boundaries[3]+2.5);
+  glVertex3f(boundaries[1]+2.5, blockStartY + 2.5, boundaries[3]+2.5);
   glVertex3f(boundaries[1]+2.5, -2.5, boundaries[3]+2.5);
 
   glNormal3f(1.0, 0.0, 0.0);
   glVertex3f(boundaries[0]-2.5, -2.5, boundaries[2]-2.5);
-  glVertex3f(boundaries[0]-2.5, BLOCK_START_Y + 2.5, boundaries[2]-2.5);
-  glVertex3f(boundaries[0]-2.5, BLOCK_START_Y + 2.5, boundaries[3]+2.5);
+  glVertex3f(boundaries[0]-2.5, blockStartY + 2.5, boundaries[2]-2.5);
+  glVertex3f(boundaries[0]-2.5, blockStartY + 2.5, boundaries[3]+2.5);
   glVertex3f(boundaries[0]-2.5, -2.5, boundaries[3]+2.5);
 
   glNormal3f(-1.0, 0.0, 0.0);
   glVertex3f(boundaries[1]+2.5, -2.5, boundaries[2]-2.5);
   glVertex3f(boundaries[1]+2.5, -2.5, boundaries[3]+2.5);
-  glVertex3f(boundaries[1]+2.5, BLOCK_START_Y + 2.5, boundaries[3]+2.5);
-  glVertex3f(boundaries[1]+2.5, BLOCK_START_Y + 2.5, boundaries[2]-2.5);
+  glVertex3f(boundaries[1]+2.5, blockStartY + 2.5, boundaries[3]+2.5);
+  glVertex3f(boundaries[1]+2.5, blockStartY + 2.5, boundaries[2]-2.5);
   glEnd();
 
   glDisable(GL_DEPTH_TEST);
@@ -1422,12 +1523,13 @@ void displayText(string str, float x, float y)
 // Draw a connection from the player to the selected block
 void drawLocalConnection()
 {
+  Block *selected = blocks.get(selectedBlock);
   // the three points of the triangle
   float x1 = 0, y1 = 0, z1 = 0;
   float x2 = 0, y2 = 0, z2 = 0;
   float x3 = 0, y3 = 0, z3 = 0;
-  if (selectedBlock > -1) {
-    blocks[selectedBlock].getPivotCoords(x1, y1, z1);
+  if (selected != NULL) {
+    selected->getPivotCoords(x1, y1, z1);
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
       glDisable(GL_DEPTH_TEST);
@@ -1449,8 +1551,8 @@ void drawLocalConnection()
       // y here should match y above
       x3 = -x2, y3 = -1.0, z3 = -z2;
 
-      x2 += player.getX(), y2 += player.getY(), z2 += player.getZ();
-      x3 += player.getX(), y3 += player.getY(), z3 += player.getZ();
+      x2 += player.getDrawX(), y2 += player.getDrawY(), z2 += player.getDrawZ();
+      x3 += player.getDrawX(), y3 += player.getDrawY(), z3 += player.getDrawZ();
 
       // add a negative z vector to make it so when you look down you don't see a gap in the line
       float x4 = 0.0, z4 = -1.0;
@@ -1478,23 +1580,24 @@ void drawLocalConnection()
 
 // Draw the connection from another user (not us) to their selected block
 // 
-// blockNum - the number of the block that they have selected
+// blockHandle - the handle of the block that they have selected
 // humanNum - the number of the human (player) which has selected it
-void drawRemoteConnection(int blockNum, int humanNum)
+void drawRemoteConnection(BlockHandle blockHandle, int humanNum)
 {
   // block to human axis
   float x1 = 0, y1 = 0, z1 = 0, x2 = 0, y2 = 0, z2 = 0;
+  Block *block = blocks.get(blockHandle);
 
   if (humanNum < 0 || humanNum > (int) humans.size() - 1){
     cerr << "drawConnection: humanNum out of range: " << humanNum << endl;
-  }else if (blockNum < 0 || blockNum > (int) blocks.size() -1) {
+  }else if (block == NULL) {
     // we can output things here for testing purposes
     // 
-    //cerr << "drawConnection: blockNum out of range: " << blockNum << endl;
+    //cerr << "drawConnection: no block for handle: " << blockHandle << endl;
     //cerr << "...assuming it's just because it's not appeared yet or because blocks have split" << endl;
   }else if (drawConnectionCount > 0){
     
-    blocks[blockNum].getPivotCoords(x1, y1, z1);
+    block->getPivotCoords(x1, y1, z1);
     x2 = humans[humanNum].getX();
     y2 = humans[humanNum].getY();
     z2 = humans[humanNum].getZ();
@@ -1552,7 +1655,7 @@ void display()
 	GLfloat lp[4]; // light position
   
   double clipEq[] = {0.0f, -1.0f, 0.0f, 0.0f}; // for reflections
-  int locked = 0;
+  BlockHandle locked = NO_BLOCK;
 
   if (renderMode == GL_RENDER){
     glClear ( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -1572,7 +1675,7 @@ void display()
   glRotatef(-player.getAngleY()+180.0, 0.0, 1.0, 0.0);
 
   // then translate the camera into position
-  glTranslatef(-player.getX(), -player.getY() - cameraHeight, -player.getZ());
+  glTranslatef(-player.getDrawX(), -player.getDrawY() - cameraHeight, -player.getDrawZ());
 
   if (renderMode == GL_RENDER){
     // Reflection code inspired by nehe tutorial
@@ -1622,13 +1725,13 @@ void display()
       if (gameOver) display3DText(1);
       for (int i = 0; i < (int) humans.size(); i++) {
         locked = humans[i].getLocked();
-        if (locked > -1) {
+        if (locked != NO_BLOCK) {
           drawRemoteConnection(locked, i);
         }
       }
       //drawBoundaries(); -- causes z-fighting cos the ones near camera are drawn
       for (int i = 0; i < (int) humans.size(); i++) humans[i].draw(Texture::texId, 6);
-      glTranslatef(player.getX(), player.getY() + 10.0, player.getZ());
+      glTranslatef(player.getDrawX(), player.getDrawY() + 10.0, player.getDrawZ());
       glRotatef(player.getAngleY(), 0.0, 1.0, 0.0);
       glRotatef(-player.getAngleX(), 1.0, 0.0, 0.0);
       me.draw(Texture::texId, 6);
@@ -1758,7 +1861,7 @@ void display()
 
           float matrix[16] = {x1, x2, x3, 0, y1, y2, y3, 0, z1, z2, z3, 0, 0, 0, 0, 1};
           glMultMatrixf(matrix);
-          glTranslatef(-blocks[blockNum].getX(), -blocks[blockNum].getY(), -blocks[blockNum].getZ());
+          glTranslatef(-blocks[blockNum].getDrawX(), -blocks[blockNum].getDrawY(), -blocks[blockNum].getDrawZ());
           glGetFloatv(GL_MODELVIEW_MATRIX,Minv);
           lp[0] = lightCoords0[0];						// Store Light Position X In lp[0]
           lp[1] = lightCoords0[1];						// Store Light Position Y In lp[1]
@@ -1770,7 +1873,7 @@ void display()
           glPopMatrix();
 
           glPushMatrix();
-          glTranslatef(blocks[blockNum].getX(), blocks[blockNum].getY(), blocks[blockNum].getZ());
+          glTranslatef(blocks[blockNum].getDrawX(), blocks[blockNum].getDrawY(), blocks[blockNum].getDrawZ());
           blocks[blockNum].getMatrix(matrix);
           pivotX = blocks[blockNum].getPivotX(); //Coords(pivotX, pivotY, pivotZ);
           pivotY = blocks[blockNum].getPivotY();
@@ -1781,7 +1884,20 @@ void display()
           //GLUquadric* q = gluNewQuadric();
           //gluSphere(q, 5.0f, 16, 8);
           //drawObject(shadowBlock[blocks[blockNum].getType()]);
-          castShadow(shadowBlock[blocks[blockNum].getType()], lp);
+          if (blocks[blockNum].getFragment()) {
+            // fragments only have some of their type's cubes, so shadow
+            // them a cube at a time (the light is directional, so lp is
+            // the same for every cube)
+            int cx, cy, cz;
+            for (int c = 0; c < blocks[blockNum].getNumberOfCubes(); c++) {
+              blocks[blockNum].getCube(c, cx, cy, cz);
+              glTranslatef(cx * 5, cy * 5, cz * 5);
+              castShadow(cubeObj, lp);
+              glTranslatef(-cx * 5, -cy * 5, -cz * 5);
+            }
+          }else{
+            castShadow(shadowBlock[blocks[blockNum].getType()], lp);
+          }
 
           glPopMatrix();
         }
@@ -1816,7 +1932,7 @@ void display()
  // if (renderMode == GL_RENDER) {
     for (int i = 0; i < (int) humans.size(); i++) {
       locked = humans[i].getLocked();
-      if (locked > -1) {
+      if (locked != NO_BLOCK) {
         drawRemoteConnection(locked, i);
       }
     }
@@ -1829,6 +1945,7 @@ void display()
     
     if (output) drawCollisionArray();
 
+    drawGhost();
     drawLocalConnection();
 
     if (welcomeCount > 0) display3DText(0);
@@ -1950,6 +2067,7 @@ void reshape(int w, int h)
 //   y - the mouse y coordinate
 void keyboard(unsigned char key, int x, int y)
 {
+  Block *selected = blocks.get(selectedBlock);
   // for fps analysing
   //int mean = 0, lowest = 100000, highest = 0;
   
@@ -1979,7 +2097,7 @@ void keyboard(unsigned char key, int x, int y)
       if (training > 0) trainTimebase = -TRAINING_TIME;
       if (training == 1) {
         blocks.clear();
-        selectedBlock = -1;
+        selectedBlock = NO_BLOCK;
         // allow game to start
       }
       break;
@@ -2028,7 +2146,7 @@ void keyboard(unsigned char key, int x, int y)
       //forceCornerBlock = !forceCornerBlock;
       //output = !output; // for testing purposes
       //humans[0].setLocked(1);
-      blocks[0].output();
+      if (blocks.size() > 0) blocks[0].output();
       cout << "lc0: " << lightCoords0[0] << ", " << lightCoords0[1] << ", " << lightCoords0[2] << endl;
       cout << "lc1: " << lightCoords1[0] << ", " << lightCoords1[1] << ", " << lightCoords1[2] << endl;
       break;
@@ -2064,23 +2182,41 @@ void keyboard(unsigned char key, int x, int y)
       if (controllingLight == 0) lightCoords0[3] = !lightCoords0[3];
       else lightCoords1[3] = !lightCoords1[3];
     case 'm':
-      if (selectedBlock > -1) blocks[selectedBlock].setMode(MODE_GLOBAL_REFERENCE);
+      if (selected != NULL) selected->setMode(MODE_GLOBAL_REFERENCE);
       break;
     case 'i':
-      if (selectedBlock > -1 && !blocks[selectedBlock].getMoving())
-        blocks[selectedBlock].setTargetPosition(blocks[selectedBlock].getX(), blocks[selectedBlock].getY()+5, blocks[selectedBlock].getZ());
+      if (selected != NULL && !selected->getMoving())
+        selected->setTargetPosition(selected->getX(), selected->getY()+5, selected->getZ());
       break;
     //case 'j':
     //  if (selectedBlock > -1 && !blocks[selectedBlock].getMoving())
     //    blocks[selectedBlock].setTargetPosition(blocks[selectedBlock].getX()-5, blocks[selectedBlock].getY(), blocks[selectedBlock].getZ());
     //  break;
     case 'k':
-      if (selectedBlock > -1 && !blocks[selectedBlock].getMoving())
-        blocks[selectedBlock].setTargetPosition(blocks[selectedBlock].getX(), blocks[selectedBlock].getY()-5, blocks[selectedBlock].getZ());
+      if (selected != NULL && !selected->getMoving())
+        selected->setTargetPosition(selected->getX(), selected->getY()-5, selected->getZ());
       break;
     case 'l':
-      if (selectedBlock > -1 && !blocks[selectedBlock].getMoving())
-        blocks[selectedBlock].setTargetPosition(blocks[selectedBlock].getX()+5, blocks[selectedBlock].getY(), blocks[selectedBlock].getZ());
+      if (selected != NULL && !selected->getMoving())
+        selected->setTargetPosition(selected->getX()+5, selected->getY(), selected->getZ());
+      break;
+    case 'r': // rewind to the last snapshot, then the one before...
+      if (!network && !training) {
+        if (restoreSnapshot(snapshots.getRecent(rewindAge))) rewindAge++;
+      }
+      break;
+    case 'x': // hard drop
+      if (selected != NULL && !selected->getMoving() && !selected->getTurning()) {
+        blocks.unGroundAbove(selectedBlock, collisionGrid, boundaries); // before it goes
+        selected->drop(collisionGrid, boundaries);
+
+        if (network && !training) {
+          string networkData;
+          networkData += FLAG_DROP;
+          networkData += blocks.toNetwork(selectedBlock);
+          client.sendData(networkData);
+        }
+      }
       break;
   }
 }
@@ -2214,25 +2350,26 @@ void processHits(GLint hits, GLuint buffer[])
    if( nearestId > -1) {
      // %u is unsigned decimal integer
      //printf("Nearest object is no. %u\n",nearestId);
-     if (nearestId > (int) blocks.size()) {
-       cerr << "selectedId too high in process hits" << endl;
-     }else if (blocks[nearestId].getInteractive()) {
-       blocks[nearestId].unGrounded();
+     // names are block handles (see drawBlocks)
+     Block *nearest = blocks.get(nearestId);
+     if (nearest == NULL) {
+       cerr << "no block for selectedId in process hits" << endl;
+     }else if (nearest->getInteractive()) {
+       blocks.unGround(nearestId);
        selectedBlock = nearestId;
 
        if (network && !training) {
          // send lock data
-         char temp = (char) selectedBlock + '0'; // never send null
          string networkData;
          networkData += FLAG_LOCK;
-         networkData += temp;
+         networkData += blocks.toNetwork(selectedBlock); // never sends null
 
          client.sendData(networkData);
        }
      }
    }
    else {
-     selectedBlock = -1; // no selection
+     selectedBlock = NO_BLOCK; // no selection
    }
 }
 
@@ -2353,14 +2490,12 @@ void swap(float &a, float &b)
   b = temp;
 }
 
-// unground everything above a certain coordinate
-//   y - the vertical coordinate to unground blocks above
-void unGroundAbove(float y)
+// unground a block and everything resting on it, looking up the columns
+// it occupies rather than at every block
+//   h - the block to unground
+void unGroundAbove(BlockHandle h)
 {
-  for (int i = 0; i < (int) blocks.size(); i++) {
-    if (blocks[i].getY() > y) blocks[i].unGrounded();
-    //else cout << "Checking y: " << y << " against block y: " << blocks[i].getY() << endl;
-  }
+  blocks.unGroundAbove(h, collisionGrid, boundaries);
 }
 
 // Called when mouse is moved and buttons are being pressed
@@ -2368,35 +2503,34 @@ void unGroundAbove(float y)
 //   y - the mouse y coordinate
 void mouseActiveMove(int x, int y)
 {
+  Block *selected = blocks.get(selectedBlock);
   string networkData; // data to be sent across network
 
   // manipulate block
-  if (pressLeftButton && selectedBlock > -1) {
+  if (pressLeftButton && selected != NULL) {
 
-    blocks[selectedBlock].unGrounded();
-    unGroundAbove(blocks[selectedBlock].getY());
+    unGroundAbove(selectedBlock);
     
     int mx = x - windowCentreX, my = y - windowCentreY;
 
     int pAngleY = (int) (player.getAngleY()+45) / 90 * 90;
     if (pAngleY == 360) pAngleY = 0;
     
-    float angleX = blocks[selectedBlock].getAngleX();
-    float angleY = blocks[selectedBlock].getAngleY();
-    float angleZ = blocks[selectedBlock].getAngleZ();
+    float angleX = selected->getAngleX();
+    float angleY = selected->getAngleY();
+    float angleZ = selected->getAngleZ();
     float newAngle = 0.0;
 
-    char temp = (char) selectedBlock + '0';
     networkData += FLAG_MANIPULATE;
-    networkData += temp;
+    networkData += blocks.toNetwork(selectedBlock);
     
     // if moving or turning then warp back
     warpBack = true;
 
     // if not already turning or moving
-    if (!blocks[selectedBlock].getTurning() && !blocks[selectedBlock].getMoving()) {
+    if (!selected->getTurning() && !selected->getMoving()) {
       warpBack = false; // allow user to move
-      blocks[selectedBlock].setRemoteMovement(false);
+      selected->setRemoteMovement(false);
 
       if (pAngleY == 180) my = -my;
 
@@ -2410,7 +2544,7 @@ void mouseActiveMove(int x, int y)
             if (angleX > 179.0 || angleX < -179.0) mx = -mx;
             if (mx > 0) newAngle = angleY + 90;
             else newAngle = angleY - 90;
-            blocks[selectedBlock].setTargetAngleY(newAngle);
+            selected->setTargetAngleY(newAngle);
             // with global reference angleX,Y,Z == 0
             networkData += 'Y';
           }else{
@@ -2418,7 +2552,7 @@ void mouseActiveMove(int x, int y)
             if (angleY > 179.0 && angleX < 181.0) mx = -mx;
             if (mx > 0) newAngle = angleX + 90;
             else newAngle = angleX - 90;
-            blocks[selectedBlock].setTargetAngleX(newAngle);
+            selected->setTargetAngleX(newAngle);
             networkData += 'X';
           }
 
@@ -2430,14 +2564,14 @@ void mouseActiveMove(int x, int y)
             if (angleY > 179.0 && angleY < 181.0) my = -my;
             if (my < 0) newAngle = angleZ + 90;
             else newAngle = angleZ - 90;
-            blocks[selectedBlock].setTargetAngleZ(newAngle);
+            selected->setTargetAngleZ(newAngle);
             networkData += 'Z';
           }else{
             cout << "turning in X" << endl;
             if (angleY > 269.0 && angleY < 271.0) my = -my;
             if (my < 0) newAngle = angleX + 90;
             else newAngle = angleX - 90;
-            blocks[selectedBlock].setTargetAngleX(newAngle);
+            selected->setTargetAngleX(newAngle);
             networkData += 'X';
           }
 
@@ -2449,7 +2583,7 @@ void mouseActiveMove(int x, int y)
 
           if (mx > 0) newAngle = angleY + 90;
           else newAngle = angleY - 90;
-          blocks[selectedBlock].setTargetAngleY(newAngle);
+          selected->setTargetAngleY(newAngle);
           networkData += 'Y';
 
         }else if (abs(mx) < abs(my) - 1) { // turn up or down
@@ -2459,7 +2593,7 @@ void mouseActiveMove(int x, int y)
             if (angleY > 179.0 && angleY < 181.0) my = -my;
             if (my < 0) newAngle = angleX + 90;
             else newAngle = angleX - 90;
-            blocks[selectedBlock].setTargetAngleX(newAngle);
+            selected->setTargetAngleX(newAngle);
             networkData += 'X';
           }else{
             // this part is not done in global reference
@@ -2467,13 +2601,13 @@ void mouseActiveMove(int x, int y)
             if (pAngleY == 270 || pAngleY == 90) my = -my;
             if (my < 0) newAngle = angleX - 90;
             else newAngle = angleX + 90;
-            blocks[selectedBlock].setTargetAngleX(newAngle);
+            selected->setTargetAngleX(newAngle);
             if (my < 0) newAngle = angleY + 90;
             else newAngle = angleY - 90;
-            blocks[selectedBlock].setTargetAngleY(newAngle);
+            selected->setTargetAngleY(newAngle);
             if (my < 0) newAngle = angleZ - 90;
             else newAngle = angleZ + 90;
-            blocks[selectedBlock].setTargetAngleZ(newAngle);
+            selected->setTargetAngleZ(newAngle);
           }
         }
       }
@@ -2486,10 +2620,9 @@ void mouseActiveMove(int x, int y)
     } // end if not turning
       
     if ((mx != 0 || my != 0) && warpBack) glutWarpPointer(windowCentreX, windowCentreY);
-  }else if (pressRightButton && selectedBlock > -1) {
+  }else if (pressRightButton && selected != NULL) {
 
-    blocks[selectedBlock].unGrounded();
-    unGroundAbove(blocks[selectedBlock].getY());
+    unGroundAbove(selectedBlock);
     
     // mx, my, the amount moved x and y
     int mx = x - windowCentreX, my = y - windowCentreY;
@@ -2497,9 +2630,9 @@ void mouseActiveMove(int x, int y)
 
     warpBack = true; // if moving or turning
 
-    if (!blocks[selectedBlock].getMoving() && !blocks[selectedBlock].getTurning()) {
+    if (!selected->getMoving() && !selected->getTurning()) {
       warpBack = false; // allow user to move mouse in a direction
-      blocks[selectedBlock].setRemoteMovement(false);
+      selected->setRemoteMovement(false);
 
       if ((abs(mx) - abs(my)) > 1 || (abs(my) - abs(mx)) > 1) {
         warpBack = true; // got movement so warp back
@@ -2548,8 +2681,8 @@ void mouseActiveMove(int x, int y)
         }
 
         //if (!network) {
-          blocks[selectedBlock].setTargetPosition(blocks[selectedBlock].getX() + moveBlockX,
-                  blocks[selectedBlock].getY() + moveBlockY, blocks[selectedBlock].getZ() + moveBlockZ);
+          selected->setTargetPosition(selected->getX() + moveBlockX,
+                  selected->getY() + moveBlockY, selected->getZ() + moveBlockZ);
         //}
 
         if (moveBlockX < 0) direction = 0;
@@ -2560,10 +2693,8 @@ void mouseActiveMove(int x, int y)
         if (moveBlockZ > 0) direction = 5;
         if (network && !training) {
           networkData += FLAG_MOVE;
-          char temp = (char) selectedBlock + '0';
-          networkData += temp;
-          temp = (char) direction + '0';
-          networkData += temp;
+          networkData += blocks.toNetwork(selectedBlock);
+          networkData += (char) direction + '0';
           client.sendData(networkData);
           //cout << "(network dependent) sent move info: " << networkData << endl;
         }
@@ -2584,20 +2715,12 @@ void mouseActiveMove(int x, int y)
 }
 
 // Affect all blocks with gravity
-//   value - the paramater required by glutTimerFunc(). Not used.
+//   value - the paramater required by Scheduler::after(). Not used.
 void gravity(int value)
 {
-  int grounded = 0; // used for output
+  Rules::gravity(blocks, pauseGame);
 
-  for (int i = 0; i < (int) blocks.size(); i++) {
-    if (!blocks[i].getMoving() && !blocks[i].getTurning() && !blocks[i].getGrounded()) {
-      if (!pauseGame) blocks[i].setTargetPosition(blocks[i].getX(), blocks[i].getY()-5, blocks[i].getZ());
-    }else{
-      if (blocks[i].getGrounded()) grounded++;
-    }
-  }
-
-  if (pauseGame) cout << "number grounded: " << grounded << endl;
+  if (pauseGame) cout << "number grounded: " << blocks.size() - blocks.getActiveSize() << endl;
   
   if (!pauseGame) {
     if (gravityTimer > GRAVITY_COUNT_MIN) gravityTimer -= GRAVITY_COUNT_DECREASE;
@@ -2605,99 +2728,77 @@ void gravity(int value)
     //if (gameNumber < GAMENUMBER_FASTGAME && newBlockTimer > NEW_BLOCK_COUNT_MIN) newBlockTimer -= NEW_BLOCK_COUNT_DECREASE;
   }
 
-  if (!stopGravity) glutTimerFunc(gravityTimer, gravity, 0);
+  if (!stopGravity) scheduler.after(gravityTimer, gravity, 0);
   else stopGravity = false;
 }
 
-// checks if there is a complete plane of blocks
+// Deal with the complete planes of blocks: take them out, or in a network
+// game tell the server about them and take them out when it says so. Called
+// when a layer has just been completed or the server has said to remove
+// one, rather than every so often.
 void checkForPlane()
 {
-  vector <vector <float> > layer;
-  vector <vector <float> > temp;
-  vector <Block> outputBlocks;
-
-  // go through layers of blocks looking for a complete plane
-  for (int layerY = 0; layerY <= (int) BLOCK_START_Y; layerY += 5) {
-    layer.clear();
-
-    for (int i = 0; i < (int) blocks.size(); i++) {
-      temp.clear();
-      temp = blocks[i].getLayer(layerY);
-
-      for (int j = 0; j < (int) temp.size(); j++) 
-        layer.push_back(temp[j]);
-    }
-
-    // have we got a complete plane?
-    if ((int) layer.size() == (GAMEBLOCK_WIDTH * GAMEBLOCK_DEPTH)) {
-      bool found = false;
-      if (network && !training) {
-
-        for (int i = 0; i < (int) sentFoundLayer.size(); i++) {
-          if (sentFoundLayer[i] == layerY) found = true;
-        }
-          
-        // if we've not done so already, notify the other clients that a layer
-        // has been found
-        if (!found) {
-          if (LOG_OUTPUT) cout << "sending found flag" << endl;
-          sentFoundLayer.push_back(layerY);
-          string networkData;
-          networkData += FLAG_LAYER_FOUND;
-          networkData += (char) (layerY + 1); // +1 so it can't be null
-          if (network) client.sendData(networkData);
-        }
-    
-        found = false;
-
-        for (int i = 0; i < (int) receivedRemoveLayer.size(); i++) {
-          if (receivedRemoveLayer[i] == layerY) {
-            found = true;
-            for (int k = i; k < (int) receivedRemoveLayer.size() - 1; k++) receivedRemoveLayer[k] = receivedRemoveLayer[k+1];
-            receivedRemoveLayer.pop_back(); // remove the layer from list now it's been found and will be deleted
-            for (int k = 0; k < (int) sentFoundLayer.size(); k++) {
-              if (sentFoundLayer[k] == layerY) { // remove it from list
-                for (int l = k; l < (int) sentFoundLayer.size() - 1; l++) sentFoundLayer[l] = sentFoundLayer[l+1];
-                sentFoundLayer.pop_back();
-              }
+  LayerSet removeLayers; // complete layers to remove, y / 5 for layer y
+
+  // only the complete layers, which the collision grid keeps as the resting
+  // cubes in each layer come and go
+  const LayerSet complete = collisionGrid.getCompleteLayers();
+  for (int y = complete._Find_first(); y < (int) complete.size(); y = complete._Find_next(y)) {
+    int layerY = y * 5;
+    bool found = false;
+    if (network && !training) {
+
+      for (int i = 0; i < (int) sentFoundLayer.size(); i++) {
+        if (sentFoundLayer[i] == layerY) found = true;
+      }
+        
+      // if we've not done so already, notify the other clients that a layer
+      // has been found
+      if (!found) {
+        if (LOG_OUTPUT) cout << "sending found flag" << endl;
+        sentFoundLayer.push_back(layerY);
+        string networkData;
+        networkData += FLAG_LAYER_FOUND;
+        networkData += (char) (layerY + 1); // +1 so it can't be null
+        if (network) client.sendData(networkData);
+      }
+  
+      found = false;
+
+      for (int i = 0; i < (int) receivedRemoveLayer.size(); i++) {
+        if (receivedRemoveLayer[i] == layerY) {
+          found = true;
+          for (int k = i; k < (int) receivedRemoveLayer.size() - 1; k++) receivedRemoveLayer[k] = receivedRemoveLayer[k+1];
+          receivedRemoveLayer.pop_back(); // remove the layer from list now it's been found and will be deleted
+          for (int k = 0; k < (int) sentFoundLayer.size(); k++) {
+            if (sentFoundLayer[k] == layerY) { // remove it from list
+              for (int l = k; l < (int) sentFoundLayer.size() - 1; l++) sentFoundLayer[l] = sentFoundLayer[l+1];
+              sentFoundLayer.pop_back();
             }
-            break;
           }
+          break;
         }
       }
+    }
 
-      if (!network || training || found) {
-        numberOfLayers++;
-        float seconds = (glutGet(GLUT_ELAPSED_TIME) - gameStartTime) / 1000.0; // no. of seconds passed since start of game
-        if (LOG_OUTPUT) cout << "layer removed at time: " << seconds << " since start of this game." << endl;
-        outputBlocks.clear();
-
-        // go through all blocks, removing layers that are part of the complete plane
-        for (int i = 0; i < (int) blocks.size(); i++) {
-          blocks[i].unGrounded();
-          if (blocks[i].removeLayer(blocks, outputBlocks, collisionArray, boundaries, blockId, layerY)) { // if a layer has been removed
-            if (selectedBlock == i) selectedBlock = -1; // no longer selected because it's in pieces
-            //if (removeBlock(i)) i--; // an element has been removed
-            // current block is not output because it has been split
-          }else{
-            // the current block is ok to continue with
-            outputBlocks.push_back(blocks[i]);
-          }
-        }
+    if (!network || training || found) removeLayers.set(layerY / 5);
 
-        blocks = outputBlocks;
-        explosions.push_back(Explosion(layerY));
-        score += 10; // 10 points
-        if (scoreCount > 0) { // if got another layer too (within 50 loops)
-          score += 10; // an extra 10
-        }
-        scoreCount = 50; // reset scoreCount
-      }
-    }
+  } // end for y
 
-  } // end for layerY
+  if (removeLayers.any()) {
+    // handles to blocks that are broken up, like selectedBlock, stop
+    // finding anything
+    Rules::removeLayers(blocks, removeLayers, collisionGrid, boundaries, blockId);
 
-  if (scoreCount > 0) scoreCount--;
+    for (int y = removeLayers._Find_first(); y < (int) removeLayers.size(); y = removeLayers._Find_next(y)) {
+      int layerY = y * 5;
+      numberOfLayers++;
+      float seconds = (glutGet(GLUT_ELAPSED_TIME) - gameStartTime) / 1000.0; // no. of seconds passed since start of game
+      if (LOG_OUTPUT) cout << "layer removed at time: " << seconds << " since start of this game." << endl;
+      explosions.push_back(Explosion(layerY));
+      score += Rules::scoreLayer(scoreCount);
+    }
+  }
 }
 
 // Create a new block
@@ -2716,22 +2817,28 @@ void newBlock(int type)
   // the condition below will not start anymore calls once network is set,
   // and the following condition will allow us to cancel a block
   if (!cancelBlock && !gameOver) {
-    blocks.push_back(Block(blockId++, type, 0, BLOCK_START_Y, 0, true, collisionArray, boundaries));
+    Rules::newBlock(blocks, blockId, type, blockStartY, collisionGrid, boundaries);
     blockScore++;
   }else cancelBlock = false;
 
   if (!network) {
     // decrease new block timer
     if (newBlockTimer > NEW_BLOCK_COUNT_MIN) newBlockTimer -= NEW_BLOCK_COUNT_DECREASE;
-    glutTimerFunc(newBlockTimer, newBlock, rand()%8);
+    scheduler.after(newBlockTimer, newBlock, rand()%8);
   }
+
+  // something to rewind to (with the next block's timer already set), but
+  // only in a game that can be rewound (see 'r' in keyboard), and not too
+  // often, as copying the blocks and grid isn't free
+  if (!network && !training && (snapshots.size() == 0 || scheduler.getTick() - snapshotTick >= SNAPSHOT_MIN_TICKS))
+    takeSnapshot();
 }
 
 // Start a new game
 void newGame()
 {
   gameOver = false;
-  selectedBlock = -1;
+  selectedBlock = NO_BLOCK;
   textY = TEXT_Y_START;
   textAlpha = TEXT_ALPHA_START;
   gameOverCount = GAMEOVER_COUNT_MAX;
@@ -2744,6 +2851,7 @@ void newGame()
   
   blocks.clear();
   clearCollisionArray();
+  snapshots.clear();
 
   // output stats
   if (LOG_OUTPUT) {
@@ -2826,30 +2934,26 @@ void postRedisplay(int value)
   glutTimerFunc(TIMER_REDISPLAY, postRedisplay, 0);
 }
 
-// Called regularly based on a time interval.
-// Contains operations that need to be performed each frame.
-void idle(int value)
+// One fixed simulation tick, run by the scheduler. Everything that moves
+// the game on happens here, so a tick is the same amount of game on any
+// machine.
+//   value - the tick number, which sets the game clock for the blocks
+void tick(int value)
 {
-  //
-  // lastFrameTime and elapsedTime used to implement pawn movement and
-  // block rotation that's independent of frame rate
-  //
-  static int lastFrameTime = glutGet(GLUT_ELAPSED_TIME);
-  glutPostRedisplay();
-
   int newBlockType = -1;
   bool startGravity = false, receivedLock = false;
 
-  elapsedTime=glutGet(GLUT_ELAPSED_TIME);
-  //
-  // Time in secs since last frame
-  //
-  float timeSecs = ((float) (elapsedTime - lastFrameTime)) * 0.001;
+  // movement is worked out per second, from the fixed tick length
+  const float timeSecs = SIM_TICK_MS * 0.001;
+
+  // blocks move and turn to where they should be at this tick
+  Block::setClock(value);
+
+  // where things were at the start of the tick, to draw from
+  player.storeLast();
+  for (int i = 0; i < (int) humans.size(); i++) humans[i].storeLast();
+  for (int i = 0; i < (int) blocks.size(); i++) blocks[i].storeLast();
 
-  if (mouseMoveX != 0 || mouseMoveY != 0) {
-    player.turn(mouseSensitivity * mouseMoveX, mouseSensitivity * mouseMoveY);
-    mouseMoveX = 0, mouseMoveY = 0;
-  }
   if (pressTurnRight) player.turnRight();
   if (pressTurnLeft) player.turnLeft();
   if (pressTurnUp) player.turn(0, 0.7);
@@ -2863,12 +2967,8 @@ void idle(int value)
 
   player.move( timeSecs );
 
-  for (int i = 0; i < (int) blocks.size(); i++) {
-    blocks[i].move(blocks, boundaries, collisionArray, timeSecs);
-    // check game over
-    if (blocks[i].getGameOver() && !gameOver) doGameOver();
-    if (gameOver) blocks[i].setInteractive(false);
-  }
+  if (Rules::moveBlocks(blocks, collisionGrid, boundaries) && !gameOver) doGameOver();
+  if (gameOver) for (int i = 0; i < blocks.size(); i++) blocks[i].setInteractive(false);
 
   for (int i = 0; i < (int) explosions.size(); i++) {
     explosions[i].go();
@@ -2878,19 +2978,21 @@ void idle(int value)
     if (explosions[0].getDead()) explosions.pop_front(); // remove dead explosion
   }
   
+  // the bonus for another layer runs down every few ticks
   if (speedCount == 0) {
-    checkForPlane();
+    if (scoreCount > 0) scoreCount--;
     speedCount = 6;
   }
   speedCount--;
-  
+
+  int removesBefore = receivedRemoveLayer.size();
   if (network && !training) {
-    client.doClient(player, humans, blocks, newBlockType, startGravity, receivedLock, receivedRemoveLayer);
+    client.doClient(player, humans, blocks, newBlockType, startGravity, receivedLock, receivedRemoveLayer, collisionGrid, boundaries);
     if (receivedLock) drawConnectionCount = DRAW_CONNECTION_COUNT_MAX;
     if (newBlockType > -1) newBlock(newBlockType);
     if (startGravity) {
       if (LOG_OUTPUT) cout << "starting gravity" << endl;
-      glutTimerFunc(gravityTimer, gravity, 0);
+      scheduler.after(gravityTimer, gravity, 0);
     }
     if (!client.getMaster()) {
       me.setTexFace(2);
@@ -2899,11 +3001,15 @@ void idle(int value)
           blocks[i].setGotConfirmed(false);
           //cout << "moving/turning" << endl;
         }
-        if (blocks[i].getGotConfirmed()) blocks[i].toConfirmed(boundaries, collisionArray);
+        if (blocks[i].getGotConfirmed()) blocks[i].toConfirmed(boundaries, collisionGrid);
       }
     }
   }
 
+  // complete layers are dealt with when blocks coming to rest fill them,
+  // or when the server says one can go
+  if (collisionGrid.takeNewlyComplete().any() || (int) receivedRemoveLayer.size() > removesBefore) checkForPlane();
+
   // do welcome message stuff
   if (welcomeCount > 0) {
     welcomeCount--;
@@ -2927,10 +3033,28 @@ void idle(int value)
     }
     if (gameOverCount == 0) newGame();
   }
+}
+
+// Called regularly based on a time interval.
+// Runs the simulation ticks that have come due, then redraws in between the
+// last two.
+void idle(int value)
+{
+  glutPostRedisplay();
+
+  // mouse look is taken as it comes, so the view keeps up with the mouse
+  // between ticks
+  if (mouseMoveX != 0 || mouseMoveY != 0) {
+    player.turn(mouseSensitivity * mouseMoveX, mouseSensitivity * mouseMoveY);
+    mouseMoveX = 0, mouseMoveY = 0;
+  }
+
+  elapsedTime=glutGet(GLUT_ELAPSED_TIME);
+  scheduler.advance(elapsedTime, tick);
+  Pawn::setDrawAlpha(scheduler.getAlpha());
 
   // display message and frames per second
   frame++;
-	elapsedTime=glutGet(GLUT_ELAPSED_TIME);
   if (training == 4 && elapsedTime - trainTimebase > TRAINING_TIME) {
     training--;
     message = "Training level 2 of 4.\nMove down using 'C'.\nMove up using the spacebar.\n\n";
@@ -2953,18 +3077,18 @@ void idle(int value)
     message += "Bonus points are awarded for completing\nmore than one layer at a time.\n\n";
     message += "Complete this layer or press\nReturn to begin the game.";
     blocks.clear();
-    selectedBlock = -1;
+    selectedBlock = NO_BLOCK;
     clearCollisionArray();
-    for (int z = -10; z < 15; z += 5) {
-      for (int x = -10; x < 15; x += 5) {
+    for (int z = (int) boundaries[2]; z <= (int) boundaries[3]; z += 5) {
+      for (int x = (int) boundaries[0]; x <= (int) boundaries[1]; x += 5) {
         if (x != 5 || z != 0) {
-          blocks.push_back(Block(blockId++, 0, x, 0, z, false, collisionArray, boundaries));
-          blocks[blocks.size()-1].setGrounded(true);
+          BlockHandle b = blocks.create(blockId++, 0, x, 0, z, false, collisionGrid, boundaries);
+          if (b != NO_BLOCK) blocks.get(b)->setGrounded(true);
         }
       }
     }
-    blocks.push_back(Block(blockId++, 0, 0, BLOCK_START_Y, 0, true, collisionArray, boundaries));
-    glutTimerFunc(gravityTimer, gravity, 0);
+    blocks.create(blockId++, 0, 0, blockStartY, 0, true, collisionGrid, boundaries);
+    scheduler.after(gravityTimer, gravity, 0);
   }
   if (training == 1 && blocks.size() == 0) {
     training = 0; // play game
@@ -2978,11 +3102,6 @@ void idle(int value)
 		timebase = elapsedTime;		
 		frame = 0;
 	}
-  //
-  // Store time for next frame
-  //
-  lastFrameTime = elapsedTime;
-
   glutTimerFunc(TIMER_IDLE, idle, 0);
 }
 
@@ -3070,9 +3189,17 @@ int main(int argc, char** argv)
 
   //if (argc > 1) {
     int ipArg = 0;
+    int arenaWidth = GAMEAREA_WIDTH, arenaHeight = GAMEAREA_HEIGHT, arenaDepth = GAMEAREA_DEPTH;
     for (int i = 1; i < argc; i++) {
       if (!strcmp(argv[i], "-s")) stereo = true;
       if (!strcmp(argv[i], "-l")) shadow = true; // l for lighting
+      if (!strcmp(argv[i], "-a") && i + 1 < argc) { // a for arena
+        if (sscanf(argv[++i], "%dx%dx%d", &arenaWidth, &arenaHeight, &arenaDepth) != 3) {
+          cerr << "Bad arena size: " << argv[i] << ", should be WIDTHxHEIGHTxDEPTH" << endl;
+          arenaWidth = GAMEAREA_WIDTH, arenaHeight = GAMEAREA_HEIGHT, arenaDepth = GAMEAREA_DEPTH;
+        }
+        continue;
+      }
       if (argv[i][0] != '-') { // if argument is not a flag (denoted by a hyphen)
         client.setHost(argv[i]);
         gotIpAddress = true;
@@ -3091,6 +3218,8 @@ int main(int argc, char** argv)
         cout << "Options:" << endl;
         cout << "  -s  Enable stereoscopic mode" << endl;
         cout << "  -l  Enable true shadows" << endl;
+        cout << "  -a WIDTHxHEIGHTxDEPTH" << endl;
+        cout << "      Size of the game area in blocks (default " << GAMEAREA_WIDTH << "x" << GAMEAREA_HEIGHT << "x" << GAMEAREA_DEPTH << ")" << endl;
         cout << "  -h, --help" << endl;
         cout << "      Display this info" << endl;
         exit(0);
@@ -3103,6 +3232,17 @@ int main(int argc, char** argv)
     if (gotIpAddress)
       cout << "Will be using ip address: " << argv[ipArg] << " for collaborative games." << endl;
     else cout << "Standalone." << endl;
+
+    if (arenaWidth < GAMEAREA_WIDTH || arenaDepth < GAMEAREA_DEPTH || arenaHeight < 4) {
+      cerr << "Game area must be at least " << GAMEAREA_WIDTH << "x4x" << GAMEAREA_DEPTH << ", using the classic size" << endl;
+      arenaWidth = GAMEAREA_WIDTH, arenaHeight = GAMEAREA_HEIGHT, arenaDepth = GAMEAREA_DEPTH;
+    }
+    if (gotIpAddress && arenaHeight > NETWORK_MAX_ARENA_HEIGHT) {
+      cerr << "Collaborative games can be at most " << NETWORK_MAX_ARENA_HEIGHT << " blocks high, using the classic size" << endl;
+      arenaWidth = GAMEAREA_WIDTH, arenaHeight = GAMEAREA_HEIGHT, arenaDepth = GAMEAREA_DEPTH;
+    }
+    setArena(arenaWidth, arenaHeight, arenaDepth);
+    cout << "Game area: " << collisionGrid.getWidth() << "x" << collisionGrid.getHeight() << "x" << collisionGrid.getDepth() << endl;
   /*}else{
     gotIpAddress = false;
     cout << "Standalone." << endl;
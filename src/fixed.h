@@ -0,0 +1,207 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * fixed.h
+ *
+ * Fixed point numbers for the simulation, so that the same inputs give the
+ * same state bit for bit on any machine, whatever the compiler does with
+ * floating point (x87 or SSE, fused multiply-adds, libm's sin and cos).
+ *
+ * Fixed<FracBits> holds a number as an integer count of 2^-FracBits, and
+ * only uses integer arithmetic: + and - are exact, * and / round to the
+ * nearest step. Scalar (16.16) is what block poses are simulated in; they're
+ * turned back into floats for drawing, collision and the network, and since
+ * the conversion is exact rounding that's the same everywhere too.
+ *
+ * FixedTrig does sin and cos of Scalar degrees from a series worked out in
+ * integers, rather than from the library.
+ */
+
+#ifndef _FIXED_
+#define _FIXED_
+
+#include <math.h>
+
+#define FIXED_SCALAR_BITS 16
+
+template <int FracBits, class Rep = int, class Wide = long long>
+class Fixed {
+
+  private:
+    static_assert(FracBits > 0 && FracBits < (int) sizeof(Rep) * 8 - 1, "no room for the whole part");
+    static_assert(sizeof(Wide) >= 2 * sizeof(Rep), "products need twice the bits");
+
+    Rep value; // in units of 2^-FracBits
+
+  public:
+    static const Rep ONE = (Rep) 1 << FracBits;
+
+    Fixed() {
+      value = 0;
+    }
+
+    Fixed(int n) {
+      value = (Rep) n * ONE;
+    }
+
+    // Make a number from its raw value
+    //   r - the value in units of 2^-FracBits
+    static Fixed fromRaw(Rep r) {
+      Fixed f;
+      f.value = r;
+      return f;
+    }
+
+    // Make a number from a float, rounding to the nearest step. Scaling by
+    // a power of two is exact, so this is the same on any machine.
+    //   f - the number
+    static Fixed fromFloat(double f) {
+      return fromRaw((Rep) floor(f * ONE + 0.5));
+    }
+
+    // Get the number as a float (exact while it fits the float's mantissa)
+    float toFloat() const {
+      return (float) value / ONE;
+    }
+
+    // Get the raw value, in units of 2^-FracBits
+    Rep raw() const {
+      return value;
+    }
+
+    // Round to the nearest whole number, halves upwards
+    int round() const {
+      return (int) ((value + ONE / 2) >> FracBits);
+    }
+
+    Fixed abs() const {
+      return fromRaw(value < 0 ? -value : value);
+    }
+
+    Fixed operator-() const {
+      return fromRaw(-value);
+    }
+
+    Fixed operator+(Fixed o) const {
+      return fromRaw(value + o.value);
+    }
+
+    Fixed operator-(Fixed o) const {
+      return fromRaw(value - o.value);
+    }
+
+    Fixed operator*(Fixed o) const {
+      return fromRaw((Rep) (((Wide) value * o.value + ONE / 2) >> FracBits));
+    }
+
+    // Divide, rounding towards zero
+    Fixed operator/(Fixed o) const {
+      return fromRaw((Rep) (((Wide) value << FracBits) / o.value));
+    }
+
+    Fixed &operator+=(Fixed o) {
+      value += o.value;
+      return *this;
+    }
+
+    Fixed &operator-=(Fixed o) {
+      value -= o.value;
+      return *this;
+    }
+
+    Fixed &operator*=(Fixed o) {
+      return *this = *this * o;
+    }
+
+    bool operator==(Fixed o) const { return value == o.value; }
+    bool operator!=(Fixed o) const { return value != o.value; }
+    bool operator<(Fixed o) const { return value < o.value; }
+    bool operator>(Fixed o) const { return value > o.value; }
+    bool operator<=(Fixed o) const { return value <= o.value; }
+    bool operator>=(Fixed o) const { return value >= o.value; }
+
+};
+
+typedef Fixed<FIXED_SCALAR_BITS> Scalar;
+
+// series are summed with this many fraction bits, well below a Scalar step
+#define FIXED_TRIG_BITS 28
+
+class FixedTrig {
+
+  private:
+    // Sine and cosine of an angle from 0 to 45 degrees, by Taylor series
+    //   r - the angle in radians, in units of 2^-FIXED_TRIG_BITS
+    //   s,c - set to the sine and cosine, in the same units
+    static void series(long long r, long long &s, long long &c) {
+      const long long one = 1LL << FIXED_TRIG_BITS;
+      long long r2 = (r * r) >> FIXED_TRIG_BITS;
+      // sin(r) / r = 1 - r^2/3! + r^4/5! - r^6/7! + r^8/9!, and
+      // cos(r) = 1 - r^2/2! + r^4/4! - r^6/6! + r^8/8!, by Horner's rule
+      static const int sinTerms[5] = { 362880, -5040, 120, -6, 1 };
+      static const int cosTerms[5] = { 40320, -720, 24, -2, 1 };
+      s = 0, c = 0;
+      for (int i = 0; i < 5; i++) {
+        s = one / sinTerms[i] + ((s * r2) >> FIXED_TRIG_BITS);
+        c = one / cosTerms[i] + ((c * r2) >> FIXED_TRIG_BITS);
+      }
+      s = (s * r) >> FIXED_TRIG_BITS;
+    }
+
+  public:
+    // Get the sine and cosine of an angle
+    //   degrees - the angle, any size
+    //   s,c - set to the sine and cosine
+    static void sinCos(Scalar degrees, Scalar &s, Scalar &c) {
+      // reduce to 0 to 360 degrees, then to an octant
+      const long long full = 360LL << FIXED_SCALAR_BITS;
+      long long a = degrees.raw() % full;
+      if (a < 0) a += full;
+      int octant = (int) (a / (full / 8));
+      long long rest = a % (full / 8);
+      if (octant % 2 == 1) rest = full / 8 - rest; // count back from the next quarter
+
+      // to radians with the trig bits
+      const long long radPerDegree = 19190490035LL; // pi / 180 in units of 2^-40
+      long long r = (rest * radPerDegree) >> (FIXED_SCALAR_BITS + 40 - FIXED_TRIG_BITS);
+      long long sr, cr;
+      series(r, sr, cr);
+
+      // back to the whole circle
+      long long sv, cv;
+      switch (octant) {
+        case 0: sv = sr, cv = cr; break;
+        case 1: sv = cr, cv = sr; break;
+        case 2: sv = cr, cv = -sr; break;
+        case 3: sv = sr, cv = -cr; break;
+        case 4: sv = -sr, cv = -cr; break;
+        case 5: sv = -cr, cv = -sr; break;
+        case 6: sv = -cr, cv = sr; break;
+        default: sv = -sr, cv = cr; break;
+      }
+
+      const int shift = FIXED_TRIG_BITS - FIXED_SCALAR_BITS;
+      s = Scalar::fromRaw((int) ((sv + (1LL << (shift - 1))) >> shift));
+      c = Scalar::fromRaw((int) ((cv + (1LL << (shift - 1))) >> shift));
+    }
+
+};
+
+#endif
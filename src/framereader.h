@@ -0,0 +1,172 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * framereader.h
+ *
+ * Splits what a client sends the server into frames, in a ring buffer.
+ *
+ * A frame is what comes between an STX (2) and the next ETX (3); the
+ * characters in a message can be neither (see Client::sendData), so the
+ * ends are never ambiguous. recv() writes straight into the ring (see
+ * space() and wrote()), and next() hands out each complete frame as a view
+ * of where it lies, in one or two pieces as the ring wraps, with its start
+ * and length. Every byte is looked at once, and nothing is moved or
+ * cleared; a frame's bytes are reused once it has been read past.
+ *
+ * A frame that can't fit in the ring is thrown away, and reading starts
+ * again from the next STX.
+ */
+
+#ifndef _FRAMEREADER_
+#define _FRAMEREADER_
+
+#include <cstring>
+#include <iostream>
+
+// size of the ring, a power of two
+#define FRAMEREADER_SIZE 4096
+
+using namespace std;
+
+// A frame, in place in the ring. It's only good until more is written.
+struct FrameView {
+  const char *part[2];
+  int length[2];
+
+  // Get the number of characters in the frame
+  int size() const {
+    return length[0] + length[1];
+  }
+
+  // Get a character of the frame
+  //   i - from 0 to size() - 1
+  char operator[](int i) const {
+    return i < length[0] ? part[0][i] : part[1][i - length[0]];
+  }
+
+  // Copy the frame out
+  //   out - room for size() characters
+  void copyTo(char *out) const {
+    memcpy(out, part[0], length[0]);
+    memcpy(out + length[0], part[1], length[1]);
+  }
+};
+
+class FrameReader {
+
+  private:
+    static_assert((FRAMEREADER_SIZE & (FRAMEREADER_SIZE - 1)) == 0, "the ring has to be a power of two");
+
+    char ring[FRAMEREADER_SIZE];
+    // positions count up for ever, and are taken mod FRAMEREADER_SIZE
+    unsigned int head; // first character still needed
+    unsigned int scan; // first character not looked at yet
+    unsigned int tail; // where the next character goes
+    bool inFrame; // seen the STX of a frame starting at head
+
+    // Find a character between two positions
+    //   c - the character
+    //   from, to - where to look, to not included
+    //
+    // Returns:
+    //   its position, or to if it isn't there
+    unsigned int find(char c, unsigned int from, unsigned int to) const {
+      while (from != to) {
+        unsigned int start = from & (FRAMEREADER_SIZE - 1);
+        unsigned int n = to - from;
+        if (n > FRAMEREADER_SIZE - start) n = FRAMEREADER_SIZE - start;
+        const char *found = (const char*) memchr(ring + start, c, n);
+        if (found != NULL) return from + (found - (ring + start));
+        from += n;
+      }
+      return to;
+    }
+
+  public:
+    FrameReader() {
+      clear();
+    }
+
+    // Forget everything, e.g. for a new connection
+    void clear() {
+      head = scan = tail = 0;
+      inFrame = false;
+    }
+
+    // Get where the next characters received should go
+    //   p - set to the start of the room
+    //
+    // Returns:
+    //   how many characters can go there
+    int space(char *&p) {
+      unsigned int start = tail & (FRAMEREADER_SIZE - 1);
+      unsigned int room = FRAMEREADER_SIZE - (tail - head);
+      p = ring + start;
+      return room < FRAMEREADER_SIZE - start ? room : FRAMEREADER_SIZE - start;
+    }
+
+    // Say how many characters went where space() said
+    //   n - the number of characters
+    void wrote(int n) {
+      tail += n;
+    }
+
+    // Get the next complete frame
+    //   frame - set to the frame, without its STX and ETX
+    //
+    // Returns:
+    //   false if there isn't one yet
+    bool next(FrameView &frame) {
+      if (!inFrame) {
+        unsigned int stx = find(2, scan, tail);
+        if (stx == tail) {
+          head = scan = tail; // nothing but noise
+          return false;
+        }
+        head = scan = stx + 1;
+        inFrame = true;
+      }
+
+      unsigned int etx = find(3, scan, tail);
+      if (etx == tail) {
+        scan = tail;
+        if (tail - head == FRAMEREADER_SIZE) {
+          cerr << "FrameReader::next - frame too long for the ring, thrown away" << endl;
+          head = scan;
+          inFrame = false;
+        }
+        return false;
+      }
+
+      unsigned int start = head & (FRAMEREADER_SIZE - 1);
+      int length = etx - head;
+      frame.part[0] = ring + start;
+      frame.length[0] = length < (int) (FRAMEREADER_SIZE - start) ? length : FRAMEREADER_SIZE - start;
+      frame.part[1] = ring;
+      frame.length[1] = length - frame.length[0];
+
+      head = scan = etx + 1;
+      inFrame = false;
+      return true;
+    }
+
+};
+
+#endif
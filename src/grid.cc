@@ -0,0 +1,189 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "grid.h"
+#include <iostream>
+
+// a classic layer's occupancy has to fit in one word, and so does a column
+static_assert(CLASSIC_WIDTH * CLASSIC_DEPTH <= 32, "classic layer too big for LayerMask");
+static_assert(CLASSIC_MAX_HEIGHT <= 32, "classic arena too high for column words");
+static_assert(GRID_CHUNK_SIZE == 8, "chunk columns are kept in bytes");
+
+// widest and deepest arena, in cells (chunk keys have 10 bits each way)
+#define GRID_MAX_WIDTH (1024 * GRID_CHUNK_SIZE)
+
+// Empty every cell
+void GridCells<GRID_CLASSIC>::clear()
+{
+  for (int y = 0; y < CLASSIC_MAX_HEIGHT; y++) {
+    for (int c = 0; c < CLASSIC_WIDTH * CLASSIC_DEPTH; c++) ids[y][c] = 0;
+    occupied[y] = 0;
+    resting[y] = 0;
+  }
+
+  for (int c = 0; c < CLASSIC_WIDTH * CLASSIC_DEPTH; c++) {
+    columns[c] = 0;
+    restingColumns[c] = 0;
+  }
+}
+
+// Put a block id in a cell, making its chunk if need be
+//   x,y,z - the cell
+//   id - the block id
+//
+// Returns:
+//   the id that was resting in the cell, or 0
+int GridCells<GRID_CHUNKED>::set(int x, int y, int z, int id)
+{
+  shared_ptr<Chunk> &p = chunks[key(x, y, z)];
+  if (!p) p = make_shared<Chunk>(); // new chunks start empty
+  int cx = x % GRID_CHUNK_SIZE, cy = y % GRID_CHUNK_SIZE, cz = z % GRID_CHUNK_SIZE;
+  int replaced = (p->restingColumns[cx][cz] & (1 << cy)) ? p->ids[cx][cy][cz] : 0;
+  // collision trails set the same cells again and again, which needn't
+  // unshare the chunk
+  if ((p->columns[cx][cz] & (1 << cy)) && p->ids[cx][cy][cz] == id) return replaced;
+
+  Chunk &c = *write(p);
+  if (!(c.columns[cx][cz] & (1 << cy))) {
+    c.columns[cx][cz] |= 1 << cy;
+    c.count++;
+  }
+  c.ids[cx][cy][cz] = id;
+  return replaced;
+}
+
+// Mark an occupied cell as resting
+//   x,y,z - the cell, which must have been set
+//
+// Returns:
+//   true if the cell wasn't resting before
+bool GridCells<GRID_CHUNKED>::setResting(int x, int y, int z)
+{
+  unordered_map <unsigned int, shared_ptr<Chunk> >::iterator i = chunks.find(key(x, y, z));
+  if (i == chunks.end()) return 0;
+  int cx = x % GRID_CHUNK_SIZE, cy = y % GRID_CHUNK_SIZE, cz = z % GRID_CHUNK_SIZE;
+  if (i->second->restingColumns[cx][cz] & (1 << cy)) return false;
+  write(i->second)->restingColumns[cx][cz] |= 1 << cy;
+  return true;
+}
+
+// Empty a cell, freeing its chunk if that was the last cell in it
+//   x,y,z - the cell
+//
+// Returns:
+//   the id that was resting in the cell, or 0
+int GridCells<GRID_CHUNKED>::unset(int x, int y, int z)
+{
+  unordered_map <unsigned int, shared_ptr<Chunk> >::iterator i = chunks.find(key(x, y, z));
+  if (i == chunks.end()) return 0;
+
+  int cx = x % GRID_CHUNK_SIZE, cy = y % GRID_CHUNK_SIZE, cz = z % GRID_CHUNK_SIZE;
+  if (!(i->second->columns[cx][cz] & (1 << cy))) return 0;
+
+  Chunk &c = *write(i->second);
+  int restingId = (c.restingColumns[cx][cz] & (1 << cy)) ? c.ids[cx][cy][cz] : 0;
+  c.columns[cx][cz] &= ~(1 << cy);
+  c.restingColumns[cx][cz] &= ~(1 << cy);
+  c.ids[cx][cy][cz] = 0;
+  if (--c.count == 0) chunks.erase(i);
+  return restingId;
+}
+
+// Find the layer a cube dropped from a cell would land in, going down the
+// column a chunk at a time (empty chunks aren't stored, so are skipped)
+//   x,y,z - the cell
+//   restingOnly - only count resting cells
+int GridCells<GRID_CHUNKED>::getFloor(int x, int y, int z, bool restingOnly) const
+{
+  int cx = x % GRID_CHUNK_SIZE, cz = z % GRID_CHUNK_SIZE;
+  // the layers below y in y's own chunk, then whole chunks below that
+  unsigned int mask = (1u << (y % GRID_CHUNK_SIZE)) - 1;
+
+  for (int base = y - y % GRID_CHUNK_SIZE; base >= 0; base -= GRID_CHUNK_SIZE) {
+    const Chunk *c = find(x, base, z);
+    if (c != NULL) {
+      unsigned int below = (restingOnly ? c->restingColumns[cx][cz] : c->columns[cx][cz]) & mask;
+      if (below) return base + 32 - __builtin_clz(below);
+    }
+    mask = 0xff;
+  }
+
+  return 0;
+}
+
+// Find the next occupied cell above a cell, going up the column a chunk at
+// a time
+//   x,y,z - the cell
+//   height - the height of the grid
+//
+// Returns:
+//   the layer, or -1 if there's nothing above
+int GridCells<GRID_CHUNKED>::getAbove(int x, int y, int z, int height) const
+{
+  int cx = x % GRID_CHUNK_SIZE, cz = z % GRID_CHUNK_SIZE;
+  unsigned int mask = ~((2u << (y % GRID_CHUNK_SIZE)) - 1) & 0xff;
+
+  for (int base = y - y % GRID_CHUNK_SIZE; base < height; base += GRID_CHUNK_SIZE) {
+    const Chunk *c = find(x, base, z);
+    if (c != NULL) {
+      unsigned int above = c->columns[cx][cz] & mask;
+      if (above) return base + __builtin_ctz(above);
+    }
+    mask = 0xff;
+  }
+
+  return -1;
+}
+
+// CollisionGrid constructor, for the classic arena
+CollisionGrid::CollisionGrid()
+{
+  resize(GAMEAREA_WIDTH, GAMEAREA_HEIGHT, GAMEAREA_DEPTH);
+}
+
+// Change the size of the grid, emptying it. The classic size is stored as
+// words, anything else in chunks.
+//   w,h,d - the width, height and depth in cells
+void CollisionGrid::resize(int w, int h, int d)
+{
+  if (w < 1 || d < 1 || h < 1 || w > GRID_MAX_WIDTH || d > GRID_MAX_WIDTH || h > GRID_MAX_HEIGHT) {
+    cerr << "CollisionGrid::resize - unsupported size " << w << "x" << h << "x" << d << ", using the classic arena" << endl;
+    w = GAMEAREA_WIDTH, h = GAMEAREA_HEIGHT, d = GAMEAREA_DEPTH;
+  }
+
+  width = w, height = h, depth = d;
+  if (w == CLASSIC_WIDTH && d == CLASSIC_DEPTH && h <= CLASSIC_MAX_HEIGHT) storage = GRID_CLASSIC;
+  else storage = GRID_CHUNKED;
+
+  layerCount.assign(height, 0);
+  clear();
+}
+
+// Empty every cell
+void CollisionGrid::clear()
+{
+  classic.clear();
+  chunked.clear();
+
+  for (int y = 0; y < height; y++) layerCount[y] = 0;
+  completeLayers.reset();
+  newlyComplete.reset();
+  hash = 0;
+  poseHash = 0;
+}
@@ -0,0 +1,434 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * grid.h
+ *
+ * The collision grid: which block id is in each cell of the game area.
+ *
+ * The size of the game area is chosen at run time. The classic arena is
+ * CLASSIC_WIDTH by CLASSIC_DEPTH cells, and is stored so that every Y layer
+ * keeps an occupancy word with one bit per cell (bit x + z * CLASSIC_WIDTH).
+ * A block can then be tested against a whole layer with a shift and an AND
+ * rather than cell by cell. Each column (x, z) keeps the same occupancy the
+ * other way round, one bit per Y layer, so finding what is above or below a
+ * cell doesn't need a walk up or down the layers.
+ *
+ * Any other size is stored in chunks of GRID_CHUNK_SIZE cubed cells, made
+ * when something first goes in them and freed when they empty, so memory
+ * goes with how much of the arena is filled rather than its size. Within a
+ * chunk, each column keeps its occupancy as a byte. Copies of a grid share
+ * their chunks until one of them changes a chunk, when it takes its own
+ * copy of that chunk, so a copy (see snapshot.h) is cheap.
+ *
+ * The two kinds of storage are specialisations of GridCells, with the same
+ * calls, and the grid passes each call on to the one in use.
+ *
+ * Cells are either part of a block's collision trail while it moves, or
+ * where a block is resting. Each layer counts its resting cells as they come
+ * and go, and keeps a bit in the complete layers while it is full, so
+ * finding a complete layer doesn't need a scan of the blocks. Layers that
+ * become full are also noted as they do, for the game to take (see
+ * takeNewlyComplete) after blocks have moved, rather than looking at every
+ * layer on a timer. The resting
+ * cells are also kept per column, as a heightmap of what has landed, so
+ * where a block would land is found a column at a time (see getFloor)
+ * rather than by stepping it down.
+ *
+ * The grid also keeps a 64 bit Zobrist hash of its resting cells: the XOR
+ * of a key for each resting cell and the id of the block in it, updated as
+ * cells come and go. Since a resting block's cells give its pose, two grids
+ * with the same hash almost certainly have the same blocks landed in the
+ * same places, which peers can check in 8 bytes (see Client), and the hash
+ * can key a table of positions already looked at. The keys are made by
+ * mixing the cell and id rather than looked up, as arenas can be large.
+ * Alongside it the grid keeps the XOR of a key for the pose of each block
+ * that may still be falling, which the blocks fold in and out themselves
+ * as they move (see Block::hashPose), for Rules::hash.
+ */
+
+#ifndef _GRID_
+#define _GRID_
+
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// define the boundaries for the classic game area
+#define BOUNDARY_MIN_X -10.0
+#define BOUNDARY_MAX_X 10.0
+#define BOUNDARY_MIN_Z -10.0
+#define BOUNDARY_MAX_Z 10.0
+
+// define the starting height of the blocks in the classic game area
+#define BLOCK_START_Y 50.0
+
+// how many blocks can fit into the classic game?
+#define GAMEAREA_WIDTH ((int) (BOUNDARY_MAX_X - BOUNDARY_MIN_X) / 5 + 1)
+#define GAMEAREA_DEPTH ((int) (BOUNDARY_MAX_Z - BOUNDARY_MIN_Z) / 5 + 1)
+#define GAMEAREA_HEIGHT ((int) BLOCK_START_Y / 5 + 2)
+
+// arenas of this width and depth, and no higher than CLASSIC_MAX_HEIGHT,
+// are stored as layer and column words
+#define CLASSIC_WIDTH 5
+#define CLASSIC_DEPTH 5
+#define CLASSIC_MAX_HEIGHT 32
+
+// largest arena height, in layers
+#define GRID_MAX_HEIGHT 256
+// larger arenas are stored in chunks of this many cells each way
+#define GRID_CHUNK_SIZE 8
+
+// occupancy of one Y layer of the classic arena, one bit per cell
+typedef unsigned int LayerMask;
+
+// a set of Y layers, bit y for layer y
+typedef bitset <GRID_MAX_HEIGHT> LayerSet;
+
+#define LAYER_FULL ((LayerMask) ((1ULL << (CLASSIC_WIDTH * CLASSIC_DEPTH)) - 1))
+
+enum GridStorage { GRID_CLASSIC, GRID_CHUNKED };
+
+template <GridStorage> class GridCells;
+
+// The classic arena: a fixed array of cells, plus layer and column words
+template <> class GridCells<GRID_CLASSIC> {
+
+  private:
+    int ids[CLASSIC_MAX_HEIGHT][CLASSIC_WIDTH * CLASSIC_DEPTH];
+    LayerMask occupied[CLASSIC_MAX_HEIGHT];
+    LayerMask resting[CLASSIC_MAX_HEIGHT];
+    unsigned int columns[CLASSIC_WIDTH * CLASSIC_DEPTH]; // bit y set while occupied
+    unsigned int restingColumns[CLASSIC_WIDTH * CLASSIC_DEPTH]; // bit y set while resting
+
+  public:
+    void clear();
+
+    int getId(int x, int y, int z) const {
+      return ids[y][x + z * CLASSIC_WIDTH];
+    }
+
+    // Returns: the id that was resting in the cell, or 0
+    int set(int x, int y, int z, int id) {
+      int c = x + z * CLASSIC_WIDTH;
+      int replaced = (resting[y] & (1u << c)) ? ids[y][c] : 0;
+      ids[y][c] = id;
+      occupied[y] |= 1u << c;
+      columns[c] |= 1u << y;
+      return replaced;
+    }
+
+    // Returns: true if the cell wasn't resting before
+    bool setResting(int x, int y, int z) {
+      int c = x + z * CLASSIC_WIDTH;
+      if (resting[y] & (1u << c)) return false;
+      resting[y] |= 1u << c;
+      restingColumns[c] |= 1u << y;
+      return true;
+    }
+
+    // Returns: the id that was resting in the cell, or 0
+    int unset(int x, int y, int z) {
+      int c = x + z * CLASSIC_WIDTH;
+      int id = ids[y][c];
+      ids[y][c] = 0;
+      occupied[y] &= ~(1u << c);
+      columns[c] &= ~(1u << y);
+      if (!(resting[y] & (1u << c))) return 0;
+      resting[y] &= ~(1u << c);
+      restingColumns[c] &= ~(1u << y);
+      return id;
+    }
+
+    int getFloor(int x, int y, int z, bool restingOnly) const {
+      int c = x + z * CLASSIC_WIDTH;
+      unsigned int below = (restingOnly ? restingColumns[c] : columns[c]) & ((1u << y) - 1);
+      return below ? 32 - __builtin_clz(below) : 0;
+    }
+
+    int getAbove(int x, int y, int z) const {
+      unsigned int above = columns[x + z * CLASSIC_WIDTH] & ~((2u << y) - 1);
+      return above ? __builtin_ctz(above) : -1;
+    }
+
+    LayerMask getLayer(int y) const {
+      return occupied[y];
+    }
+
+};
+
+// Any other arena: chunks of cells, kept in a hash table by chunk position
+template <> class GridCells<GRID_CHUNKED> {
+
+  private:
+    struct Chunk {
+      int ids[GRID_CHUNK_SIZE][GRID_CHUNK_SIZE][GRID_CHUNK_SIZE]; // [x][y][z]
+      unsigned char columns[GRID_CHUNK_SIZE][GRID_CHUNK_SIZE]; // [x][z], bit y set while occupied
+      unsigned char restingColumns[GRID_CHUNK_SIZE][GRID_CHUNK_SIZE];
+      int count; // occupied cells
+    };
+
+    // chunks are shared with copies of the grid until written to
+    unordered_map <unsigned int, shared_ptr<Chunk> > chunks;
+
+    // chunks are keyed by their position, 10 bits each way
+    static unsigned int key(int x, int y, int z) {
+      return ((unsigned int) (x / GRID_CHUNK_SIZE) << 20) | ((unsigned int) (y / GRID_CHUNK_SIZE) << 10) |
+        (unsigned int) (z / GRID_CHUNK_SIZE);
+    }
+
+    const Chunk *find(int x, int y, int z) const {
+      unordered_map <unsigned int, shared_ptr<Chunk> >::const_iterator i = chunks.find(key(x, y, z));
+      return i == chunks.end() ? NULL : i->second.get();
+    }
+
+    // Find a chunk to change, taking a copy of it first if it's shared
+    Chunk *write(shared_ptr<Chunk> &c) {
+      if (c.use_count() > 1) c = make_shared<Chunk>(*c);
+      return c.get();
+    }
+
+  public:
+    void clear() {
+      chunks.clear();
+    }
+
+    int getId(int x, int y, int z) const {
+      const Chunk *c = find(x, y, z);
+      return c == NULL ? 0 : c->ids[x % GRID_CHUNK_SIZE][y % GRID_CHUNK_SIZE][z % GRID_CHUNK_SIZE];
+    }
+
+    int set(int x, int y, int z, int id);
+    bool setResting(int x, int y, int z);
+    int unset(int x, int y, int z);
+    int getFloor(int x, int y, int z, bool restingOnly) const;
+    int getAbove(int x, int y, int z, int height) const;
+
+    // Get the number of chunks in use
+    int getChunks() const {
+      return chunks.size();
+    }
+
+};
+
+class CollisionGrid {
+
+  private:
+    int width, height, depth;
+    GridStorage storage;
+    GridCells<GRID_CLASSIC> classic;
+    GridCells<GRID_CHUNKED> chunked;
+    vector <int> layerCount; // number of resting cells
+    LayerSet completeLayers; // layers that are full
+    LayerSet newlyComplete; // layers that have become full since takeNewlyComplete()
+    unsigned long long hash; // of the resting cells (see getHash)
+    unsigned long long poseHash; // of the falling blocks' poses (see togglePose)
+
+    // Get the Zobrist key of a block id resting in a cell
+    //   x,y,z - the cell
+    //   id - the block id
+    static unsigned long long zobrist(int x, int y, int z, int id) {
+      // splitmix64 of the cell and id together
+      unsigned long long k = (((unsigned long long) x << 13 | z) << 8 | y) * 0x9e3779b97f4a7c15ULL ^ (unsigned int) id;
+      k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      k = (k ^ (k >> 27)) * 0x94d049bb133111ebULL;
+      return k ^ (k >> 31);
+    }
+
+  public:
+    CollisionGrid();
+
+    void resize(int, int, int);
+    void clear();
+
+    // Get the size of the grid, in cells
+    int getWidth() const {
+      return width;
+    }
+
+    int getHeight() const {
+      return height;
+    }
+
+    int getDepth() const {
+      return depth;
+    }
+
+    // Is the grid the classic arena, with layer words (see getLayer)?
+    bool getClassic() const {
+      return storage == GRID_CLASSIC;
+    }
+
+    // Is a cell inside the grid?
+    //   x,y,z - the cell
+    bool inside(int x, int y, int z) const {
+      return x >= 0 && y >= 0 && z >= 0 && x < width && y < height && z < depth;
+    }
+
+    // Get the bit for a cell in a classic layer's occupancy word
+    //   x,z - the cell
+    static LayerMask bit(int x, int z) {
+      return 1u << (x + z * CLASSIC_WIDTH);
+    }
+
+    // Move a layer word made relative to a low corner (as a block's
+    // footprint) to a place in a classic layer, dropping any columns that
+    // fall outside it (rows outside it are shifted out)
+    //   m - the layer word
+    //   columns - the bits of each x column of m
+    //   width - the number of x columns
+    //   cellX,cellZ - the grid cell for the low corner
+    static LayerMask place(LayerMask m, const LayerMask columns[], int width, int cellX, int cellZ) {
+      unsigned long long placed = m;
+      int shift = cellX + cellZ * CLASSIC_WIDTH;
+
+      for (int col = 0; col < width; col++)
+        if (cellX + col < 0 || cellX + col >= CLASSIC_WIDTH) placed &= ~columns[col];
+
+      if (shift >= 64 || shift <= -64) return 0;
+      if (shift >= 0) placed <<= shift;
+      else placed >>= -shift;
+
+      return (LayerMask) (placed & LAYER_FULL);
+    }
+
+    // Get the id of the block in a cell (0 if empty)
+    //   x,y,z - the cell, which must be inside the grid
+    int getId(int x, int y, int z) const {
+      return storage == GRID_CLASSIC ? classic.getId(x, y, z) : chunked.getId(x, y, z);
+    }
+
+    // Put a block id in a cell as part of its collision trail (a cell that
+    // is already resting stays resting)
+    //   x,y,z - the cell, which must be inside the grid
+    //   id - the block id
+    void set(int x, int y, int z, int id) {
+      int replaced = storage == GRID_CLASSIC ? classic.set(x, y, z, id) : chunked.set(x, y, z, id);
+      if (replaced && replaced != id) hash ^= zobrist(x, y, z, replaced) ^ zobrist(x, y, z, id);
+    }
+
+    // Put a block id in a cell where the block is resting
+    //   x,y,z - the cell, which must be inside the grid
+    //   id - the block id
+    void setResting(int x, int y, int z, int id) {
+      set(x, y, z, id);
+      bool added = storage == GRID_CLASSIC ? classic.setResting(x, y, z) : chunked.setResting(x, y, z);
+      if (!added) return;
+      hash ^= zobrist(x, y, z, id);
+      if (++layerCount[y] == width * depth) {
+        completeLayers.set(y);
+        newlyComplete.set(y);
+      }
+    }
+
+    // Empty a cell
+    //   x,y,z - the cell, which must be inside the grid
+    void unset(int x, int y, int z) {
+      int restingId = storage == GRID_CLASSIC ? classic.unset(x, y, z) : chunked.unset(x, y, z);
+      if (restingId) {
+        layerCount[y]--;
+        completeLayers.reset(y);
+        newlyComplete.reset(y);
+        hash ^= zobrist(x, y, z, restingId);
+      }
+    }
+
+    // Get the occupancy word for a layer of the classic arena
+    //   y - the layer, which must be inside the grid
+    LayerMask getLayer(int y) const {
+      return storage == GRID_CLASSIC ? classic.getLayer(y) : 0;
+    }
+
+    // Get the layer a cube dropped straight down from a cell would land in:
+    // just above the highest cell below it in the column, or 0 on the floor
+    //   x,y,z - the cell, which must be inside the grid
+    //   restingOnly - only count resting cells, not collision trails
+    int getFloor(int x, int y, int z, bool restingOnly) const {
+      return storage == GRID_CLASSIC ? classic.getFloor(x, y, z, restingOnly) : chunked.getFloor(x, y, z, restingOnly);
+    }
+
+    // Find the next occupied cell above a cell in its column
+    //   x,y,z - the cell, which must be inside the grid
+    //
+    // Returns:
+    //   the layer, or -1 if there's nothing above
+    int getAbove(int x, int y, int z) const {
+      return storage == GRID_CLASSIC ? classic.getAbove(x, y, z) : chunked.getAbove(x, y, z, height);
+    }
+
+    // Get the number of resting cells in a layer
+    //   y - the layer, which must be inside the grid
+    int getLayerCount(int y) const {
+      return layerCount[y];
+    }
+
+    // Get the layers that are full of resting cells
+    const LayerSet &getCompleteLayers() const {
+      return completeLayers;
+    }
+
+    // Get the layers that have become full since the last call, and start
+    // noting them again
+    //
+    // Returns:
+    //   the layers, which are still full
+    LayerSet takeNewlyComplete() {
+      LayerSet layers = newlyComplete;
+      newlyComplete.reset();
+      return layers;
+    }
+
+    // Get the Zobrist hash of the resting cells (0 when there are none)
+    unsigned long long getHash() const {
+      return hash;
+    }
+
+    // Get the key for the pose of a block that may be falling
+    //   id - the block id
+    //   orientation - its resting orientation
+    //   x,y,z - its cell
+    static unsigned long long poseKey(int id, int orientation, int x, int y, int z) {
+      // splitmix64 of the id and pose (as zobrist)
+      unsigned long long k = (unsigned int) id;
+      k = k << 5 | orientation;
+      k = k << 12 | (x & 0xfff);
+      k = k << 12 | (y & 0xfff);
+      k = (k << 12 | (z & 0xfff)) * 0x9e3779b97f4a7c15ULL;
+      k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      k = (k ^ (k >> 27)) * 0x94d049bb133111ebULL;
+      return k ^ (k >> 31);
+    }
+
+    // Fold a pose key into the falling blocks' hash, or take it out again
+    //   key - the key (see poseKey)
+    void togglePose(unsigned long long key) {
+      poseHash ^= key;
+    }
+
+    // Get the XOR of the pose keys folded in (0 when there are none)
+    unsigned long long getPoseHash() const {
+      return poseHash;
+    }
+
+};
+
+#endif
@@ -27,8 +27,9 @@ Human::Human(float setX, float setY, float setZ, float setAngleY, int t, int tex
   lastAmountX = 0.0, lastAmountY = 0.0, lastAmountZ = 0.0;
   anim = false;
   connectionErrorCount = 0;
-  locked = -1; // nothing locked
+  locked = NO_BLOCK; // nothing locked
   texFace = texFaceInit;
+  storeLast();
 }
 
 void Human::setTargetX(const float n)
@@ -56,12 +57,12 @@ void Human::setTargetAngleY(const float n)
   targetAngleY = n;
 }
 
-void Human::setLocked(int n)
+void Human::setLocked(BlockHandle n)
 {
   locked = n;
 }
 
-int Human::getLocked()
+BlockHandle Human::getLocked()
 {
   return locked;
 }
@@ -138,7 +139,7 @@ void Human::draw(vector <int>& texId, int texMain)
 {
 
   glPushMatrix();
-  glTranslatef(x, y, z);
+  glTranslatef(getDrawX(), getDrawY(), getDrawZ());
   glRotatef(angleY, 0.0, 1.0, 0.0);
   glRotatef(-angleX, 1.0, 0.0, 0.0);
 
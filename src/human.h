@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include "pawn.h"
+#include "blockpool.h"
 
 using namespace std;
 
@@ -43,7 +44,7 @@ class Human : public Pawn {
     float lastAmountX, lastAmountY, lastAmountZ;
     int connectionErrorCount;
     bool anim;
-    int locked; // which block is locked
+    BlockHandle locked; // which block is locked
     int texFace;
 
   protected:
@@ -56,8 +57,8 @@ class Human : public Pawn {
     void setTargetAngleX(const float);
     void setTargetAngleY(const float);
 
-    void setLocked(int);
-    int getLocked();
+    void setLocked(BlockHandle);
+    BlockHandle getLocked();
 
     void setTexFace(int);
 
@@ -0,0 +1,180 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * orientation.h
+ *
+ * Block shapes and the 24 orientations a block can rest in.
+ *
+ * Blocks only ever turn in 90 degree steps, so a resting orientation is one
+ * of the 24 rotations of a cube. Each is stored as an integer 3x3 matrix
+ * (one +/-1 per row and column), and the cube offsets of every block type in
+ * every orientation are worked out at compile time. Finding where a resting
+ * block's cubes are is then a table lookup plus an add, with no rounding.
+ */
+
+#ifndef _ORIENTATION_
+#define _ORIENTATION_
+
+// block data is a 5x5x5 grid of cubes
+#define BLOCK_DATA_SIZE 5
+// the largest block shapes are made of four cubes
+#define BLOCK_MAX_CUBES 4
+// number of block types (see Block::setType)
+#define BLOCK_TYPES 8
+// number of rotations of a cube
+#define ORIENTATIONS 24
+
+// A cell in block data or in the collision array
+struct Cell {
+  int x, y, z;
+};
+
+// The cubes making up a block type, in the same x, y, z order as the bits
+// of Block's shape mask, and the cube it turns about
+struct BlockShape {
+  int numCubes;
+  Cell cubes[BLOCK_MAX_CUBES];
+  Cell pivot;
+};
+
+constexpr BlockShape BLOCK_SHAPES[BLOCK_TYPES] = {
+  { 1, { {0, 0, 0} }, {0, 0, 0} }, // single cube
+  { 4, { {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1} }, {0, 0, 0} }, // corner block
+  { 4, { {0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {0, 0, 1} }, {1, 0, 0} }, // L shape
+  { 4, { {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 1, 1} }, {0, 0, 0} }, // kind of S shape
+  { 4, { {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 0, 1} }, {0, 0, 0} }, // other kind of S shape
+  { 4, { {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {2, 1, 0} }, {1, 0, 0} }, // Z shape
+  { 4, { {0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {1, 1, 0} }, {1, 0, 0} }, // T shape
+  { 3, { {0, 0, 0}, {1, 0, 0}, {0, 1, 0} }, {0, 0, 0} } // small L shape
+};
+
+struct OrientationTables {
+  // rotation matrices, row major, world = R * local
+  int rotation[ORIENTATIONS][9];
+  // cube offsets from the block's position, in cells, for each orientation
+  Cell cells[BLOCK_TYPES][ORIENTATIONS][BLOCK_MAX_CUBES];
+};
+
+// Build the rotation group and the rotated cube offsets of every block type
+constexpr OrientationTables makeOrientationTables()
+{
+  OrientationTables t = {};
+  const int perms[6][3] = { {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0} };
+  const int permSign[6] = { 1, -1, -1, 1, 1, -1 };
+  int n = 0;
+
+  // every signed permutation matrix with determinant +1 is a rotation;
+  // the identity comes first so orientation 0 is unrotated
+  for (int p = 0; p < 6; p++) {
+    for (int signs = 0; signs < 8; signs++) {
+      int det = permSign[p];
+      for (int row = 0; row < 3; row++) if (signs & (1 << row)) det = -det;
+      if (det != 1) continue;
+
+      for (int i = 0; i < 9; i++) t.rotation[n][i] = 0;
+      for (int row = 0; row < 3; row++)
+        t.rotation[n][row * 3 + perms[p][row]] = (signs & (1 << row)) ? -1 : 1;
+      n++;
+    }
+  }
+
+  // rotate each cube about the pivot: offset = pivot + R * (cube - pivot)
+  for (int type = 0; type < BLOCK_TYPES; type++) {
+    const BlockShape &s = BLOCK_SHAPES[type];
+    for (int o = 0; o < ORIENTATIONS; o++) {
+      const int *r = t.rotation[o];
+      for (int i = 0; i < s.numCubes; i++) {
+        int dx = s.cubes[i].x - s.pivot.x, dy = s.cubes[i].y - s.pivot.y, dz = s.cubes[i].z - s.pivot.z;
+        t.cells[type][o][i].x = s.pivot.x + r[0] * dx + r[1] * dy + r[2] * dz;
+        t.cells[type][o][i].y = s.pivot.y + r[3] * dx + r[4] * dy + r[5] * dz;
+        t.cells[type][o][i].z = s.pivot.z + r[6] * dx + r[7] * dy + r[8] * dz;
+      }
+    }
+  }
+
+  return t;
+}
+
+class Orientation {
+
+  private:
+    static constexpr OrientationTables tables = makeOrientationTables();
+
+  public:
+
+    // Get the offset of a cube from the block's position, in cells
+    //   type - the block type
+    //   o - the orientation
+    //   slot - which of the type's cubes (index into BLOCK_SHAPES cubes)
+    static Cell cell(int type, int o, int slot) {
+      return tables.cells[type][o][slot];
+    }
+
+    // Get an element of an orientation's rotation matrix
+    //   o - the orientation
+    //   row,col - the element
+    static int rotation(int o, int row, int col) {
+      return tables.rotation[o][row * 3 + col];
+    }
+
+    // Find which of a block type's cubes is at a position in block data
+    //   type - the block type
+    //   x,y,z - the position in block data
+    //
+    // Returns:
+    //   the slot, or -1 if the type has no cube there
+    static int slot(int type, int x, int y, int z) {
+      const BlockShape &s = BLOCK_SHAPES[type];
+      for (int i = 0; i < s.numCubes; i++) {
+        if (s.cubes[i].x == x && s.cubes[i].y == y && s.cubes[i].z == z) return i;
+      }
+      return -1;
+    }
+
+    // Find the orientation closest to the rotation part of a matrix
+    //   m - a column-major 4x4 matrix
+    static int fromMatrix(const float m[16]) {
+      int best = 0;
+      float bestDot = -10.0;
+      for (int o = 0; o < ORIENTATIONS; o++) {
+        float dot = 0.0;
+        for (int row = 0; row < 3; row++)
+          for (int col = 0; col < 3; col++)
+            dot += tables.rotation[o][row * 3 + col] * m[col * 4 + row];
+        if (dot > bestDot) best = o, bestDot = dot;
+      }
+      return best;
+    }
+
+    // Fill a matrix with an orientation's exact rotation
+    //   o - the orientation
+    //   m - the column-major 4x4 matrix to fill (translation is zeroed)
+    static void toMatrix(int o, float m[16]) {
+      for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+          if (row < 3 && col < 3) m[col * 4 + row] = tables.rotation[o][row * 3 + col];
+          else m[col * 4 + row] = (row == col) ? 1.0 : 0.0;
+        }
+      }
+    }
+
+};
+
+#endif
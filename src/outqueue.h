@@ -0,0 +1,203 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * outqueue.h
+ *
+ * The messages waiting to go out to one client of the server.
+ *
+ * Messages are queued whole, and sent with as many as fit in one sendmsg().
+ * A send that is cut short carries on from the same byte next time.
+ *
+ * Each message has a policy:
+ *   OUTQUEUE_KEEP - always sent (events: locks, moves, new blocks...)
+ *   OUTQUEUE_MERGE - state that the next one of the same key replaces
+ *                    (a player's position), so a newer one takes the place
+ *                    of one still waiting, at the back of the queue
+ *   OUTQUEUE_MERGE_OR_DROP - as MERGE, but dropped while the queue is
+ *                            congested, for state that is sent again anyway
+ *
+ * The queue is congested from when it goes over OUTQUEUE_HIGH_WATER bytes
+ * until it drains to OUTQUEUE_LOW_WATER. It's never allowed past
+ * OUTQUEUE_MAX_BYTES; a client that far behind can't catch up, and push()
+ * says so.
+ */
+
+#ifndef _OUTQUEUE_
+#define _OUTQUEUE_
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define OUTQUEUE_KEEP 0
+#define OUTQUEUE_MERGE 1
+#define OUTQUEUE_MERGE_OR_DROP 2
+
+#define OUTQUEUE_LOW_WATER 4096
+#define OUTQUEUE_HIGH_WATER 16384
+#define OUTQUEUE_MAX_BYTES 65536
+// most messages handed to one sendmsg()
+#define OUTQUEUE_IOVECS 64
+
+using namespace std;
+
+class OutQueue {
+
+  private:
+    struct Message {
+      string data; // empty once replaced by a newer one
+      string key; // for merging, or empty
+    };
+
+    deque <Message> messages; // oldest first
+    long long firstSeq; // sequence number of the front message
+    int frontSent; // bytes of the front message already sent
+    int bytes; // bytes still to send
+    bool congested;
+    unordered_map <string, long long> newest; // key to its latest waiting message
+
+    // Take the front message off the queue
+    void pop() {
+      unordered_map <string, long long>::iterator k = newest.find(messages.front().key);
+      if (k != newest.end() && k->second == firstSeq) newest.erase(k);
+      messages.pop_front();
+      firstSeq++;
+      frontSent = 0;
+    }
+
+  public:
+    OutQueue() {
+      firstSeq = 0;
+      frontSent = 0;
+      bytes = 0;
+      congested = false;
+    }
+
+    // Queue a message
+    //   data - the message
+    //   length - number of bytes
+    //   policy - OUTQUEUE_KEEP, OUTQUEUE_MERGE or OUTQUEUE_MERGE_OR_DROP
+    //   key - which messages this one replaces, for the merge policies
+    //
+    // Returns:
+    //   false if the queue would go over OUTQUEUE_MAX_BYTES (nothing is queued)
+    bool push(const char *data, int length, int policy, const string &key) {
+      if (policy == OUTQUEUE_MERGE_OR_DROP && congested) return true;
+
+      long long replace = -1;
+      if (policy != OUTQUEUE_KEEP) {
+        unordered_map <string, long long>::iterator k = newest.find(key);
+        // a message that is partly sent has to be finished
+        if (k != newest.end() && (k->second > firstSeq || frontSent == 0)) replace = k->second;
+      }
+
+      int freed = replace >= 0 ? messages[replace - firstSeq].data.size() : 0;
+      if (bytes - freed + length > OUTQUEUE_MAX_BYTES) return false;
+
+      if (replace >= 0) messages[replace - firstSeq].data.clear();
+      bytes += length - freed;
+
+      Message m;
+      m.data.assign(data, length);
+      if (policy != OUTQUEUE_KEEP) {
+        m.key = key;
+        newest[key] = firstSeq + messages.size();
+      }
+      messages.push_back(m);
+
+      if (bytes > OUTQUEUE_HIGH_WATER) congested = true;
+      return true;
+    }
+
+    // Send as much as the socket will take
+    //   sock - a non-blocking socket
+    //
+    // Returns:
+    //   the number of bytes sent if everything went, or -1 for an error,
+    //   which is EAGAIN when the socket filled up first (what it took is
+    //   off the queue either way)
+    int send(int sock) {
+      int total = 0;
+
+      while (bytes > 0) {
+        struct iovec iov[OUTQUEUE_IOVECS];
+        int n = 0;
+        for (int i = 0; i < (int) messages.size() && n < OUTQUEUE_IOVECS; i++) {
+          const string &d = messages[i].data;
+          int skip = i == 0 ? frontSent : 0;
+          if ((int) d.size() <= skip) continue;
+          iov[n].iov_base = (void*) (d.data() + skip);
+          iov[n].iov_len = d.size() - skip;
+          n++;
+        }
+
+        struct msghdr msg = msghdr();
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        int sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (sent == -1) {
+          if (errno == EINTR) continue;
+          break;
+        }
+
+        total += sent;
+        bytes -= sent;
+        // take off what has gone, and the replaced messages in among it
+        while (messages.size() > 0) {
+          int left = messages.front().data.size() - frontSent;
+          if (sent < left) {
+            frontSent += sent;
+            break;
+          }
+          sent -= left;
+          pop();
+        }
+      }
+
+      while (messages.size() > 0 && messages.front().data.size() == 0) pop();
+      if (bytes <= OUTQUEUE_LOW_WATER) congested = false;
+      return bytes > 0 ? -1 : total;
+    }
+
+    // Forget everything waiting
+    void clear() {
+      messages.clear();
+      newest.clear();
+      firstSeq = 0;
+      frontSent = 0;
+      bytes = 0;
+      congested = false;
+    }
+
+    // Get the number of bytes waiting to be sent
+    int size() const {
+      return bytes;
+    }
+
+    bool isCongested() const {
+      return congested;
+    }
+
+};
+
+#endif
@@ -21,11 +21,14 @@
 
 using namespace std;
 
+float Pawn::drawAlpha = 1.0;
+
 Pawn::Pawn()
 {
   id = 0;
   angleX = 0.0, angleY = 0.0, angleZ = 0.0, turnSpeed = 0.6 * GAME_SPEED;
   x = 0.0, y = 0.0, z = 0.0;
+  lastX = 0.0, lastY = 0.0, lastZ = 0.0;
   ground = 0, height = 24, ceil = height;
   speedX = 0.0, speedY = 0.0, speedZ = 0.0;
   pushX = 0.0, pushY = 0.0, pushZ = 0.0;
@@ -33,11 +36,7 @@ Pawn::Pawn()
   strafeRightSpeed = 0.0; // for strafe left use negative speed
   resistance = 0.02 * GAME_SPEED;
   friction = 0.02 * GAME_SPEED;
-  pointHeight.clear();
-  pointHeight.push_back(0);
-  pointHeight.push_back(0);
-  pointHeight.push_back(0);
-  pointHeight.push_back(0);
+  for (int i = 0; i < 4; i++) pointHeight[i] = 0;
 }
 
 float Pawn::getX() const
@@ -55,6 +54,23 @@ float Pawn::getZ() const
   return z;
 }
 
+// Get the position to draw at, between the start of the tick and now (see
+// setDrawAlpha)
+float Pawn::getDrawX() const
+{
+  return lastX + (x - lastX) * drawAlpha;
+}
+
+float Pawn::getDrawY() const
+{
+  return lastY + (y - lastY) * drawAlpha;
+}
+
+float Pawn::getDrawZ() const
+{
+  return lastZ + (z - lastZ) * drawAlpha;
+}
+
 float Pawn::getAngleX() const
 {
   return angleX;
@@ -259,18 +275,14 @@ void Pawn::lockPosition(float oldX, float oldY, float oldZ, float oldGround)
 
 void Pawn::moveLeft( const float amount )
 {
-  //x += amount * Trig::sn(angleY-90);
-  //z += amount * Trig::cs(angleY-90);
-  x += amount * sin((angleY-90) / 180.0 * 3.14);
-  z += amount * cos((angleY-90) / 180.0 * 3.14);
+  x += amount * Trig::sn(angleY-90);
+  z += amount * Trig::cs(angleY-90);
 }
 
 void Pawn::moveRight( const float amount )
 {
-  //x += amount * Trig::sn(angleY+90);
-  //z += amount * Trig::cs(angleY+90);
-  x += amount * sin((angleY+90) / 180.0 * 3.14);
-  z += amount * cos((angleY+90) / 180.0 * 3.14);
+  x += amount * Trig::sn(angleY+90);
+  z += amount * Trig::cs(angleY+90);
 }
 
 void Pawn::move( const float timeSecs )
@@ -280,8 +292,11 @@ void Pawn::move( const float timeSecs )
 {
   float oldX = x, oldY = y, oldZ = z;
 
-  speedX = speed * Trig::sn(angleY) + strafeRightSpeed * Trig::sn(angleY-90);
-  speedZ = speed * Trig::cs(angleY) + strafeRightSpeed * Trig::cs(angleY-90);
+  // sin(a - 90) = -cos(a) and cos(a - 90) = sin(a), so one sincos does
+  float s, c;
+  Trig::sinCos(&angleY, &s, &c, 1);
+  speedX = speed * s - strafeRightSpeed * c;
+  speedZ = speed * c + strafeRightSpeed * s;
   
   //doFriction(speedX, speedY, speedZ);
 
@@ -303,6 +318,20 @@ void Pawn::move( const float timeSecs )
   lockPosition(oldX, oldY, oldZ, ground);
 }
 
+// Remember the position at the start of a simulation tick, to draw from
+void Pawn::storeLast()
+{
+  lastX = x, lastY = y, lastZ = z;
+}
+
+// Set how far between the last tick and the next pawns are drawn, for
+// smooth movement while the simulation runs at a fixed rate
+//   alpha - from 0 (at the last tick) to 1 (at the position now)
+void Pawn::setDrawAlpha( const float alpha )
+{
+  drawAlpha = alpha;
+}
+
 void Pawn::resetDistanceMoved()
 {
   distanceMoved = 0.0;
@@ -30,7 +30,6 @@
 #ifndef _PAWN_
 #define _PAWN_
 
-#include <GL/glut.h>
 #include <stdlib.h>
 #include <cmath>
 #include <iostream>
@@ -56,10 +55,12 @@ using namespace std;
 
 class Pawn {
   private:
+    static float drawAlpha; // how far between the last tick and this one to draw
 
   protected:
     int id;
     float x, y, z;
+    float lastX, lastY, lastZ; // position at the start of the tick
     float angleX, angleY, angleZ;
     float turnSpeed;
     float speedX, speedY, speedZ;
@@ -67,7 +68,7 @@ class Pawn {
     float speed, accel, maxSpeed, strafeRightSpeed;
     float pushX, pushY, pushZ;
     float friction, resistance;
-    vector <float> pointHeight;
+    float pointHeight[4]; // fixed size so copying a pawn doesn't allocate
     float distanceMoved;
       
     void toTarget( float&, float, float );
@@ -80,6 +81,9 @@ class Pawn {
     float getX() const;
     float getY() const;
     float getZ() const;
+    float getDrawX() const;
+    float getDrawY() const;
+    float getDrawZ() const;
     float getAngleX() const;
     float getAngleY() const;
     float getAngleZ() const;
@@ -111,6 +115,9 @@ class Pawn {
     void moveRight( const float );
     void move( const float timeSecs );
 
+    void storeLast();
+    static void setDrawAlpha( const float );
+
     void resetDistanceMoved();
     float getDistanceMoved();
 };
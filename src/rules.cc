@@ -0,0 +1,167 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <algorithm>
+#include <utility>
+#include "rules.h"
+
+// Make a new block at the top of the arena, in the middle
+//   blocks - the game blocks
+//   blockId - the id for the new block, moved on to the next
+//   type - the type of block
+//   startY - the height it starts at
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//
+// Returns:
+//   the new block's handle, or NO_BLOCK if the pool is full
+BlockHandle Rules::newBlock(BlockPool &blocks, int &blockId, int type, float startY, CollisionGrid &grid, float boundaries[])
+{
+  return blocks.create(blockId++, type, 0, startY, 0, true, grid, boundaries);
+}
+
+// Move every block on to where it should be this tick
+//   blocks - the game blocks
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//
+// Returns:
+//   true if a block has got stuck at the top (game over)
+bool Rules::moveBlocks(BlockPool &blocks, CollisionGrid &grid, float boundaries[])
+{
+  bool over = false;
+  for (int i = 0; i < blocks.size(); i++) {
+    blocks[i].move(boundaries, grid);
+    if (blocks[i].getGameOver()) over = true;
+  }
+  return over;
+}
+
+// Move every block that isn't grounded down a layer. Only blocks in the
+// active list can be falling; any that have been grounded since last time
+// drop out of it here.
+//   blocks - the game blocks
+//   paused - leave the blocks where they are
+void Rules::gravity(BlockPool &blocks, bool paused)
+{
+  for (int i = 0; i < blocks.getActiveSize(); ) {
+    Block &block = blocks.getActive(i);
+    if (block.getGrounded()) {
+      blocks.removeActive(i); // the last active block takes its place
+      continue;
+    }
+    if (!block.getMoving() && !block.getTurning()) {
+      if (!paused) block.setTargetPosition(block.getX(), block.getY()-5, block.getZ());
+    }
+    i++;
+  }
+}
+
+// Take complete layers out, going through all blocks once. Blocks that are
+// broken up are replaced by their fragments (handles to them stop finding
+// anything), and everything is ungrounded to fall into the gaps.
+//   blocks - the game blocks
+//   layers - the layers to take out
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//   blockId - the id for the next new block, moved on past any fragments
+void Rules::removeLayers(BlockPool &blocks, const LayerSet &layers, CollisionGrid &grid, float boundaries[], int &blockId)
+{
+  vector <Block> fragments;
+
+  for (int i = 0; i < blocks.size(); ) {
+    blocks.unGround(blocks.handle(i));
+    if (blocks[i].removeLayers(layers, fragments, grid, boundaries, blockId)) {
+      blocks.destroy(blocks.handle(i)); // the last block takes its place, so look at i again
+    }else{
+      i++; // the current block is ok to continue with
+    }
+  }
+
+  for (int i = 0; i < (int) fragments.size(); i++) blocks.create(std::move(fragments[i]));
+}
+
+// Drop every falling block to where gravity would leave it, in one go.
+// Blocks are dropped lowest first, so each one lands on the ones below it
+// that have already settled. A block can only be held up by one that is
+// lower than it, except where blocks overhang each other, so the pass is
+// repeated until nothing moves (usually once more, to confirm). Blocks
+// being moved or turned are left where they are.
+//   blocks - the game blocks
+//   grid - the collision grid
+//   boundaries - the game area boundaries
+//
+// Returns:
+//   the number of blocks that fell
+int Rules::settle(BlockPool &blocks, CollisionGrid &grid, float boundaries[])
+{
+  // the active blocks with their lowest cells, bottom up
+  vector < pair<int, Block*> > order;
+  for (int i = 0; i < blocks.getActiveSize(); i++) {
+    Block &block = blocks.getActive(i);
+    if (block.getGrounded() || block.getMoving() || block.getTurning()) continue;
+    Cell cells[BLOCK_MAX_CUBES];
+    int n = block.getCells(cells, grid, boundaries);
+    int lowest = grid.getHeight();
+    for (int j = 0; j < n; j++) if (cells[j].y < lowest) lowest = cells[j].y;
+    order.push_back(make_pair(lowest, &block));
+  }
+  stable_sort(order.begin(), order.end(),
+    [](const pair<int, Block*> &a, const pair<int, Block*> &b) { return a.first < b.first; });
+
+  // each pass that moves anything moves a block down at least a layer, so
+  // this can't go round for ever
+  vector <bool> fell(order.size(), false);
+  for (bool moved = true; moved; ) {
+    moved = false;
+    for (int i = 0; i < (int) order.size(); i++) {
+      if (order[i].second->drop(grid, boundaries) > 0) fell[i] = true, moved = true;
+    }
+  }
+
+  return count(fell.begin(), fell.end(), true);
+}
+
+// Score a completed layer: more if another was completed not long before
+//   bonusCount - countdowns left in which another layer earns the extra,
+//                counted down by the caller and reset here
+//
+// Returns:
+//   the points scored
+int Rules::scoreLayer(int &bonusCount)
+{
+  int points = RULES_LAYER_POINTS;
+  if (bonusCount > 0) points += RULES_BONUS_POINTS; // got another layer too
+  bonusCount = RULES_BONUS_CHECKS;
+  return points;
+}
+
+// Hash the state of the game: the grid's hash of the resting cells, and a
+// key for each block that may be falling, from its id, its cell and its
+// resting orientation. Both are kept as cells and blocks change (see
+// Block::hashPose), so this is just the two together.
+//   grid - the collision grid
+//
+// Returns:
+//   the hash
+unsigned long long Rules::hash(const CollisionGrid &grid)
+{
+  return grid.getHash() ^ grid.getPoseHash();
+}
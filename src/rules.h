@@ -0,0 +1,71 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * rules.h
+ *
+ * The rules of the game, worked on the blocks and grid they're given:
+ * blocks appearing, moving, falling, complete layers being taken out and
+ * what they score. Nothing here draws, sends or sets timers, so the same
+ * rules run the windowed game (cve.cc) and anything headless that links
+ * the core library (see bench.cc).
+ *
+ * settle() is gravity run to the end in one go: every falling block is
+ * dropped straight to where it would come to rest, lowest first, without
+ * the ticks of animation and collision checks in between. It's for playing
+ * without a window or fast forwarding, e.g. after a layer clear leaves
+ * fragments hanging.
+ *
+ * hash() sums up the whole game: the grid's hash of what has landed, with
+ * the id and pose of every block that may still be falling folded in, for
+ * telling game states apart (snapshots, positions already looked at).
+ * Peers only compare what has landed (see Client), as each runs its own
+ * gravity and hears of the other's moves a round trip late.
+ */
+
+#ifndef _RULES_
+#define _RULES_
+
+#include <vector>
+#include "blockpool.h"
+#include "grid.h"
+
+// points for a completed layer, and the extra for another layer completed
+// soon after
+#define RULES_LAYER_POINTS 10
+#define RULES_BONUS_POINTS 10
+// how long the extra lasts for after a layer is completed, in countdowns
+// of the bonus count (the game counts it down every six ticks)
+#define RULES_BONUS_CHECKS 50
+
+class Rules {
+
+  public:
+    static BlockHandle newBlock(BlockPool&, int&, int, float, CollisionGrid&, float[]);
+    static bool moveBlocks(BlockPool&, CollisionGrid&, float[]);
+    static void gravity(BlockPool&, bool);
+    static void removeLayers(BlockPool&, const LayerSet&, CollisionGrid&, float[], int&);
+    static int settle(BlockPool&, CollisionGrid&, float[]);
+    static int scoreLayer(int&);
+    static unsigned long long hash(const CollisionGrid&);
+
+};
+
+#endif
@@ -0,0 +1,106 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "scheduler.h"
+
+// Scheduler constructor
+Scheduler::Scheduler()
+{
+  tick = 0;
+  timerCount = 0;
+  accumulator = 0;
+  lastTime = 0;
+  started = false;
+}
+
+// Call a function after a time, once (like glutTimerFunc, but on ticks)
+//   ms - the time in ms, rounded up to whole ticks (at least one)
+//   func - the function to call
+//   value - passed to func
+void Scheduler::after(int ms, TickFunc func, int value)
+{
+  int ticks = (ms + SIM_TICK_MS - 1) / SIM_TICK_MS;
+  if (ticks < 1) ticks = 1;
+  Timer t = { tick + ticks, timerCount++, func, value };
+  timers.push_back(t);
+}
+
+// Run the timers due on the current tick. A timer can set another (or
+// itself again) while it runs; that one waits for a later tick.
+void Scheduler::runTimers()
+{
+  for (;;) {
+    int next = -1;
+    for (int i = 0; i < (int) timers.size(); i++) {
+      if (timers[i].due > tick) continue;
+      if (next < 0 || timers[i].order < timers[next].order) next = i;
+    }
+    if (next < 0) break;
+
+    Timer t = timers[next];
+    timers[next] = timers.back();
+    timers.pop_back();
+    t.func(t.value);
+  }
+}
+
+// Go back (or forward) to the game time and timers of another scheduler,
+// e.g. a copy kept in a snapshot. The real time and the part of a tick
+// still to run stay as they are, so the game carries on from there without
+// a jump.
+//   saved - the scheduler to take the ticks and timers from
+void Scheduler::restore(const Scheduler &saved)
+{
+  tick = saved.tick;
+  timers = saved.timers;
+  timerCount = saved.timerCount;
+}
+
+// Run the ticks that real time has caught up with
+//   now - the real time in ms
+//   step - the function to call each tick (passed the tick number, wrapped
+//          to an int)
+//
+// Returns:
+//   the number of ticks run
+int Scheduler::advance(int now, TickFunc step)
+{
+  if (!started) {
+    lastTime = now;
+    started = true;
+  }
+
+  accumulator += now - lastTime;
+  lastTime = now;
+  if (accumulator < 0) accumulator = 0;
+  // bounded catch up: drop what can't be run this frame
+  if (accumulator > SIM_MAX_TICKS * SIM_TICK_MS) accumulator = SIM_MAX_TICKS * SIM_TICK_MS;
+
+  int ticks = 0;
+  while (accumulator >= SIM_TICK_MS) {
+    tick++;
+    step((int) tick);
+    runTimers();
+    accumulator -= SIM_TICK_MS;
+    ticks++;
+  }
+
+  return ticks;
+}
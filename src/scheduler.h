@@ -0,0 +1,92 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * scheduler.h
+ *
+ * The fixed timestep simulation loop, and the gameplay timers that run on it.
+ *
+ * The game is simulated in ticks of SIM_TICK_MS. Each frame hands the
+ * scheduler the real time, which goes into an accumulator, and as many
+ * whole ticks as it holds are run. What's left over says how far the next
+ * tick is, for drawing in between (see Pawn::setDrawAlpha). After a slow
+ * frame no more than SIM_MAX_TICKS are caught up, and the rest of the time
+ * is dropped, so the game slows down rather than spiralling.
+ *
+ * Timers count whole ticks rather than milliseconds, so gravity and new
+ * blocks come after the same number of moves whatever the frame rate.
+ */
+
+#ifndef _SCHEDULER_
+#define _SCHEDULER_
+
+#include <vector>
+
+// length of a simulation tick, close to the 122 Hz that speeds were tuned
+// for (see SECS_PER_FRAME)
+#define SIM_TICK_MS 8
+// most ticks run to catch up in one frame
+#define SIM_MAX_TICKS 25
+
+using namespace std;
+
+// called each tick, or when a timer is due, with a value (as glutTimerFunc)
+typedef void (*TickFunc)(int);
+
+class Scheduler {
+
+  private:
+    struct Timer {
+      long long due; // tick to run on
+      int order; // timers due on the same tick run in the order they were set
+      TickFunc func;
+      int value;
+    };
+
+    vector <Timer> timers;
+    long long tick; // ticks run so far
+    int timerCount;
+    int accumulator; // ms not yet simulated
+    int lastTime;
+    bool started;
+
+    void runTimers();
+
+  public:
+    Scheduler();
+
+    void after(int, TickFunc, int);
+    int advance(int, TickFunc);
+    void restore(const Scheduler&);
+
+    // Get how far the time since the last tick is towards the next, from
+    // 0 to 1, for drawing in between ticks
+    float getAlpha() const {
+      return (float) accumulator / SIM_TICK_MS;
+    }
+
+    // Get the number of ticks run so far
+    long long getTick() const {
+      return tick;
+    }
+
+};
+
+#endif
@@ -24,15 +24,42 @@
  * Accepts new connections, passes on messages and sends out its own
  * messages for initialising gravity and creating new blocks.
  *
+ * The sockets are non-blocking and watched by one edge-triggered epoll set.
+ * Each wakeup only deals with the connections that have something to read
+ * or can take more data, and each connection keeps what it couldn't send
+ * yet, so a slow client falls behind on its own without holding up the rest.
+ *
+ * What a client is behind on is kept in a bounded queue (see outqueue.h).
+ * Positions and the board hash only matter as the latest one from each
+ * sender, so a new one replaces one still waiting; block confirmations are
+ * sent round all the blocks again and again, so they're also dropped while
+ * the queue is congested. A client that gets too far behind all the same is
+ * disconnected.
+ *
+ * What clients send is split into frames where it's received (see
+ * framereader.h), and the sender's id is put in after the STX as each frame
+ * is passed on.
+ *
+ * New blocks, traffic reports and layers found going out of date are timers
+ * on a wheel (see timerwheel.h) in monotonic milliseconds. epoll waits until
+ * the next one is due, so the server sleeps when there's nothing to do.
+ *
+ * Messages from the server itself (gravity, new blocks, layers removed) are
+ * queued up through each time round the loop, and go to every client in one
+ * batch at the end of it, along with what has been passed on to them.
+ *
  * Trevor Dodds, 2005
  */
 
 #include <vector>
+#include <string>
 #include <iostream>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <signal.h>
@@ -42,6 +69,9 @@
 #include <cstring>
 
 #include "game.h"
+#include "outqueue.h"
+#include "framereader.h"
+#include "timerwheel.h"
 
 using namespace std;
 
@@ -57,12 +87,13 @@ using namespace std;
 
 #define BACKLOG 10     // how many pending connections queue will hold
 
-#define MAXRECVDATASIZE 1000
-
 #define MAXCLIENTS 10
 #define NUM_PLAYERS 2 // number of clients before starting gravity
 
-#define MAX_SERVER_MESSAGE_SIZE 50
+// most events handled per wakeup
+#define MAX_EVENTS 16
+// epoll tag for the listening socket (clients are tagged with their slot)
+#define LISTEN_TAG MAXCLIENTS
 
 // define data unit flags
 #define FLAG_MASTER 'M'
@@ -72,7 +103,15 @@ using namespace std;
 #define FLAG_GAMEOVER 'G'
 #define FLAG_LAYER_FOUND 'L'
 #define FLAG_LAYER_REMOVE 'R'
+// and flags the server only passes on (as client.h)
+#define FLAG_POSITION 'p'
+#define FLAG_BLOCK 'B'
+#define FLAG_HASH 'h'
+
+// number of characters in a block id (as blockpool.h)
+#define BLOCK_ID_CHARS 5
 
+// seconds a layer found by one client waits to be found by another
 #define LAYER_FOUND_EXPIRY_TIME 40
 
 // difficulty changing parameters (in seconds)
@@ -88,10 +127,18 @@ float newBlockCount = (float) (NEW_BLOCK_COUNT_START / 1000);
 
 #define SERVER_ID 's'
 
-int listenSock, new_fd, numbytes;  // listen on sock_fd, new connection on new_fd
-char buf[MAXRECVDATASIZE]; // for receiving data
-int receivedCursor[MAXCLIENTS];
-char dataReceived[MAXCLIENTS][MAXRECVDATASIZE+1]; // add on id
+// a client connection
+struct Connection {
+  int sock; // -1 while the slot is free
+  char id; // sent with everything they send
+  FrameReader received; // what they've sent, up to the end of the last frame
+  OutQueue waiting; // data for them the socket hasn't taken yet
+  bool writable; // false from a send that would block until epoll says otherwise
+  bool queued; // given data since the last flushQueued()
+};
+
+int listenSock, numbytes;  // listen on sock_fd
+int epollSock; // the epoll set watching every socket
 struct sockaddr_in my_addr;    // my address information
 struct sockaddr_in their_addr; // connector's address information
 int sin_size;
@@ -99,51 +146,71 @@ int sin_size;
 int sockoptyes=1;
 int numHosts=0;
 
-char serverMessage[MAX_SERVER_MESSAGE_SIZE];
+string serverMessages; // to go to all the clients at the end of this time round the loop
 int messNum = 0;
 
+int queuedClients[MAXCLIENTS]; // slots given data since the last flushQueued()
+int queuedCount = 0;
+
 bool assignedMaster = false, startedGravity = false;
 
-int clCount = 0, clMax = 10; // client counter (how many clients we have) and maximum number
-int clSocks[10]; // client sockets
-int maxSock = 0;
-struct timeval timeout;
-fd_set readSocks;
-fd_set writeSocks;
+int clCount = 0; // client counter (how many clients we have)
+Connection clients[MAXCLIENTS]; // client slots, a connection keeps its slot until it closes
 
-clock_t newBlockTimer; // for making new blocks appear
-clock_t trafficAnalysisTimer; // for analysing traffic
+TimerWheel timers(0); // new blocks, traffic analysis and layer found expiry
 int traffic; // number of bytes received
 
 // store layer found details
 vector <int> layerFound;
-vector <int> timeLayerFound;
-clock_t serverStartTime;
+vector <int> layerFoundNumber; // for matching up their expiry timers
+vector <int> layerFoundTimer; // the expiry timers, to cancel when found elsewhere
+int layersFound = 0;
 //int numBlocksSent = 0;
 
-// Create a new block by generating a server message
-void newBlock()
+// The time now, from a clock that doesn't stop while the server waits on epoll
+//
+// Returns:
+//   a time in milliseconds
+long long now()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (long long) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+// Queue a message from the server, for all the clients
+//   flag - what it is
+//   data - a character to go with it, or 0 for none
+void addServerMessage(char flag, char data)
+{
+  serverMessages += (char) 2; // STX (no need to send ETX)
+  serverMessages += SERVER_ID;
+  serverMessages += flag;
+  if (data != 0) serverMessages += data;
+}
+
+// Create a new block by generating a server message, and set the timer
+// for the next one
+//   value - not used
+void newBlock(int value)
 {
   //if (numBlocksSent > 1) return;
   //numBlocksSent++;
 
   int type = rand() % 8;
 
-  serverMessage[0] = 2;   // STX
-  serverMessage[1] = SERVER_ID; // id
-  serverMessage[2] = FLAG_NEW_BLOCK;
-  serverMessage[3] = type + '0'; // never send null
-  //serverMessage[4] = 3;   // ETX no need to send this
+  addServerMessage(FLAG_NEW_BLOCK, type + '0'); // never send null
 
   if (newBlockCount > (float) (NEW_BLOCK_COUNT_MIN / 1000))
     newBlockCount -= (float) (NEW_BLOCK_COUNT_DECREASE / 1000);
   if (LOG_OUTPUT) cerr << "newBlockCount: " << newBlockCount << endl;
-  newBlockTimer = clock() + (long int) (newBlockCount * CLOCKS_PER_SEC);
+  timers.after((long long) (newBlockCount * 1000), newBlock, 0);
   //cout << "new block info ready to send: " << type << endl;
 }
 
 // Output traffic for analysis
-void analyseTraffic()
+//   value - not used
+void analyseTraffic(int value)
 {
   if (LOG_OUTPUT) cout << traffic << endl;
   
@@ -151,33 +218,64 @@ void analyseTraffic()
   traffic = 0;
 
   // reset timer
-  trafficAnalysisTimer = clock() + (long int) (TRAFFIC_ANALYSIS_COUNT * CLOCKS_PER_SEC);
+  timers.after(TRAFFIC_ANALYSIS_COUNT * 1000, analyseTraffic, 0);
 }
 
-// The number of seconds elapsed since the server started
+// Forget a layer found by one client that no other has found in time
+//   number - which layer found it was (see layerFoundNumber)
+void expireLayerFound(int number)
+{
+  for (int i = 0; i < (int) layerFoundNumber.size(); i++) {
+    if (layerFoundNumber[i] == number) {
+      layerFound.erase(layerFound.begin() + i);
+      layerFoundNumber.erase(layerFoundNumber.begin() + i);
+      layerFoundTimer.erase(layerFoundTimer.begin() + i);
+      cerr << "layer found message expired" << endl;
+      return;
+    }
+  }
+}
+
+// Make a socket's reads and writes return straight away rather than wait
+//   sock - the socket
+void setNonBlocking(int sock)
+{
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+    perror("fcntl");
+    cerr << "warning: socket " << sock << " could block" << endl;
+  }
+}
+
+// Add a socket to the epoll set. It's edge triggered, so an event means the
+// socket has become readable or writable since the last one, and it has to
+// be read (or written) until it would block before another will come.
+//   sock - the socket
+//   tag - its client slot, or LISTEN_TAG
 //
 // Returns:
-//   an integer representing the number of seconds elapsed since the server started
-int secondsElapsed()
+//   false if it couldn't be added
+bool watch(int sock, int tag)
 {
-  return (int) ((clock() - serverStartTime) / CLOCKS_PER_SEC);
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.u32 = tag;
+  if (epoll_ctl(epollSock, EPOLL_CTL_ADD, sock, &ev) == -1) {
+    perror("epoll_ctl");
+    return false;
+  }
+  return true;
 }
 
 // Initialise server
 void serverInit()
 {
-  serverStartTime = clock();
+  timers.advance(now()); // start the wheel's clock
 
   // clear the data
   for (int i = 0; i < MAXCLIENTS; i++){
-    receivedCursor[i] = 0;
-    for (int j = 0; j < MAXRECVDATASIZE; j++) {
-      dataReceived[i][j] = '\0';
-    }
-  }
-
-  for (int i = 0; i < MAX_SERVER_MESSAGE_SIZE; i++) {
-    serverMessage[i] = '\0';
+    clients[i].sock = -1;
+    clients[i].queued = false;
   }
 
   // set random seed based on time
@@ -208,292 +306,276 @@ void serverInit()
     exit(1);
   }
 
-  newBlockTimer = clock() +
-    (long int) ((float) (NEW_BLOCK_COUNT_START / 1000) * CLOCKS_PER_SEC);
-  trafficAnalysisTimer = clock() + (long int) (TRAFFIC_ANALYSIS_COUNT * CLOCKS_PER_SEC);
-}
-
-// Receive data from clients
-void receiveData()
-{
-
-  char id;
-
-  // go through all the sockets and store the data
-  for (int i = 0; i < clCount; i++) {
-    
-    // is the socket set as readable?
-    if (FD_ISSET(clSocks[i], &readSocks)) {
-      // receive a message
-      if ((numbytes=recv(clSocks[i], buf, MAXRECVDATASIZE-1, 0)) == -1) {
-          perror("recv");
-          cerr << "receive error" << endl;
-      }
-
-      traffic += numbytes;
-
-      // -1 is an error, dealt with above.
-      // 0 means connection has been closed by remote side
-      if (numbytes == 0){
-        close(clSocks[i]);       
-        cerr << "a connection was closed" << endl;
-        clSocks[i] = -1; // it couldn't be this before, because that would mean
-        // accept returned an error
-
-        // clSocks[i] is removed from the array below
-      }else{
-
-        // store
-        //buf[numbytes] = '\0'; // make like a string
-        //printf("received buffer: %s\n", buf);
-        //cout << "id assigning: " << clSocks[i] << " which goes to char: " << (char) clSocks[i] << endl;
+  if ((epollSock = epoll_create1(0)) == -1) {
+    perror("epoll_create1");
+    exit(1);
+  }
 
-        id = (char) (clSocks[i] % 256);
+  setNonBlocking(listenSock);
+  if (!watch(listenSock, LISTEN_TAG)) exit(1);
 
-        // append received data to permanent store
-        for (int j = 0; j < numbytes; j++) {
+  timers.after(TRAFFIC_ANALYSIS_COUNT * 1000, analyseTraffic, 0);
+}
 
-          // if char is 2 (start of text), then add id next to show who it was from
-          dataReceived[i][receivedCursor[i]++] = buf[j];
+// Close a client connection and free its slot
+//   i - the slot
+void closeConnection(int i)
+{
+  Connection &c = clients[i];
+  epoll_ctl(epollSock, EPOLL_CTL_DEL, c.sock, NULL);
+  close(c.sock);
+  cerr << "a connection was closed" << endl;
+  c.sock = -1;
+  c.received.clear();
+  c.waiting.clear();
+  clCount--;
+}
 
-          if (buf[j] == 2) dataReceived[i][receivedCursor[i]++] = id;
+// Send a client as much of their waiting data as their socket will take.
+// Whatever is left stays waiting until epoll says the socket is writable.
+//   i - the slot
+void flush(int i)
+{
+  Connection &c = clients[i];
+  if (!c.writable || c.waiting.size() == 0) return;
+
+  if (c.waiting.send(c.sock) == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) c.writable = false;
+    else {
+      perror("send");
+      cerr << "send error" << endl;
+      // a dead connection shows up as readable, and is closed there
+    }
+  }
+}
 
-          if (receivedCursor[i] > MAXRECVDATASIZE - 2) { // -2 because 2 can be added at once from above
-            cerr << "warning: permanent store dataReceived[" << i << "] was overflowed: reset took place" << endl;
-            receivedCursor[i] = 0;
-            numbytes = 0;
-            //overflow = true;
-          }
-        
-        }
+// Queue data for a client, to go with the rest at the end of this time
+// round the loop (see flushQueued), or sooner if there's a lot of it. A
+// client that is too far behind to take it is disconnected.
+//   i - the slot
+//   data - the data
+//   length - number of bytes
+//   policy - OUTQUEUE_KEEP, OUTQUEUE_MERGE or OUTQUEUE_MERGE_OR_DROP
+//   key - what it replaces, for the merge policies
+void sendTo(int i, const char *data, int length, int policy = OUTQUEUE_KEEP, const string &key = "")
+{
+  if (!clients[i].waiting.push(data, length, policy, key)) {
+    cerr << "warning: client " << i << " is too far behind, disconnecting" << endl;
+    closeConnection(i);
+    return;
+  }
 
-      } // end if numbytes == 0
+  Connection &c = clients[i];
+  if (!c.queued) {
+    c.queued = true;
+    queuedClients[queuedCount++] = i;
+  }
+  if (c.waiting.size() >= OUTQUEUE_LOW_WATER) flush(i);
+}
 
-    } // end is socket readable
+// Send the clients what has been queued for them, a batch each
+void flushQueued()
+{
+  for (int q = 0; q < queuedCount; q++) {
+    int i = queuedClients[q];
+    clients[i].queued = false;
+    if (clients[i].sock != -1) flush(i);
+  }
+  queuedCount = 0;
+}
 
-  } // end for
+// Work out how a message passed on from a client can be merged or dropped
+//   data - the message, from the STX
+//   length - number of bytes
+//   key - set to what it replaces
+//
+// Returns:
+//   OUTQUEUE_KEEP, OUTQUEUE_MERGE or OUTQUEUE_MERGE_OR_DROP
+int relayPolicy(const char *data, int length, string &key)
+{
+  if (length < 3) return OUTQUEUE_KEEP;
 
+  char flag = data[2];
+  if (flag == FLAG_POSITION || flag == FLAG_HASH) {
+    key.assign(data + 1, 2); // sender and flag
+    return OUTQUEUE_MERGE;
+  }
+  if (flag == FLAG_BLOCK && length >= 3 + BLOCK_ID_CHARS) {
+    key.assign(data + 1, 2 + BLOCK_ID_CHARS); // and which block
+    return OUTQUEUE_MERGE_OR_DROP;
+  }
+  return OUTQUEUE_KEEP;
+}
 
-  // get rid of closed ones - note that this may not work
-  // as they may not be readable by select
-  // this would get rid of them if they were closed between select
-  // and recv
-  for (int i = 0; i < clCount; i++) {
-    if (clSocks[i] == -1) {
-      cerr << "removed connection from clSocks[]" << endl;
-      for (int j = i; j < clCount-1; j++) {
-        clSocks[j] = clSocks[j+1];
-        for (int k = 0; k < MAXRECVDATASIZE; k++) dataReceived[j][k] = dataReceived[j+1][k];
-        receivedCursor[j] = receivedCursor[j+1];
+// Pass on a message a client has sent to everyone else, or act on it if
+// it's for the server
+//   i - the slot it came from
+//   frame - the message, between its STX and ETX
+void relay(int i, const FrameView &frame)
+{
+  // the message as passed on: STX, who it's from, then the frame
+  // (there's no need to send the ETX)
+  char dataToSend[FRAMEREADER_SIZE + 3];
+  int length = frame.size() + 2;
+  dataToSend[0] = 2;
+  dataToSend[1] = clients[i].id;
+  frame.copyTo(dataToSend + 2);
+  dataToSend[length] = '\0'; // so a short message reads as nulls
+
+  if (dataToSend[2] == FLAG_LAYER_FOUND) {
+    // this is a message to the server saying a layer was found
+    int layer = (int) dataToSend[3] - 1;
+    cerr << "received layer found: " << layer << endl;
+    bool foundElsewhere = false;
+    for (int k = 0; k < (int) layerFound.size(); k++) {
+      if (layerFound[k] == layer) {
+        // send message saying layer removed
+        addServerMessage(FLAG_LAYER_REMOVE, (char) (layer + 1)); // don't send null
+        // remove this layer found thing, and its timer
+        timers.cancel(layerFoundTimer[k]);
+        layerFound.erase(layerFound.begin() + k);
+        layerFoundNumber.erase(layerFoundNumber.begin() + k);
+        layerFoundTimer.erase(layerFoundTimer.begin() + k);
+        foundElsewhere = true;
+        break;
       }
-      clCount--;
+    }
+    if (!foundElsewhere) {
+      layerFound.push_back(layer);
+      layerFoundNumber.push_back(++layersFound);
+      layerFoundTimer.push_back(timers.after(LAYER_FOUND_EXPIRY_TIME * 1000, expireLayerFound, layersFound));
+    }
+  }else{
+    // spit it out to everyone but the person we received it from
+    string key;
+    int policy = relayPolicy(dataToSend, length, key);
+    for (int j = 0; j < MAXCLIENTS; j++) {
+      if (j != i && clients[j].sock != -1) sendTo(j, dataToSend, length, policy, key);
     }
   }
-
 }
 
-// Send some data
-void sendData()
+// Receive data from a client, until there's none left to read, and pass on
+// whatever messages are complete
+//   i - the slot
+void receiveData(int i)
 {
-  // note this function should only be called if all sockets are writable
-  int startOfData = -1, endOfData = -1;
-  char dataToSend[MAXRECVDATASIZE];
-  
-  // alright we've got some data, so throw it out
-  // go through data
-  for (int i = 0; i < MAXCLIENTS; i++) {
-    if (dataReceived[i][0] != '\0') { // if there's data
-
-      startOfData = -1, endOfData = -1;
-
-      // is there a complete data chunk?
-      // check for start and end characters 2 and 3
-      for (int j = 0; j < receivedCursor[i]; j++) {
-        if (dataReceived[i][j] == 2) {
-          startOfData = j;
-          for (int k = j+1; k < receivedCursor[i]; k++) {
-            if (k == 0) cerr << "error" << endl;
-            if (dataReceived[i][k] == 3) {
-              endOfData = k;
-              break;
-            }
-          }
-          break;
-        }
-      } // end for
-
-      // so can we send yet?
-      if (startOfData > -1 && endOfData > -1) {
-        //cout << "about to send: start: " << startOfData << " end: " << endOfData << " rc: " << receivedCursor[i] << endl;
-        // random check
-        if (endOfData <= startOfData) {
-          cerr << "hold on, startOfData: " << startOfData << ", endOfData: " << endOfData
-               << ", I thought I fixed this by initialising vars each loop" << endl;
-          // nuke it
-          for (int j = 0; j < MAXRECVDATASIZE; j++) dataReceived[i][j] = '\0';
-          receivedCursor[i] = 0;
-          continue; // carry on with for loop
-        }
-      
-        // copy chunk of data (from start and end signals 2 and 3) from dataReceived to dataToSend
-        // this doesn't bother sending the end character
-        // TODO could skip start of data? would have to ignore it in client too
-        for (int j = startOfData; j < endOfData; j++) dataToSend[j-startOfData] = dataReceived[i][j];
-        // clear the rest of dataToSend array
-        for (int j = endOfData - startOfData; j < MAXRECVDATASIZE; j++) dataToSend[j] = '\0';
-
-        // shift back to the start of the dataReceived array any unused data, overwriting data we're sending
-        receivedCursor[i] = receivedCursor[i] - endOfData - 1; // -1 because want to overwrite data end char (3)
-        for (int j = 0; j < receivedCursor[i]; j++) {
-          dataReceived[i][j] = dataReceived[i][j+endOfData+1];
-        }
-        // clear anything after the cursor
-        for (int j = receivedCursor[i]; j < MAXRECVDATASIZE; j++)
-          dataReceived[i][j] = '\0';
-
-        if (dataToSend[2] == FLAG_LAYER_FOUND) {
-          // this is a message to the server saying a layer was found
-          layerFound.push_back((int) dataToSend[3] - 1);
-          timeLayerFound.push_back(secondsElapsed());
-          cerr << "received layer found: " << layerFound[layerFound.size()-1] << endl;
-          for (int k = 0; k < (int) layerFound.size() - 1; k++) {
-            if (layerFound[k] == layerFound[layerFound.size()-1]) { // found elsewhere
-              // send message saying layer removed
-              // if this overwrites new block message then it will overwrite it
-              // for both clients
-              serverMessage[0] = 2;   // STX
-              serverMessage[1] = SERVER_ID; // id
-              serverMessage[2] = FLAG_LAYER_REMOVE;
-              serverMessage[3] = (char) (layerFound[k] + 1); // don't send null
-              serverMessage[4] = 0; // just make sure it ends here
-              // remove this layer found thing
-              layerFound.pop_back();
-              timeLayerFound.pop_back();
-              for (int l = k; l < (int) layerFound.size() - 1; l++) {
-                layerFound[l] = layerFound[l+1];
-                timeLayerFound[l] = timeLayerFound[l+1];
-              }
-              layerFound.pop_back();
-              timeLayerFound.pop_back();
-            }
-          }
-        }else{
-          // timeout layer found messages
-          if (timeLayerFound.size() > 0) {
-            if (secondsElapsed() - timeLayerFound[0] > LAYER_FOUND_EXPIRY_TIME) {
-              for (int j = 0; j < (int) timeLayerFound.size() - 1; j++) {
-                timeLayerFound[j] = timeLayerFound[j+1];
-                layerFound[j] = layerFound[j+1];
-              }
-              layerFound.pop_back();
-              timeLayerFound.pop_back();
-              cerr << "layer found message expired" << endl;
-            }
-          }
-
-          // spit it out
-          // keep going through the sockets until all have been done
-          for (int j = 0; j < clCount; j++) {
-
-            // if not the person who we received it from (i != j)
-            if (i != j) {
-              //cout << "sending to socket: " << j << endl;
-              //cout << "sending data: " << dataReceived[i] << endl;
-              // strlen counts up to and not including the first null character
-              if (send(clSocks[j], dataToSend, strlen(dataToSend), 0) == -1) {
-                perror("send");
-                cerr << "send error" << endl;
-              }
-            }
-          } // end for
-
-        }
-
-      } // end can we send
-
-    } // end if there's received data
-
-  } // end for
-
-  // if there's a message from the server
-  if (serverMessage[0] > 0) {
-    if (LOG_OUTPUT) cerr << "sending a message to " << clCount << " clients. messNum: " << messNum++ << endl;
-    // note this whole function should only be called if all the sockets are writable
-    for (int j = 0; j < clCount; j++) {
-      // strlen counts up to and not including the first null character
-      if (send(clSocks[j], serverMessage, strlen(serverMessage), 0) == -1) {
-        perror("send");
-        cerr << "send error" << endl;
-      }
+  Connection &c = clients[i];
+  FrameView frame;
+
+  while (1) {
+    // receive straight into the frame reader
+    char *room;
+    int roomSize = c.received.space(room);
+    if ((numbytes=recv(c.sock, room, roomSize, 0)) == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break; // read it all
+      if (errno == EINTR) continue;
+      perror("recv");
+      cerr << "receive error" << endl;
+      closeConnection(i);
+      return;
     }
-  }
 
-  // clear server message
-  if (serverMessage[0] > 0) {
-    if (LOG_OUTPUT) cerr << "message cleared" << endl;
-    for (int i = 0; i < MAX_SERVER_MESSAGE_SIZE; i++) serverMessage[i] = '\0';
-  }
+    // 0 means connection has been closed by remote side
+    if (numbytes == 0) {
+      closeConnection(i);
+      return;
+    }
+
+    traffic += numbytes;
+    c.received.wrote(numbytes);
 
+    // pass on what's complete, which also makes room for the next recv
+    while (c.received.next(frame)) relay(i, frame);
+  }
 }
 
-// Do server operations
-void doServer()
+// Queue the messages from the server for all the clients, in one batch
+void sendServerMessages()
 {
-  receiveData();
-
-  // this is bad but only send when we can write to all sockets
-  // because otherwise if we send just to one we won't be able to delete data and so it will
-  // get sent out again to the same client
-  // there is an advantage though for synchronising gravity- server message is only sent out when
-  // both clients are ready to hear it (it's not sent to one then the other later)
-  bool allWritable = true;
-  for (int j = 0; j < clCount; j++) {
-    if (!FD_ISSET(clSocks[j], &writeSocks)) allWritable = false;
+  if (serverMessages.empty()) return;
+
+  if (LOG_OUTPUT) cerr << "sending a message to " << clCount << " clients. messNum: " << messNum++ << endl;
+  for (int j = 0; j < MAXCLIENTS; j++) {
+    if (clients[j].sock != -1) sendTo(j, serverMessages.data(), serverMessages.size());
   }
 
-  if (allWritable) sendData();
+  serverMessages.clear();
 }
 
-// Accept a new connection and store in socket array
+// Accept the waiting connections and give each a slot
 void serverAccept()
 {
-  sin_size = sizeof(struct sockaddr_in);
+  while (1) {
+    sin_size = sizeof(struct sockaddr_in);
 
-  int check;
+    int check;
+
+    if ((check = accept(listenSock, (struct sockaddr *)&their_addr, (socklen_t*) &sin_size)) == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return; // no more waiting
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      perror("accept");
+      cerr << "accept error" << endl;
+      return;
+    }
 
-  if ((check = accept(listenSock, (struct sockaddr *)&their_addr, (socklen_t*) &sin_size)) == -1) {
-    perror("accept");
-    cerr << "accept error" << endl;
-  }else{
     cerr << "server: got connection from " << inet_ntoa(their_addr.sin_addr) << endl;
-    if (clCount < clMax){ // don't allow infinite connections!
-      clSocks[clCount] = check;
-      //FD_SET(clSocks[clCount], &readSocks); // check this one for readability!
-      //if (clSocks[clCount] > maxSock) maxSock = clSocks[clCount]; // adjust maxSock accordingly
-
-      // the connection has been accepted and so give them their id
-      char test[4];
-      test[0] = 'i';
-      test[1] = (char) (clSocks[clCount] % 256);
-      if (!assignedMaster) {
-        test[2] = FLAG_MASTER;
-        assignedMaster = true;
-      }else test[2] = FLAG_SLAVE;
-      test[3] = '\0';
-
-      //cout << "assigned id: " << (int) test[1] << endl;
-      //cout << "test: " << test << endl;
-      //cout << "strlen(test): " << strlen(test) << endl;
-      if (send(clSocks[clCount], test, strlen(test), 0) == -1) {
-        perror("send");
-        cerr << "warning: id not sent" << endl;
-      }
-      
-      clCount++; // one more socket!
 
+    int i = 0;
+    while (i < MAXCLIENTS && clients[i].sock != -1) i++;
+    if (i == MAXCLIENTS) { // don't allow infinite connections!
+      cerr << "warning: no room for another client, connection closed" << endl;
+      close(check);
+      continue;
     }
+
+    setNonBlocking(check);
+    if (!watch(check, i)) {
+      close(check);
+      continue;
+    }
+
+    Connection &c = clients[i];
+    c.sock = check;
+    c.id = (char) (check % 256);
+    c.received.clear();
+    c.waiting.clear();
+    c.writable = true; // (queued is left, as the slot may be in queuedClients)
+    clCount++; // one more socket!
+
+    // the connection has been accepted and so give them their id
+    char test[3];
+    test[0] = 'i';
+    test[1] = c.id;
+    if (!assignedMaster) {
+      test[2] = FLAG_MASTER;
+      assignedMaster = true;
+    }else test[2] = FLAG_SLAVE;
+
+    //cout << "assigned id: " << (int) test[1] << endl;
+    sendTo(i, test, 3);
   }
-  
+}
+
+// Deal with a socket epoll has woken us for
+//   ev - the event
+void serveEvent(const struct epoll_event &ev)
+{
+  if (ev.data.u32 == LISTEN_TAG) {
+    serverAccept();
+    return;
+  }
+
+  int i = ev.data.u32;
+  if (clients[i].sock == -1) return; // closed earlier in this wakeup
+
+  if (ev.events & EPOLLOUT) {
+    clients[i].writable = true;
+    flush(i);
+  }
+
+  // a hang up or error shows up as a read of 0 or -1
+  if (ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) receiveData(i);
 }
 
 // The main function
@@ -505,64 +587,36 @@ void serverAccept()
 int main(int argc, char** argv)
 {
   serverInit();
-  
-  int numReadable = 0;
-  
+
+  struct epoll_event events[MAX_EVENTS];
+
   while (1) { // keep listening and serving
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 0;
-
-    FD_ZERO(&readSocks);
-    FD_ZERO(&writeSocks);
-    FD_SET(listenSock, &readSocks); // set up the listening sock
-    maxSock = listenSock; // this is the only socket to begin with
-    // so it must be the maximum one
-
-    for (int i = 0; i < clCount; i++) {
-      FD_SET(clSocks[i], &readSocks);
-      FD_SET(clSocks[i], &writeSocks);
-      // if they've closed a connection, maxSock might decrease
-      if (clSocks[i] > maxSock) maxSock = clSocks[i];
-    }
-  
-    //numReadable = select(maxSock + 1, &readSocks, &writeSocks, NULL, &timeout);
-    numReadable = select(maxSock + 1, &readSocks, &writeSocks, NULL, NULL);
-    //cout << numReadable << endl;
-    if (numReadable == -1){
-      perror("select");
-      cerr << "select error" << endl;
+    int numReady = epoll_wait(epollSock, events, MAX_EVENTS, timers.timeout(now()));
+    if (numReady == -1) {
+      if (errno != EINTR) {
+        perror("epoll_wait");
+        cerr << "epoll_wait error" << endl;
+      }
       continue; // ERROR so ignore the rest of loop
     }
-    if (numReadable == 0) continue; // keep 'select'ing until we can do something
-    
+
+    // timers first, so the wheel's time is now for any set below
+    timers.advance(now());
+
+    for (int e = 0; e < numReady; e++) serveEvent(events[e]);
+
     if (!startedGravity) {
       if (clCount == NUM_PLAYERS) {
         startedGravity = true;
-        serverMessage[0] = 2;   // STX
-        serverMessage[1] = SERVER_ID; // id
-        serverMessage[2] = FLAG_GRAVITY;
-        serverMessage[3] = 0; // just make sure it ends here
+        addServerMessage(FLAG_GRAVITY, 0);
+        // the first block comes with gravity, the second after this
+        timers.after(NEW_BLOCK_COUNT_START, newBlock, 0);
       }
     }
 
-    // if the listenSock has been set as readable, then accept the incoming connection
-    if (FD_ISSET(listenSock, &readSocks)) {
-      //cout << "listen sock readable!" << endl;
-      serverAccept();
-      numReadable--;
-      continue; // note this wastes reading free sockets
-      // but the reason for it is that nothing can be written unless all sockets are writable
-      // and this new socket has not been select()'ed, so calling doServer would lose starting
-      // gravity because although it won't be deleted the message will be replaced by new block
-    }
-
-    doServer();
-
-    // if it's time and gravity has begun then make new block
-    if (clock() > newBlockTimer && startedGravity) newBlock();
-    if (clock() > trafficAnalysisTimer) analyseTraffic();
+    sendServerMessages();
+    flushQueued();
   }
 
   return 0;
 }
-
@@ -0,0 +1,126 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * snapshot.h
+ *
+ * A ring of saved game states, for going back to (undo, rollback) or
+ * starting again from.
+ *
+ * The ring holds a fixed number of states, and taking a snapshot fills the
+ * oldest one in place, so once the ring has gone round the memory is reused
+ * rather than allocated. Snapshots are addressed by handle, slot plus
+ * generation (as BlockPool), so a handle to a snapshot that has since been
+ * overwritten comes back as NULL.
+ *
+ * What goes in a state is up to the game (see GameState in cve.cc). The
+ * collision grid shares its chunks between copies until one of them writes
+ * to a chunk (see grid.h), so saving a large arena only copies what has
+ * changed since.
+ */
+
+#ifndef _SNAPSHOT_
+#define _SNAPSHOT_
+
+// handles are (generation << SNAPSHOT_SLOT_BITS) | slot, never 0
+typedef unsigned int SnapshotHandle;
+
+#define NO_SNAPSHOT 0
+#define SNAPSHOT_SLOT_BITS 8
+
+template <class State, int Size>
+class SnapshotRing {
+
+  private:
+    static_assert(Size > 0 && Size <= (1 << SNAPSHOT_SLOT_BITS), "snapshot ring too big for its handles");
+
+    struct Slot {
+      State state;
+      unsigned int generation; // 0 while empty
+    };
+
+    Slot slots[Size];
+    int next; // slot the next snapshot goes in
+    int count; // snapshots held
+    unsigned int generation; // of the last snapshot taken
+
+    // Get the handle of the snapshot in a slot
+    SnapshotHandle handle(int slot) const {
+      return (SnapshotHandle) (slots[slot].generation << SNAPSHOT_SLOT_BITS) | slot;
+    }
+
+  public:
+    SnapshotRing() {
+      for (int i = 0; i < Size; i++) slots[i].generation = 0;
+      next = 0;
+      count = 0;
+      generation = 0;
+    }
+
+    // Take a snapshot, in place of the oldest one if the ring is full
+    //   h - set to the handle of the new snapshot
+    //
+    // Returns:
+    //   the state to fill in
+    State &take(SnapshotHandle &h) {
+      Slot &s = slots[next];
+      if (++generation >> (32 - SNAPSHOT_SLOT_BITS)) generation = 1;
+      s.generation = generation;
+      h = handle(next);
+      next = (next + 1) % Size;
+      if (count < Size) count++;
+      return s.state;
+    }
+
+    // Look up a snapshot
+    //   h - the snapshot's handle
+    //
+    // Returns:
+    //   the saved state, or NULL if it has been overwritten (or h is
+    //   NO_SNAPSHOT)
+    const State *get(SnapshotHandle h) const {
+      int slot = h & ((1 << SNAPSHOT_SLOT_BITS) - 1);
+      if (h == NO_SNAPSHOT || slot >= Size || slots[slot].generation != h >> SNAPSHOT_SLOT_BITS) return NULL;
+      return &slots[slot].state;
+    }
+
+    // Find a recent snapshot
+    //   age - 0 for the last one taken, 1 for the one before, and so on
+    //
+    // Returns:
+    //   its handle, or NO_SNAPSHOT if the ring doesn't go back that far
+    SnapshotHandle getRecent(int age) const {
+      if (age < 0 || age >= count) return NO_SNAPSHOT;
+      return handle(((next - 1 - age) % Size + Size) % Size);
+    }
+
+    // Forget the snapshots, e.g. for a new game (the memory is kept)
+    void clear() {
+      for (int i = 0; i < Size; i++) slots[i].generation = 0;
+      count = 0;
+    }
+
+    // Get the number of snapshots held
+    int size() const {
+      return count;
+    }
+
+};
+
+#endif
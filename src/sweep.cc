@@ -0,0 +1,130 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+#include <iostream>
+#include "sweep.h"
+
+using namespace std;
+
+// the swept layer words have to fit the classic layout
+static_assert(SWEEP_SIZE <= CLASSIC_WIDTH && SWEEP_SIZE <= CLASSIC_DEPTH, "swept cells too wide for layer words");
+
+SweptCells Sweep::table[BLOCK_TYPES][ORIENTATIONS][3][2];
+bool Sweep::built = false;
+
+// Work out every quarter turn's swept cells
+void Sweep::build()
+{
+  for (int type = 0; type < BLOCK_TYPES; type++)
+    for (int o = 0; o < ORIENTATIONS; o++)
+      for (int axis = 0; axis < 3; axis++)
+        for (int dir = 0; dir < 2; dir++) sweep(type, o, axis, dir == 1, table[type][o][axis][dir]);
+
+  built = true;
+}
+
+// Work out the cells swept by one quarter turn, by stepping the cubes round
+// it and taking the cells under the same check points as
+// Block::checkCollision: 2.2 either side in x and z, and below
+//   type - the block type
+//   o - the orientation the turn starts from
+//   axis - 0, 1 or 2 for x, y or z
+//   positive - turning by +90 rather than -90 degrees
+//   s - filled with the swept cells
+void Sweep::sweep(int type, int o, int axis, bool positive, SweptCells &s)
+{
+  static const float checkOffset[5][3] = {
+    { -0.44, 0.0, 0.0 }, { 0.44, 0.0, 0.0 }, { 0.0, 0.0, -0.44 }, { 0.0, 0.0, 0.44 }, { 0.0, -0.44, 0.0 }
+  };
+
+  const BlockShape &shape = BLOCK_SHAPES[type];
+  const int pivot[3] = { shape.pivot.x, shape.pivot.y, shape.pivot.z };
+  // the other two axes, in the order that makes a positive turn go from
+  // the first towards the second (as glRotatef)
+  int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+  s.numCells = 0;
+  for (int i = 0; i < 3; i++) s.low[i] = 1000.0, s.high[i] = -1000.0;
+
+  for (int step = 0; step <= SWEEP_STEPS; step++) {
+    double angle = M_PI / 2.0 * step / SWEEP_STEPS;
+    if (!positive) angle = -angle;
+    double c = cos(angle), sn = sin(angle);
+
+    for (int i = 0; i < shape.numCubes; i++) {
+      Cell offset = Orientation::cell(type, o, i);
+      const int at[3] = { offset.x, offset.y, offset.z };
+      float centre[3];
+      centre[axis] = at[axis];
+      centre[u] = pivot[u] + c * (at[u] - pivot[u]) - sn * (at[v] - pivot[v]);
+      centre[v] = pivot[v] + sn * (at[u] - pivot[u]) + c * (at[v] - pivot[v]);
+
+      for (int k = 0; k < 3; k++) {
+        if (centre[k] < s.low[k]) s.low[k] = centre[k];
+        if (centre[k] > s.high[k]) s.high[k] = centre[k];
+      }
+
+      for (int p = 0; p < 5; p++) {
+        Cell cell = { (int) roundf(centre[0] + checkOffset[p][0]), (int) roundf(centre[1] + checkOffset[p][1]),
+          (int) roundf(centre[2] + checkOffset[p][2]) };
+
+        bool found = false;
+        for (int j = 0; j < s.numCells && !found; j++)
+          found = s.cells[j].x == cell.x && s.cells[j].y == cell.y && s.cells[j].z == cell.z;
+        if (found) continue;
+
+        if (s.numCells == SWEEP_MAX_CELLS) {
+          cerr << "Sweep::sweep - too many cells for block type " << type << ", orientation " << o << endl;
+          continue;
+        }
+        s.cells[s.numCells++] = cell;
+      }
+    }
+  }
+
+  // and as layer words, from the lowest corner
+  s.min = s.cells[0];
+  Cell high = s.cells[0];
+  for (int j = 1; j < s.numCells; j++) {
+    if (s.cells[j].x < s.min.x) s.min.x = s.cells[j].x;
+    if (s.cells[j].y < s.min.y) s.min.y = s.cells[j].y;
+    if (s.cells[j].z < s.min.z) s.min.z = s.cells[j].z;
+    if (s.cells[j].x > high.x) high.x = s.cells[j].x;
+    if (s.cells[j].y > high.y) high.y = s.cells[j].y;
+    if (s.cells[j].z > high.z) high.z = s.cells[j].z;
+  }
+
+  s.width = high.x - s.min.x + 1;
+  s.layers = high.y - s.min.y + 1;
+  int depth = high.z - s.min.z + 1;
+  if (s.width > SWEEP_SIZE || s.layers > SWEEP_SIZE || depth > SWEEP_SIZE)
+    cerr << "Sweep::sweep - swept cells too wide for block type " << type << ", orientation " << o << endl;
+
+  for (int i = 0; i < SWEEP_SIZE; i++) s.layer[i] = 0, s.column[i] = 0;
+
+  for (int j = 0; j < s.numCells; j++) {
+    int layer = s.cells[j].y - s.min.y;
+    if (layer < SWEEP_SIZE) s.layer[layer] |= CollisionGrid::bit(s.cells[j].x - s.min.x, s.cells[j].z - s.min.z);
+  }
+
+  for (int col = 0; col < s.width && col < SWEEP_SIZE; col++)
+    for (int row = 0; row < depth && row < SWEEP_SIZE; row++)
+      s.column[col] |= CollisionGrid::bit(col, row);
+}
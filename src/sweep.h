@@ -0,0 +1,85 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * sweep.h
+ *
+ * The cells a block passes through as it makes a quarter turn.
+ *
+ * A turn is always 90 degrees about one axis through the block's pivot, from
+ * one of the 24 resting orientations, so the cells it sweeps through only
+ * depend on the block type, the orientation, the axis and the direction.
+ * They are worked out once, by stepping each cube round the turn and taking
+ * the cells that Block::checkCollision would probe on the way, and kept as a
+ * list of cells and as classic layer words. A turn can then be checked
+ * against the grid in one go when it starts rather than a step at a time.
+ */
+
+#ifndef _SWEEP_
+#define _SWEEP_
+
+#include "orientation.h"
+#include "grid.h"
+
+// steps through a quarter turn when working out the swept cells, finer
+// than the turn itself moves in a tick
+#define SWEEP_STEPS 180
+// most cells a quarter turn can sweep through
+#define SWEEP_MAX_CELLS 24
+// swept cells are within this many cells of the pivot each way
+#define SWEEP_REACH 2
+#define SWEEP_SIZE (SWEEP_REACH * 2 + 1)
+
+// The cells swept by one quarter turn, relative to the block's position
+struct SweptCells {
+  int numCells;
+  Cell cells[SWEEP_MAX_CELLS];
+  // lowest and highest cube centres on the way round, in cells, for
+  // checking against the walls and floor
+  float low[3], high[3];
+  // the same cells as layer words, relative to min (as Block's footprint)
+  Cell min;
+  int width, layers;
+  LayerMask layer[SWEEP_SIZE];
+  LayerMask column[SWEEP_SIZE]; // the bits of each x column
+};
+
+class Sweep {
+
+  private:
+    static SweptCells table[BLOCK_TYPES][ORIENTATIONS][3][2];
+    static bool built;
+
+    static void build();
+    static void sweep(int, int, int, bool, SweptCells&);
+
+  public:
+    // Get the cells swept by a quarter turn
+    //   type - the block type
+    //   o - the orientation the turn starts from
+    //   axis - 0, 1 or 2 for x, y or z
+    //   positive - turning by +90 rather than -90 degrees
+    static const SweptCells &get(int type, int o, int axis, bool positive) {
+      if (!built) build();
+      return table[type][o][axis][positive ? 1 : 0];
+    }
+
+};
+
+#endif
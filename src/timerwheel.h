@@ -0,0 +1,206 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * timerwheel.h
+ *
+ * Timers in real milliseconds for the server, on a hierarchical wheel.
+ *
+ * There are TIMERWHEEL_LEVELS wheels of TIMERWHEEL_SLOTS slots. A slot on
+ * level 0 is a millisecond, and a slot on each level after is a whole turn
+ * of the level before. A timer goes in the lowest level that reaches its
+ * time; when a higher slot comes round its timers are spread over the
+ * levels below, so they end up in the millisecond they're due. Adding a
+ * timer and running one are O(1), however many there are. A timer can be
+ * cancelled by the id after() gives it, wherever it has got to; that looks
+ * through the one slot on each level its time falls in.
+ *
+ * The wheel keeps no clock of its own: advance() is given the time (from a
+ * monotonic clock), and timeout() says how long to wait in epoll before
+ * anything is due, so a server with nothing to do sleeps until then.
+ */
+
+#ifndef _TIMERWHEEL_
+#define _TIMERWHEEL_
+
+#include <unordered_map>
+#include <vector>
+
+#define TIMERWHEEL_SLOT_BITS 6
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_SLOT_BITS)
+// four levels reach 2^24 ms (over 4 hours); a later timer goes round the top
+// level again
+#define TIMERWHEEL_LEVELS 4
+
+using namespace std;
+
+// called when a timer is due, with a value (as TickFunc in scheduler.h)
+typedef void (*TimerFunc)(int);
+
+class TimerWheel {
+
+  private:
+    struct Timer {
+      long long due; // ms
+      TimerFunc func;
+      int value;
+      int id;
+    };
+
+    vector <Timer> slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+    long long time; // ms the wheel has been run up to
+    unordered_map <int, long long> waiting; // id to due time, of the timers not run or cancelled
+    int nextId;
+
+    // Get the slot a time falls in on a level
+    static int slotOf(long long t, int level) {
+      return (int) (t >> (level * TIMERWHEEL_SLOT_BITS)) & (TIMERWHEEL_SLOTS - 1);
+    }
+
+    // Put a timer in the lowest level that reaches it from the wheel's time
+    //   t - the timer, due after the wheel's time
+    void place(const Timer &t) {
+      int level = 0;
+      while (level < TIMERWHEEL_LEVELS - 1 && t.due - time >= 1LL << ((level + 1) * TIMERWHEEL_SLOT_BITS)) level++;
+      slots[level][slotOf(t.due, level)].push_back(t);
+    }
+
+    // Get the next time a slot with timers in it comes round
+    //
+    // Returns:
+    //   the time in ms, or -1 if there are no timers
+    long long nextVisit() const {
+      if (waiting.empty()) return -1;
+      long long next = -1;
+      for (int level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        int shift = level * TIMERWHEEL_SLOT_BITS;
+        // the slots of this level come round at each multiple of its unit
+        long long t = ((time >> shift) + 1) << shift;
+        for (int i = 0; i < TIMERWHEEL_SLOTS; i++, t += 1LL << shift) {
+          if (next >= 0 && t >= next) break;
+          if (!slots[level][slotOf(t, level)].empty()) {
+            next = t;
+            break;
+          }
+        }
+      }
+      return next;
+    }
+
+    // Run the wheel on to a time that a slot with timers comes round
+    //   t - the time in ms
+    void visit(long long t) {
+      time = t;
+
+      // spread the higher slots that come round now over the lower levels
+      for (int level = TIMERWHEEL_LEVELS - 1; level > 0; level--) {
+        if (t & ((1LL << (level * TIMERWHEEL_SLOT_BITS)) - 1)) continue;
+        vector <Timer> spread;
+        spread.swap(slots[level][slotOf(t, level)]);
+        for (int i = 0; i < (int) spread.size(); i++) place(spread[i]);
+      }
+
+      // then run this millisecond's timers, which may add more, or cancel
+      // ones still to run here
+      vector <Timer> due;
+      due.swap(slots[0][slotOf(t, 0)]);
+      for (int i = 0; i < (int) due.size(); i++) {
+        if (waiting.erase(due[i].id) == 0) continue;
+        due[i].func(due[i].value);
+      }
+    }
+
+  public:
+    // TimerWheel constructor
+    //   now - the time in ms
+    TimerWheel(long long now) {
+      time = now;
+      nextId = 1;
+    }
+
+    // Set a timer
+    //   ms - how long from the wheel's time until it's due
+    //   func - called when it's due
+    //   value - passed to func
+    //
+    // Returns:
+    //   the timer's id, for cancel()
+    int after(long long ms, TimerFunc func, int value) {
+      Timer t;
+      t.due = time + (ms < 1 ? 1 : ms);
+      t.func = func;
+      t.value = value;
+      t.id = nextId++;
+      waiting[t.id] = t.due;
+      place(t);
+      return t.id;
+    }
+
+    // Stop a timer from running
+    //   id - the timer, as after() gave it
+    //
+    // Returns:
+    //   false if it has already run or been cancelled
+    bool cancel(int id) {
+      unordered_map <int, long long>::iterator w = waiting.find(id);
+      if (w == waiting.end()) return false;
+      long long due = w->second;
+      waiting.erase(w);
+
+      // it's in the slot its time falls in on whichever level it's got down
+      // to (or out already, about to run, if a timer due with it cancels it)
+      for (int level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        vector <Timer> &slot = slots[level][slotOf(due, level)];
+        for (int i = 0; i < (int) slot.size(); i++) {
+          if (slot[i].id == id) {
+            slot.erase(slot.begin() + i);
+            return true;
+          }
+        }
+      }
+      return true;
+    }
+
+    // Run the timers that are due
+    //   now - the time in ms
+    void advance(long long now) {
+      long long next;
+      while ((next = nextVisit()) >= 0 && next <= now) visit(next);
+      if (now > time) time = now;
+    }
+
+    // Get how long until a timer is due, for waiting in epoll
+    //   now - the time in ms
+    //
+    // Returns:
+    //   the wait in ms, or -1 to wait for ever if there are no timers
+    int timeout(long long now) const {
+      long long next = nextVisit();
+      if (next < 0) return -1;
+      return next <= now ? 0 : (int) (next - now);
+    }
+
+    // Get the number of timers waiting
+    int size() const {
+      return waiting.size();
+    }
+
+};
+
+#endif
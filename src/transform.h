@@ -0,0 +1,171 @@
+/* 3d-tetris - A 3D multiuser Tetris game, originally made for researching collaborative interaction in virtual environments.
+ *
+ * Copyright (C) 2004-2011 Trevor Dodds <@gmail.com trev.dodds>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * transform.h
+ *
+ * CPU 4x4 matrix and quaternion maths for block poses, so that simulation
+ * doesn't need a GL context (or a round trip to the driver) to rotate a
+ * block or find where its cubes are.
+ *
+ * Matrices are float[16] in column-major order, the same layout as
+ * glMultMatrixf/glGetFloatv, so they can still be handed straight to GL
+ * for drawing. Nothing here allocates.
+ *
+ * Turns are simulated on Scalar matrices (see fixed.h), which only ever
+ * rotate about one of the axes.
+ */
+
+#ifndef _TRANSFORM_
+#define _TRANSFORM_
+
+#include <cmath>
+#include "fixed.h"
+
+#define TRANSFORM_DEG_TO_RAD 0.017453292519943295
+
+// Unit quaternion, used to build rotation matrices
+struct Quat {
+  float w, x, y, z;
+
+  // Make a quaternion representing a rotation about an axis
+  //   angle - the angle to rotate in degrees
+  //   ax,ay,az - the axis of rotation (need not be normalised, as glRotatef)
+  static Quat fromAxisAngle(float angle, float ax, float ay, float az) {
+    Quat q = { 1.0, 0.0, 0.0, 0.0 };
+    float len = sqrtf(ax * ax + ay * ay + az * az);
+    if (len > 0.0) {
+      float half = angle * TRANSFORM_DEG_TO_RAD * 0.5;
+      float s = sinf(half) / len;
+      q.w = cosf(half), q.x = ax * s, q.y = ay * s, q.z = az * s;
+    }
+    return q;
+  }
+
+  // Convert to a column-major rotation matrix
+  //   m - the matrix to fill
+  void toMatrix(float m[16]) const {
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    m[0] = 1.0 - 2.0 * (yy + zz), m[1] = 2.0 * (xy + wz), m[2] = 2.0 * (xz - wy), m[3] = 0.0;
+    m[4] = 2.0 * (xy - wz), m[5] = 1.0 - 2.0 * (xx + zz), m[6] = 2.0 * (yz + wx), m[7] = 0.0;
+    m[8] = 2.0 * (xz + wy), m[9] = 2.0 * (yz - wx), m[10] = 1.0 - 2.0 * (xx + yy), m[11] = 0.0;
+    m[12] = 0.0, m[13] = 0.0, m[14] = 0.0, m[15] = 1.0;
+  }
+};
+
+class Transform {
+
+  public:
+
+    // Set a matrix to the identity
+    //   m - the matrix to set
+    static void identity(float m[16]) {
+      for (int i = 0; i < 16; i++) m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+    }
+
+    // Copy one matrix to another
+    //   src - the matrix to copy
+    //   dst - the matrix to fill
+    static void copy(const float src[16], float dst[16]) {
+      for (int i = 0; i < 16; i++) dst[i] = src[i];
+    }
+
+    // Multiply two matrices, out = a * b
+    // Each output column is a sum of a's columns, which keeps the inner
+    // loop a straight 4-wide multiply-add the compiler can vectorise.
+    //   a,b - the matrices to multiply
+    //   out - the result (may be the same array as a or b)
+    static void multiply(const float a[16], const float b[16], float out[16]) {
+      float r[16];
+      for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+          r[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1] +
+            a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+        }
+      }
+      copy(r, out);
+    }
+
+    // Pre-multiply a matrix by a rotation, m = R * m
+    // (equivalent to glLoadIdentity; glRotatef; glMultMatrixf(m))
+    //   m - the matrix to rotate
+    //   angle - the angle to rotate in degrees
+    //   ax,ay,az - the axis of rotation
+    static void rotate(float m[16], float angle, float ax, float ay, float az) {
+      float r[16];
+      Quat::fromAxisAngle(angle, ax, ay, az).toMatrix(r);
+      multiply(r, m, m);
+    }
+
+    // Pre-multiply a fixed point matrix by a rotation about an axis, m = R * m,
+    // the same way on any machine
+    //   m - the matrix to rotate
+    //   angle - the angle to rotate in degrees
+    //   axis - 0, 1 or 2 for x, y or z
+    static void rotate(Scalar m[16], Scalar angle, int axis) {
+      Scalar s, c;
+      FixedTrig::sinCos(angle, s, c);
+      // a positive turn goes from the next axis round towards the one after
+      int u = (axis + 1) % 3, v = (axis + 2) % 3;
+      for (int col = 0; col < 4; col++) {
+        Scalar mu = m[col * 4 + u], mv = m[col * 4 + v];
+        m[col * 4 + u] = c * mu - s * mv;
+        m[col * 4 + v] = s * mu + c * mv;
+      }
+    }
+
+    // Convert between float and fixed point matrices
+    //   src - the matrix to convert
+    //   dst - the matrix to fill
+    static void toFixed(const float src[16], Scalar dst[16]) {
+      for (int i = 0; i < 16; i++) dst[i] = Scalar::fromFloat(src[i]);
+    }
+
+    static void toFloat(const Scalar src[16], float dst[16]) {
+      for (int i = 0; i < 16; i++) dst[i] = src[i].toFloat();
+    }
+
+    // Pre-multiply a matrix by a translation, m = T * m
+    // (equivalent to glLoadIdentity; glTranslatef; glMultMatrixf(m))
+    //   m - the matrix to translate
+    //   tx,ty,tz - the translation
+    static void translate(float m[16], float tx, float ty, float tz) {
+      for (int col = 0; col < 4; col++) {
+        m[col * 4] += tx * m[col * 4 + 3];
+        m[col * 4 + 1] += ty * m[col * 4 + 3];
+        m[col * 4 + 2] += tz * m[col * 4 + 3];
+      }
+    }
+
+    // Transform a point by a matrix (w = 1)
+    //   m - the matrix
+    //   px,py,pz - the point, overwritten with the result
+    static void transformPoint(const float m[16], float &px, float &py, float &pz) {
+      float rx = m[0] * px + m[4] * py + m[8] * pz + m[12];
+      float ry = m[1] * px + m[5] * py + m[9] * pz + m[13];
+      float rz = m[2] * px + m[6] * py + m[10] * pz + m[14];
+      px = rx, py = ry, pz = rz;
+    }
+
+};
+
+#endif